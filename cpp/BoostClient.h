@@ -20,89 +20,540 @@
 #define BOOSTCLIENT_H_
 
 #include <iostream>
+#include <boost/bind.hpp>
 #include <boost/asio.hpp>
 #include <boost/system/error_code.hpp>
+#include <boost/thread.hpp>
+#include <algorithm>
+#include <cstdlib>
+#include <ctime>
 #include <sstream>
 
+#include "IoUringSender.h"
+#include "ResolverCache.h"
+#include "SendQueue.h"
+#include "SharedBuffer.h"
+#include "SocketOptions.h"
+#include "UnixProtocol.h"
+#include "ZeroCopy.h"
+
 using boost::asio::ip::tcp;
 
-class client
+/*
+ * How a client retries a failed connection: the first retry
+ * waits minDelay milliseconds, and each further failure doubles
+ * the wait up to maxDelay, with up to half of it randomized.
+ * After maxAttempts failures in a row the client gives up; 0
+ * means it never does.
+ */
+struct ReconnectPolicy
+{
+	ReconnectPolicy(unsigned long min_delay=100, unsigned long max_delay=30000, unsigned long max_attempts=0) :
+		minDelay(min_delay),
+		maxDelay(max_delay),
+		maxAttempts(max_attempts)
+	{}
+
+	unsigned long minDelay;
+	unsigned long maxDelay;
+	unsigned long maxAttempts;
+};
+
+/*
+ * A client connection, over TCP or a Unix domain socket.
+ * Connecting and writing both happen asynchronously on a shared
+ * io_service, so neither a dead peer nor a slow one ever blocks
+ * the caller.  Writes go into a send queue bounded by the given
+ * limits, with the excess handled according to the overflow
+ * policy.  With a protocol that keeps packet boundaries, each
+ * packet goes out in a write of its own.  Over TCP, packets
+ * of at least the zero copy threshold are sent with
+ * MSG_ZEROCOPY, and stay pinned until the kernel reports it is
+ * done with them.  Given a running io_uring engine, the other
+ * writes are sent through it instead of the io_service.
+ */
+template<typename Protocol>
+class basic_client
 {
 public:
-	client(unsigned short port, std::string ip_addr) :
-		s_(io_service_),
+	typedef typename Protocol::endpoint endpoint_type;
+	typedef typename Protocol::socket socket_type;
+
+	enum Status
+	{
+		NOT_CONNECTED,
+		CONNECTED,
+		RECONNECTING,
+		FAILED
+	};
+
+	/*
+	 * Connect over TCP to a port on the host looked up by resolver
+	 */
+	basic_client(boost::asio::io_service& io_service, unsigned short port, const boost::shared_ptr<ResolverCache>& resolver, const QueueLimits& limits=QueueLimits(), const ReconnectPolicy& policy=ReconnectPolicy(), const SocketOptions& options=SocketOptions(), IoUringSender* engine=NULL) :
+		io_service_(io_service),
+		s_(io_service),
+		protocol_(tcp::v4()),
+		resolver_(resolver),
+		resolveTicket_(0),
+		timer_(io_service),
 		port_(port),
-		ip_addr_(ip_addr)
-	{}
+		writeBuffer_(limits),
+		policy_(policy),
+		options_(options),
+		connected_(false),
+		connecting_(false),
+		closing_(false),
+		failures_(0),
+		seed_(reinterpret_cast<size_t>(this) ^ time(NULL)),
+		zeroCopy_(boost::shared_ptr<ZeroCopyCounters>(new ZeroCopyCounters)),
+		errorWait_(false),
+		uring_(engine)
+	{
+		std::ostringstream name;
+		name<<resolver->host()<<":"<<port;
+		name_ = name.str();
+	}
+
+	/*
+	 * Connect to a fixed endpoint, which needs no lookup
+	 */
+	basic_client(boost::asio::io_service& io_service, const Protocol& protocol, const endpoint_type& endpoint, const std::string& name, const QueueLimits& limits=QueueLimits(), const ReconnectPolicy& policy=ReconnectPolicy(), const SocketOptions& options=SocketOptions(), IoUringSender* engine=NULL) :
+		io_service_(io_service),
+		s_(io_service),
+		protocol_(protocol),
+		resolveTicket_(0),
+		endpoints_(1, endpoint),
+		timer_(io_service),
+		port_(0),
+		name_(name),
+		writeBuffer_(limits, SendQueue::DEFAULT_GATHER_BYTES, protocol.type() == SOCK_SEQPACKET ? 1 : SendQueue::DEFAULT_GATHER_BUFFERS),
+		policy_(policy),
+		options_(options),
+		connected_(false),
+		connecting_(false),
+		closing_(false),
+		failures_(0),
+		seed_(reinterpret_cast<size_t>(this) ^ time(NULL)),
+		zeroCopy_(boost::shared_ptr<ZeroCopyCounters>(new ZeroCopyCounters)),
+		errorWait_(false),
+		uring_(engine)
+	{
+	}
 
+	/*
+	 * Close the socket and wait for the outstanding connect,
+	 * write and wait for zero copy completions, if any, to finish
+	 * with this client
+	 */
+	~basic_client()
+	{
+		boost::mutex::scoped_lock lock(writeLock_);
+		boost::system::error_code ec;
+		closing_ = true;
+		if (resolveTicket_)
+			resolver_->cancel(resolveTicket_);
+		timer_.cancel(ec);
+		uring_.release(s_.native_handle());
+		zeroCopy_.closing(s_.native_handle());
+		s_.close(ec);
+		while (connecting_ || writeBuffer_.writing() || errorWait_)
+			writeDone_.wait(lock);
+	}
+
+	/*
+	 * Start connecting in the background, unless already
+	 * connected or connecting.  Returns whether the client is
+	 * connected right now
+	 */
 	bool connect()
 	{
-		try
-		{
-			tcp::resolver resolver(io_service_);
-			std::stringstream ss;
-			ss<<port_;
-			tcp::resolver::query query(ip_addr_, ss.str());
-			tcp::resolver::iterator iter = resolver.resolve(query);
-			s_.connect(*iter);
-			return is_connected();
-		}
-		catch (...)
-		{
-			s_.close();
-			return false;
-		}
+		boost::mutex::scoped_lock lock(writeLock_);
+		if (!connected_)
+			start_connect();
+		return connected_;
 	}
 
 	bool connect_if_necessary()
 	{
-		if (is_connected())
-			return true;
 		return connect();
 	}
 
 	bool is_connected()
 	{
-		return s_.is_open();
+		boost::mutex::scoped_lock lock(writeLock_);
+		return connected_;
 	}
 
-	template<typename T, typename U>
-	void write(std::vector<T, U>& data)
+	Status status()
 	{
-		if (connect_if_necessary())
+		boost::mutex::scoped_lock lock(writeLock_);
+		if (connected_)
+			return CONNECTED;
+		if (gave_up())
+			return FAILED;
+		if (failures_ != 0)
+			return RECONNECTING;
+		return NOT_CONNECTED;
+	}
+
+	/*
+	 * io_uring if writes go through the engine, else asio
+	 */
+	std::string sendMethod()
+	{
+		boost::mutex::scoped_lock lock(writeLock_);
+		return uring_.attached() ? "io_uring" : "asio";
+	}
+
+	/*
+	 * Queue the data to be sent, after its header if it has one,
+	 * and return immediately.  Returns false if the data was not
+	 * queued, either because there is no connection or because the
+	 * send queue is full
+	 */
+	bool write(const SharedBuffer& data, const SharedBuffer& header=SharedBuffer())
+	{
+		boost::mutex::scoped_lock lock(writeLock_);
+		if (!connected_)
 		{
-			size_t bytesWritten=0;
-			boost::system::error_code ec;
-			char* dataBytes = reinterpret_cast<char*>(&data[0]);
-			size_t numBytes = data.size()*sizeof(T);
-			while (bytesWritten!= numBytes)
-			{
-				bytesWritten+= boost::asio::write(s_, boost::asio::buffer(&dataBytes[bytesWritten], numBytes-bytesWritten),boost::asio::transfer_all(), ec);
-				if (ec)
-				{
-					s_.close();
-					break;
-				}
-			}
+			start_connect();
+			return false;
+		}
+
+		switch (writeBuffer_.push(data, dropped_, header))
+		{
+		case SendQueue::START_WRITE:
+			start_write();
+			return true;
+		case SendQueue::QUEUED:
+			return true;
+		case SendQueue::OVERFLOWED:
+		{
+			std::cerr<<"ERROR client send queue overflowed, disconnecting"<<std::endl;
+			disconnect();
+			return false;
+		}
+		default:
+			return false;
 		}
 	}
+
+	/*
+	 * Everything discarded by the send queue so far
+	 */
+	DropCounts dropped()
+	{
+		boost::mutex::scoped_lock lock(writeLock_);
+		return dropped_;
+	}
+
+	ZeroCopyCounts zeroCopyCounts()
+	{
+		return zeroCopy_.counters().load();
+	}
+
 	template<typename T>
 	void read(std::vector<char, T> & data, size_t index=0)
 	{
 		int bytesReceived=0;
-		if (connect_if_necessary() && s_.available()!=0)
+		if (connect_if_necessary())
 		{
-			bytesReceived = s_.read_some(boost::asio::buffer(&data[index], data.size()-index));
+			boost::mutex::scoped_lock lock(writeLock_);
+			if (connected_ && s_.available()!=0)
+				bytesReceived = s_.read_some(boost::asio::buffer(&data[index], data.size()-index));
 		}
 		data.resize(index+bytesReceived);
 	}
+
 private:
-	boost::asio::io_service io_service_;
-	tcp::socket s_;
-	unsigned short port_;
-	std::string ip_addr_;
+	bool gave_up() const
+	{
+		return policy_.maxAttempts != 0 && failures_ >= policy_.maxAttempts;
+	}
 
+	/*
+	 * Resolve and connect in the background.  Must be called
+	 * with writeLock_ held
+	 */
+	void start_connect()
+	{
+		if (connected_ || connecting_ || closing_ || gave_up())
+			return;
+
+		connecting_ = true;
+		start_lookup(static_cast<Protocol*>(NULL));
+	}
+
+	void start_lookup(tcp*)
+	{
+		resolveTicket_ = resolver_->async_resolve(boost::bind(&basic_client::handle_resolve, this, _1, _2));
+	}
+
+	void start_lookup(unix_protocol*)
+	{
+		// Open the socket here so that it gets the right type;
+		// connecting would open it as a stream
+		boost::system::error_code ec;
+		s_.open(protocol_, ec);
+		if (ec)
+			io_service_.post(boost::bind(&basic_client::handle_connect, this, ec));
+		else
+			s_.async_connect(endpoints_.front(),
+				boost::bind(&basic_client::handle_connect, this,
+						boost::asio::placeholders::error));
+	}
+
+	/*
+	 * Try each of the host's addresses in turn
+	 */
+	void handle_resolve(const boost::system::error_code& error, const ResolverCache::Addresses& addresses)
+	{
+		boost::mutex::scoped_lock lock(writeLock_);
+		resolveTicket_ = 0;
+		if (closing_)
+		{
+			finish_connect();
+		}
+		else if (error)
+		{
+			retry_connect();
+		}
+		else
+		{
+			endpoints_.clear();
+			for (ResolverCache::Addresses::const_iterator i = addresses.begin(); i != addresses.end(); ++i)
+				endpoints_.push_back(tcp::endpoint(*i, port_));
+
+			boost::asio::async_connect(s_, endpoints_.begin(), endpoints_.end(),
+				boost::bind(&basic_client::handle_connect, this,
+						boost::asio::placeholders::error));
+		}
+	}
+
+	void handle_connect(const boost::system::error_code& error)
+	{
+		boost::mutex::scoped_lock lock(writeLock_);
+		if (closing_)
+		{
+			finish_connect();
+		}
+		else if (error)
+		{
+			// None of the addresses answered, so look them up again
+			// in case the host has moved
+			boost::system::error_code ec;
+			s_.close(ec);
+			if (resolver_)
+				resolver_->expire();
+			retry_connect();
+		}
+		else
+		{
+			options_.apply(s_);
+			if (options_.zeroCopyThreshold)
+				writeBuffer_.setZeroCopyThreshold(zeroCopy_.enable(s_) ? options_.zeroCopyThreshold : 0);
+			uring_.attach(s_.native_handle());
+			connected_ = true;
+			failures_ = 0;
+			finish_connect();
+		}
+	}
+
+	/*
+	 * Wait out the backoff delay for the latest failure, then
+	 * try again
+	 */
+	void retry_connect()
+	{
+		++failures_;
+		if (gave_up())
+		{
+			std::cerr<<"ERROR giving up connecting to "<<name_<<" after "<<failures_<<" attempts"<<std::endl;
+			finish_connect();
+			return;
+		}
+
+		unsigned long delay = policy_.minDelay;
+		for (unsigned long i=1; i<failures_ && delay<policy_.maxDelay; i++)
+			delay *= 2;
+		delay = std::min(delay, policy_.maxDelay);
+		delay = delay/2 + rand_r(&seed_) % (delay/2 + 1);
+
+		timer_.expires_from_now(boost::posix_time::milliseconds(delay));
+		timer_.async_wait(boost::bind(&basic_client::handle_timer, this,
+				boost::asio::placeholders::error));
+	}
+
+	void handle_timer(const boost::system::error_code& error)
+	{
+		boost::mutex::scoped_lock lock(writeLock_);
+		finish_connect();
+		if (!error)
+			start_connect();
+	}
+
+	/*
+	 * Must be called with writeLock_ held
+	 */
+	void finish_connect()
+	{
+		connecting_ = false;
+		writeDone_.notify_all();
+	}
+
+	/*
+	 * Must be called with writeLock_ held
+	 */
+	void disconnect()
+	{
+		boost::system::error_code ec;
+		uring_.release(s_.native_handle());
+		zeroCopy_.closing(s_.native_handle());
+		s_.close(ec);
+		connected_ = false;
+
+		// A write still going is cleared once it is aborted, when
+		// the number of sends it made is known
+		if (!writeBuffer_.writing())
+			zeroCopy_.clear();
+	}
+
+	/*
+	 * Send everything queued so far with a single gather write.
+	 * Must be called with writeLock_ held
+	 */
+	void start_write()
+	{
+		if (!writeBuffer_.startWrite(writeSequence_))
+			return;
+
+		if (writeBuffer_.zeroCopy())
+		{
+			zeroCopy_.startWrite(writeBuffer_.inFlight());
+			async_zero_copy_write(s_,
+				writeSequence_,
+				zeroCopy_.counters(),
+				boost::bind(&basic_client::handle_zero_copy_write, this,
+						boost::asio::placeholders::error, _2));
+			poll_completions();
+		}
+		else if (uring_.attached())
+		{
+			uring_.async_write(writeSequence_,
+				boost::bind(&basic_client::handle_write, this, _1));
+		}
+		else
+		{
+			boost::asio::async_write(s_,
+				writeSequence_,
+				boost::bind(&basic_client::handle_write, this,
+						boost::asio::placeholders::error));
+		}
+	}
+
+	void handle_zero_copy_write(const boost::system::error_code& error, boost::uint32_t sends)
+	{
+		{
+			boost::mutex::scoped_lock lock(writeLock_);
+			zeroCopy_.writeComplete(sends);
+		}
+		handle_write(error);
+	}
+
+	/*
+	 * Release the buffers the kernel is done with, and wait for
+	 * the error queue to report on the rest.  An out of band
+	 * wait completes on errors without touching the data.  Must
+	 * be called with writeLock_ held
+	 */
+	void poll_completions()
+	{
+		if (!errorWait_ && s_.is_open())
+		{
+			errorWait_ = true;
+			s_.async_receive(boost::asio::null_buffers(),
+				boost::asio::socket_base::message_out_of_band,
+				boost::bind(&basic_client::handle_completions, this,
+						boost::asio::placeholders::error));
+		}
+
+		// Only after waiting, so that nothing reported in between
+		// is missed
+		zeroCopy_.drain(s_.native_handle());
+	}
+
+	void handle_completions(const boost::system::error_code& error)
+	{
+		boost::mutex::scoped_lock lock(writeLock_);
+		errorWait_ = false;
+		writeDone_.notify_all();
+		if (error || closing_)
+			return;
+
+		zeroCopy_.drain(s_.native_handle());
+		if (zeroCopy_.pinned())
+			poll_completions();
+	}
+
+	void handle_write(const boost::system::error_code& error)
+	{
+		boost::mutex::scoped_lock lock(writeLock_);
+		writeBuffer_.writeComplete();
+		writeDone_.notify_all();
+		if (error == boost::asio::error::operation_aborted)
+		{
+			// The socket was closed by an overflow; anything queued
+			// since then belongs to the next connection
+			if (connected_)
+				start_write();
+			else
+				zeroCopy_.clear();
+		}
+		else if (error)
+		{
+			std::cerr<<"ERROR writting client data: "<<error<<std::endl;
+			if (connected_)
+				disconnect();
+			writeBuffer_.clear();
+			zeroCopy_.clear();
+		}
+		else
+		{
+			start_write();
+			if (!writeBuffer_.writing())
+				options_.flush(s_);
+		}
+	}
+
+	boost::asio::io_service& io_service_;
+	socket_type s_;
+	Protocol protocol_;
+	boost::shared_ptr<ResolverCache> resolver_;
+	unsigned long resolveTicket_;
+	std::vector<endpoint_type> endpoints_;
+	boost::asio::deadline_timer timer_;
+	unsigned short port_;
+	std::string name_;
+	SendQueue writeBuffer_;
+	ReconnectPolicy policy_;
+	SocketOptions options_;
+	bool connected_;
+	bool connecting_;
+	bool closing_;
+	unsigned long failures_;
+	unsigned int seed_;
+	std::vector<boost::asio::const_buffer> writeSequence_;
+	boost::mutex writeLock_;
+	boost::condition_variable writeDone_;
+	DropCounts dropped_;
+	ZeroCopyTracker zeroCopy_;
+	bool errorWait_;
+	IoUringFile uring_;
 };
 
+typedef basic_client<tcp> client;
+typedef basic_client<unix_protocol> unix_client;
+
 
 #endif /* BOOSTCLIENT_H_ */
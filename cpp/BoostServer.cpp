@@ -19,84 +19,249 @@
 #include <omniORB4/CORBA.h>
 #include "BoostServer.h"
 
-void session::start()
+template<typename Protocol>
+void basic_session<Protocol>::start()
 {
+	options_.apply(socket_);
+	if (options_.zeroCopyThreshold)
+		writeBuffer_.setZeroCopyThreshold(zeroCopy_.enable(socket_) ? options_.zeroCopyThreshold : 0);
+
+	{
+		boost::mutex::scoped_lock lock(writeLock_);
+		uring_.attach(socket_.native_handle());
+	}
+
 	socket_.async_read_some(boost::asio::buffer(read_data_, max_length_),
-			boost::bind(&session::handle_read, this,
+			boost::bind(&basic_session<Protocol>::handle_read, this->shared_from_this(),
 					boost::asio::placeholders::error,
 					boost::asio::placeholders::bytes_transferred));
 }
 
-template<typename T, typename U>
-void session::write(std::vector<T, U>& data)
+template<typename Protocol>
+void basic_session<Protocol>::close()
+{
+	{
+		boost::mutex::scoped_lock lock(serverLock_);
+		server_ = NULL;
+	}
+
+	boost::mutex::scoped_lock lock(writeLock_);
+	boost::system::error_code ec;
+	uring_.release(socket_.native_handle());
+	zeroCopy_.closing(socket_.native_handle());
+	socket_.close(ec);
+}
+
+/*
+ * Queue a reference to the data, and to its header if it has
+ * one.  Every session shares the same buffers, so nothing is
+ * copied per connection.  Returns false if the session
+ * overflowed and was closed
+ */
+template<typename Protocol>
+bool basic_session<Protocol>::write(const SharedBuffer& data, const SharedBuffer& header, DropCounts& dropped)
 {
 	if (socket_.is_open())
 	{
 		boost::mutex::scoped_lock lock(writeLock_);
-		size_t numBytes = data.size()*sizeof(T);
-		writeBuffer_.push_back(std::vector<char>(numBytes));
-		memcpy(&writeBuffer_.back()[0],&data[0],numBytes);
-		if (writeBuffer_.size()==1)
+		switch (writeBuffer_.push(data, dropped, header))
+		{
+		case SendQueue::START_WRITE:
+			start_write();
+			break;
+		case SendQueue::OVERFLOWED:
 		{
-			boost::asio::async_write(socket_,
-				boost::asio::buffer(writeBuffer_[0]),
-				boost::bind(&session::handle_write, shared_from_this(),
-						boost::asio::placeholders::error));
+			std::cerr<<"ERROR session send queue overflowed, disconnecting"<<std::endl;
+			boost::system::error_code ec;
+			uring_.release(socket_.native_handle());
+			zeroCopy_.closing(socket_.native_handle());
+			socket_.close(ec);
+			return false;
 		}
+		default:
+			break;
+		}
+	}
+	return true;
+}
+
+template<typename Protocol>
+bool basic_session<Protocol>::usesIoUring()
+{
+	boost::mutex::scoped_lock lock(writeLock_);
+	return uring_.attached();
+}
+
+/*
+ * Send everything queued so far with a single gather write.
+ * Must be called with writeLock_ held
+ */
+template<typename Protocol>
+void basic_session<Protocol>::start_write()
+{
+	if (!writeBuffer_.startWrite(writeSequence_))
+		return;
+
+	if (writeBuffer_.zeroCopy())
+	{
+		zeroCopy_.startWrite(writeBuffer_.inFlight());
+		async_zero_copy_write(socket_,
+			writeSequence_,
+			zeroCopy_.counters(),
+			boost::bind(&basic_session<Protocol>::handle_zero_copy_write, this->shared_from_this(),
+					boost::asio::placeholders::error, _2));
+		poll_completions();
+	}
+	else if (uring_.attached())
+	{
+		uring_.async_write(writeSequence_,
+			boost::bind(&basic_session<Protocol>::handle_write, this->shared_from_this(), _1));
 	}
+	else
+	{
+		boost::asio::async_write(socket_,
+			writeSequence_,
+			boost::bind(&basic_session<Protocol>::handle_write, this->shared_from_this(),
+					boost::asio::placeholders::error));
+	}
+}
+
+/*
+ * Release the buffers the kernel is done with, and wait for
+ * the error queue to report on the rest.  An out of band wait
+ * completes on errors without touching the data.  Must be
+ * called with writeLock_ held
+ */
+template<typename Protocol>
+void basic_session<Protocol>::poll_completions()
+{
+	if (!errorWait_ && socket_.is_open())
+	{
+		errorWait_ = true;
+		socket_.async_receive(boost::asio::null_buffers(),
+			boost::asio::socket_base::message_out_of_band,
+			boost::bind(&basic_session<Protocol>::handle_completions, this->shared_from_this(),
+					boost::asio::placeholders::error));
+	}
+
+	// Only after waiting, so that nothing reported in between is
+	// missed
+	zeroCopy_.drain(socket_.native_handle());
+}
+
+template<typename Protocol>
+void basic_session<Protocol>::handle_completions(const boost::system::error_code& error)
+{
+	boost::mutex::scoped_lock lock(writeLock_);
+	errorWait_ = false;
+	if (error)
+		return;
+
+	zeroCopy_.drain(socket_.native_handle());
+	if (zeroCopy_.pinned())
+		poll_completions();
 }
 
-void session::handle_read(const boost::system::error_code& error,
+template<typename Protocol>
+void basic_session<Protocol>::handle_read(const boost::system::error_code& error,
 		size_t bytes_transferred)
 {
+	boost::mutex::scoped_lock lock(serverLock_);
+	if (!server_)
+		return;
+
 	if (!error)
 	{
 		read_data_.resize(bytes_transferred);
 		server_->newSessionData(read_data_);
 		read_data_.resize(max_length_);
 		socket_.async_read_some(boost::asio::buffer(read_data_, max_length_),
-				boost::bind(&session::handle_read, shared_from_this(),
+				boost::bind(&basic_session<Protocol>::handle_read, this->shared_from_this(),
 						boost::asio::placeholders::error,
 						boost::asio::placeholders::bytes_transferred));
 	}
 	else
 	{
 		std::cerr<<"ERROR reading session data: "<<error<<std::endl;
-		server_->closeSession(shared_from_this());
+		server_->closeSession(this->shared_from_this());
+		server_ = NULL;
 	}
 }
 
-void session::handle_write(const boost::system::error_code& error)
+template<typename Protocol>
+void basic_session<Protocol>::handle_zero_copy_write(const boost::system::error_code& error, boost::uint32_t sends)
 {
-	boost::mutex::scoped_lock lock(writeLock_);
-	writeBuffer_.pop_front();
-	if (error)
 	{
-		std::cerr<<"ERROR writting session data: "<<error<<std::endl;
-		server_->closeSession(shared_from_this());
+		boost::mutex::scoped_lock lock(writeLock_);
+		zeroCopy_.writeComplete(sends);
 	}
-	else if(!writeBuffer_.empty())
+	handle_write(error);
+}
+
+template<typename Protocol>
+void basic_session<Protocol>::handle_write(const boost::system::error_code& error)
+{
 	{
-		boost::asio::async_write(socket_,
-						boost::asio::buffer(writeBuffer_[0]),
-						boost::bind(&session::handle_write, shared_from_this(),
-								boost::asio::placeholders::error));
+		boost::mutex::scoped_lock lock(writeLock_);
+		writeBuffer_.writeComplete();
+		if (!error)
+		{
+			start_write();
+			if (!writeBuffer_.writing())
+				options_.flush(socket_);
+			return;
+		}
+		writeBuffer_.clear();
+		zeroCopy_.closing(socket_.native_handle());
+		zeroCopy_.clear();
+	}
+
+	// Leave writeLock_ before taking the server's sessionsLock_,
+	// which basic_server::write holds while taking writeLock_
+	boost::mutex::scoped_lock lock(serverLock_);
+	if (server_)
+	{
+		std::cerr<<"ERROR writting session data: "<<error<<std::endl;
+		server_->closeSession(this->shared_from_this());
+		server_ = NULL;
 	}
 }
 
 
-template<typename T, typename U>
-void server::write(std::vector<T, U>& data)
+template<typename Protocol>
+void basic_server<Protocol>::write(const SharedBuffer& data, const SharedBuffer& header)
 {
-	boost::mutex::scoped_lock lock(sessionsLock_);
-	for (std::list<session_ptr>::iterator i = sessions_.begin(); i!=sessions_.end(); i++)
+	std::list<session_ptr> closed;
 	{
-		session_ptr thisSession= *i;
-		thisSession->write(data);
+		boost::mutex::scoped_lock lock(sessionsLock_);
+		for (typename std::list<session_ptr>::iterator i = sessions_.begin(); i!=sessions_.end();)
+		{
+			session_ptr thisSession= *i;
+			if (thisSession->write(data, header, dropped_))
+				i++;
+			else
+			{
+				closed.push_back(thisSession);
+				i = sessions_.erase(i);
+			}
+		}
 	}
+
+	// Detach the overflowed sessions so that their outstanding
+	// handlers don't call back into this server
+	for (typename std::list<session_ptr>::iterator i = closed.begin(); i!=closed.end(); i++)
+		(*i)->close();
+}
+
+template<typename Protocol>
+DropCounts basic_server<Protocol>::dropped()
+{
+	boost::mutex::scoped_lock lock(sessionsLock_);
+	return dropped_;
 }
+template<typename Protocol>
 template<typename T>
-void server::read(std::vector<char, T> & data, size_t index)
+void basic_server<Protocol>::read(std::vector<char, T> & data, size_t index)
 {
 	boost::mutex::scoped_lock lock(pendingDataLock_);
 	int numRead=std::min(data.size()-index, pendingData_.size());
@@ -110,13 +275,26 @@ void server::read(std::vector<char, T> & data, size_t index)
 	pendingData_.erase(pendingData_.begin(), pendingData_.begin()+numRead);
 }
 
-bool server::is_connected()
+template<typename Protocol>
+bool basic_server<Protocol>::is_connected()
 {
+	boost::mutex::scoped_lock lock(sessionsLock_);
 	return !sessions_.empty();
 }
 
+template<typename Protocol>
+std::string basic_server<Protocol>::sendMethod()
+{
+	boost::mutex::scoped_lock lock(sessionsLock_);
+	bool uring = sessions_.empty() ? engine_ && engine_->running() : true;
+	for (typename std::list<session_ptr>::iterator i = sessions_.begin(); uring && i != sessions_.end(); ++i)
+		uring = (*i)->usesIoUring();
+	return uring ? "io_uring" : "asio";
+}
+
+template<typename Protocol>
 template<typename T>
-void server::newSessionData(std::vector<char, T>& data)
+void basic_server<Protocol>::newSessionData(std::vector<char, T>& data)
 {
 	boost::mutex::scoped_lock lock(pendingDataLock_);
 	int oldSize=pendingData_.size();
@@ -128,10 +306,11 @@ void server::newSessionData(std::vector<char, T>& data)
 		newData++;
 	}
 }
-void server::closeSession(session_ptr ptr)
+template<typename Protocol>
+void basic_server<Protocol>::closeSession(session_ptr ptr)
 {
 	boost::mutex::scoped_lock lock(sessionsLock_);
-	for (std::list<session_ptr>::iterator i=sessions_.begin(); i!=sessions_.end(); i++)
+	for (typename std::list<session_ptr>::iterator i=sessions_.begin(); i!=sessions_.end(); i++)
 	{
 		if (ptr==*i)
 		{
@@ -142,60 +321,54 @@ void server::closeSession(session_ptr ptr)
 }
 
 
-void server::start_accept()
+/*
+ * Must be called with sessionsLock_ held
+ */
+template<typename Protocol>
+void basic_server<Protocol>::start_accept()
 {
-	{
-		session_ptr new_session(new session(io_service_, this, maxLength_));
+	session_ptr new_session(new session_type(io_service_, this, maxLength_, limits_, options_, maxGatherBuffers_, zeroCopyCounters_, engine_));
 
-		acceptor_.async_accept(new_session->socket(),
-				boost::bind(&server::handle_accept, this, new_session,
-						boost::asio::placeholders::error));
-	}
+	accepting_ = true;
+	acceptor_.async_accept(new_session->socket(),
+			boost::bind(&basic_server<Protocol>::handle_accept, this, new_session,
+					boost::asio::placeholders::error));
 }
 
-void server::handle_accept(session_ptr new_session,
+template<typename Protocol>
+void basic_server<Protocol>::handle_accept(session_ptr new_session,
 		const boost::system::error_code& error)
 {
-		if (!error)
-		{
-			{
-				boost::mutex::scoped_lock lock(sessionsLock_);
-				sessions_.push_back(new_session);
-
-				session_ptr new_session(new session(io_service_, this, maxLength_));
-				acceptor_.async_accept(new_session->socket(),
-								boost::bind(&server::handle_accept, this, new_session,
-										boost::asio::placeholders::error));
-			}
-			new_session->start();
-		}
-		start_accept();
-}
+	boost::mutex::scoped_lock lock(sessionsLock_);
+	accepting_ = false;
 
-void server::run()
-{
-	try
+	// Once the acceptor is closed, the destructor is waiting
+	// for this handler to finish and has already closed the
+	// sessions, so a connection accepted just before then is
+	// dropped rather than started against a dying server
+	if (!acceptor_.is_open() || error == boost::asio::error::operation_aborted)
 	{
-		io_service_.run();
+		new_session->close();
+		acceptDone_.notify_all();
+		return;
 	}
-	catch (std::exception& e)
+
+	if (!error)
 	{
-		std::cerr << "Exception in thread: " << e.what() << "\n";
-		std::exit(1);
+		sessions_.push_back(new_session);
+		new_session->start();
 	}
+
+	start_accept();
 }
 
 //need to put these bad boys in here for templates or you get undefined references when linking ...grr...
 
-template void server::read(std::vector<char, std::allocator<char> >&, size_t);
-//template void server::read(std::vector<char, _seqVector::seqVectorAllocator<char> >&, size_t);
+template class basic_session<tcp>;
+template class basic_server<tcp>;
+template void basic_server<tcp>::read(std::vector<char, std::allocator<char> >&, size_t);
 
-template void server::write(std::vector<unsigned char, std::allocator<unsigned char> >&);
-template void server::write(std::vector<char, std::allocator<char> >&);
-template void server::write(std::vector<signed char, std::allocator<signed char> >&);
-template void server::write(std::vector<CORBA::Short, std::allocator<CORBA::Short> >&);
-template void server::write(std::vector<CORBA::UShort, std::allocator<CORBA::UShort> >&);
-template void server::write(std::vector<CORBA::Long, std::allocator<CORBA::Long> >&);
-template void server::write(std::vector<CORBA::ULong, std::allocator<CORBA::ULong> >&);
-template void server::write(std::vector<CORBA::Float, std::allocator<CORBA::Float> >&);
-template void server::write(std::vector<CORBA::Double, std::allocator<CORBA::Double> >&);
+template class basic_session<unix_protocol>;
+template class basic_server<unix_protocol>;
+template void basic_server<unix_protocol>::read(std::vector<char, std::allocator<char> >&, size_t);
+//template void server::read(std::vector<char, _seqVector::seqVectorAllocator<char> >&, size_t);
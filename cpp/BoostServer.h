@@ -30,30 +30,65 @@
 #include <boost/enable_shared_from_this.hpp>
 #include <deque>
 
+#include "IoUringSender.h"
+#include "SendQueue.h"
+#include "SharedBuffer.h"
+#include "SocketOptions.h"
+#include "UnixProtocol.h"
+#include "ZeroCopy.h"
+
 using boost::asio::ip::tcp;
 
-class server;
+template<typename Protocol>
+class basic_server;
 
-class session :  public boost::enable_shared_from_this<session>
+template<typename Protocol>
+class basic_session :  public boost::enable_shared_from_this<basic_session<Protocol> >
 {
 public:
-	session(boost::asio::io_service& io_service, server* s, size_t max_length)
+	typedef typename Protocol::socket socket_type;
+
+	basic_session(boost::asio::io_service& io_service, basic_server<Protocol>* s, size_t max_length, const QueueLimits& limits, const SocketOptions& options, size_t max_gather_buffers, const boost::shared_ptr<ZeroCopyCounters>& zero_copy_counters, IoUringSender* engine)
 	: socket_(io_service),
 	  server_(s),
 	  read_data_(max_length),
-	  max_length_(max_length)
+	  max_length_(max_length),
+	  writeBuffer_(limits, SendQueue::DEFAULT_GATHER_BYTES, max_gather_buffers),
+	  options_(options),
+	  zeroCopy_(zero_copy_counters),
+	  errorWait_(false),
+	  uring_(engine)
+	{
+	}
+
+	/*
+	 * The socket is closed after the zero copy tracker is gone,
+	 * so hand it whatever the kernel still has pinned first
+	 */
+	~basic_session()
 	{
+		zeroCopy_.closing(socket_.native_handle());
 	}
 
-	tcp::socket& socket()
+	socket_type& socket()
 	{
 		return socket_;
 	}
 
 	void start();
 
-	template<typename T, typename U>
-	void write(std::vector<T, U>& data);
+	/*
+	 * Detach from the server and close the socket.  Once this
+	 * returns, no handler of this session will call the server
+	 */
+	void close();
+
+	bool write(const SharedBuffer& data, const SharedBuffer& header, DropCounts& dropped);
+
+	/*
+	 * Whether writes go through the io_uring engine
+	 */
+	bool usesIoUring();
 
 
 
@@ -64,51 +99,119 @@ private:
 
 	void handle_write(const boost::system::error_code& error);
 
+	void handle_zero_copy_write(const boost::system::error_code& error, boost::uint32_t sends);
+
+	void start_write();
 
-	tcp::socket socket_;
-	server* server_;
+	void poll_completions();
+
+	void handle_completions(const boost::system::error_code& error);
+
+
+	socket_type socket_;
+	basic_server<Protocol>* server_;
 	std::vector<char> read_data_;
 	size_t max_length_;
-	std::deque<std::vector<char> > writeBuffer_;
+	SendQueue writeBuffer_;
+	SocketOptions options_;
+	std::vector<boost::asio::const_buffer> writeSequence_;
 	boost::mutex writeLock_;
+	boost::mutex serverLock_;
+	ZeroCopyTracker zeroCopy_;
+	bool errorWait_;
+	IoUringFile uring_;
 
 };
 
-typedef boost::shared_ptr<session> session_ptr;
-
-class server
+/*
+ * A listener that sends everything written to it to all of
+ * its sessions.  The server runs on a shared io_service, so
+ * its destructor closes everything and waits for its
+ * outstanding accept to finish instead of stopping the
+ * io_service.  With a protocol that keeps packet boundaries,
+ * each packet goes out in a write of its own.  Over TCP,
+ * sessions send packets of at least the zero copy threshold
+ * with MSG_ZEROCOPY.  Given a running io_uring engine, sessions
+ * send their other writes through it.
+ */
+template<typename Protocol>
+class basic_server
 {
 public:
-	server(short port, size_t maxLength=1024) :
-		acceptor_(io_service_, tcp::endpoint(tcp::v4(), port)),
-		thread_(NULL),
-		maxLength_(maxLength)
+	typedef basic_session<Protocol> session_type;
+	typedef boost::shared_ptr<session_type> session_ptr;
+	typedef typename Protocol::endpoint endpoint_type;
+
+	basic_server(boost::asio::io_service& io_service, const Protocol& protocol, const endpoint_type& endpoint, const QueueLimits& limits=QueueLimits(), const SocketOptions& options=SocketOptions(), IoUringSender* engine=NULL, size_t maxLength=1024) :
+		io_service_(io_service),
+		acceptor_(io_service),
+		endpoint_(endpoint),
+		accepting_(false),
+		maxLength_(maxLength),
+		maxGatherBuffers_(protocol.type() == SOCK_SEQPACKET ? 1 : SendQueue::DEFAULT_GATHER_BUFFERS),
+		limits_(limits),
+		options_(options),
+		zeroCopyCounters_(new ZeroCopyCounters),
+		engine_(engine)
 	{
+		// Clear out a socket file left behind by an earlier run,
+		// but never one that a live server is listening on
+		remove_stale_socket_file(endpoint_, protocol);
+
+		acceptor_.open(protocol);
+		acceptor_.set_option(typename Protocol::acceptor::reuse_address(true));
+		acceptor_.bind(endpoint_);
+		acceptor_.listen();
+
+		boost::mutex::scoped_lock lock(sessionsLock_);
 		start_accept();
-		thread_ = new boost::thread(boost::bind(&server::run, this));
 	}
 
-	~server()
+	~basic_server()
 	{
-		if(thread_)
-		{
-			io_service_.stop();
-			thread_->join();
-			delete thread_;
-		}
-
+		std::list<session_ptr> sessions;
 		{
 			boost::mutex::scoped_lock lock(sessionsLock_);
-			sessions_.clear();
+			boost::system::error_code ec;
+			acceptor_.close(ec);
+			sessions.swap(sessions_);
 		}
+
+		for (typename std::list<session_ptr>::iterator i = sessions.begin(); i != sessions.end(); ++i)
+			(*i)->close();
+
+		boost::mutex::scoped_lock lock(sessionsLock_);
+		while (accepting_)
+			acceptDone_.wait(lock);
+
+		unlink_socket_file(endpoint_);
 	}
 
-	template<typename T, typename U>
-	void write(std::vector<T, U>& data);
+	void write(const SharedBuffer& data, const SharedBuffer& header=SharedBuffer());
 	template<typename T>
 	void read(std::vector<char, T> & data, size_t index=0);
 	bool is_connected();
 
+	/*
+	 * Everything discarded by the send queues of this server's
+	 * sessions so far
+	 */
+	DropCounts dropped();
+
+	/*
+	 * Zero copy sends made by all of this server's sessions so far
+	 */
+	ZeroCopyCounts zeroCopyCounts() const
+	{
+		return zeroCopyCounters_->load();
+	}
+
+	/*
+	 * io_uring if every session writes through the engine, or if
+	 * there are none yet and the engine is running, else asio
+	 */
+	std::string sendMethod();
+
 	template<typename T>
 	void newSessionData(std::vector<char, T>& data);
 	void closeSession(session_ptr ptr);
@@ -119,17 +222,29 @@ private:
 	void handle_accept(session_ptr new_session,
 			const boost::system::error_code& error);
 
-	void run();
-
-	boost::asio::io_service io_service_;
-	tcp::acceptor acceptor_;
+	boost::asio::io_service& io_service_;
+	typename Protocol::acceptor acceptor_;
+	endpoint_type endpoint_;
 	std::list<session_ptr> sessions_;
 	std::vector<char> pendingData_;
 	boost::mutex sessionsLock_;
 	boost::mutex pendingDataLock_;
-	boost::thread* thread_;
+	boost::condition_variable acceptDone_;
+	bool accepting_;
 	size_t maxLength_;
+	size_t maxGatherBuffers_;
+	QueueLimits limits_;
+	SocketOptions options_;
+	boost::shared_ptr<ZeroCopyCounters> zeroCopyCounters_;
+	IoUringSender* engine_;
+	DropCounts dropped_;
 };
 
+typedef basic_session<tcp> session;
+typedef boost::shared_ptr<session> session_ptr;
+typedef basic_server<tcp> server;
+
+typedef basic_server<unix_protocol> unix_server;
+
 
 #endif /* BOOSTSERVER_H_ */
@@ -0,0 +1,631 @@
+/*
+ * This file is protected by Copyright. Please refer to the COPYRIGHT file distributed with this 
+ * source distribution.
+ * 
+ * This file is part of REDHAWK Basic Components sinksocket.
+ * 
+ * REDHAWK Basic Components sinksocket is free software: you can redistribute it and/or modify it under the terms of 
+ * the GNU Lesser General Public License as published by the Free Software Foundation, either 
+ * version 3 of the License, or (at your option) any later version.
+ * 
+ * REDHAWK Basic Components sinksocket is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; 
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR 
+ * PURPOSE.  See the GNU Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public License along with this 
+ * program.  If not, see http://www.gnu.org/licenses/.
+ */
+
+#ifndef BOOSTUDPCLIENT_H_
+#define BOOSTUDPCLIENT_H_
+
+#include <iostream>
+#include <boost/asio.hpp>
+#include <boost/bind.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/thread.hpp>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <sys/socket.h>
+
+#include "ResolverCache.h"
+#include "SendQueue.h"
+#include "SharedBuffer.h"
+#include "SocketOptions.h"
+
+using boost::asio::ip::udp;
+
+#ifndef SOL_UDP
+#define SOL_UDP 17
+#endif
+
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+
+/*
+ * The header at the front of every datagram, in network byte
+ * order.  A packet that doesn't fit in one datagram is split
+ * across consecutive datagrams with increasing offsets, so a
+ * receiver can spot a lost datagram by the gap in sequence
+ * numbers and put each packet back together from the offsets.
+ */
+struct DatagramHeader
+{
+	boost::uint32_t sequence;	// counts every datagram sent to this port
+	boost::uint32_t packet;		// counts every packet sent to this port
+	boost::uint32_t offset;		// where this datagram's payload starts in the packet
+	boost::uint32_t length;		// size of the whole packet
+};
+
+/*
+ * How a udp_client sending to a multicast group reaches it:
+ * the TTL of its datagrams, the interface they leave by, either
+ * by address or by name, with empty meaning the system default,
+ * and whether receivers on this host get a copy
+ */
+struct MulticastOptions
+{
+	MulticastOptions(bool enabled=false, unsigned short ttl=1, const std::string& interface="", bool loopback=true) :
+		enabled(enabled),
+		ttl(ttl),
+		interface(interface),
+		loopback(loopback)
+	{}
+
+	bool enabled;
+	unsigned short ttl;
+	std::string interface;
+	bool loopback;
+};
+
+/*
+ * Sends packets to one UDP port, split into datagrams that fit
+ * in the MTU.  Like a client, it queues each packet and returns
+ * immediately, sending from the calling thread until the socket
+ * buffer fills and then from the io_service once there is room
+ * again.  Nothing is retransmitted; datagrams the network loses
+ * stay lost.  Sent to a multicast group, one copy of each
+ * datagram reaches every receiver that joined it.  Datagrams
+ * go out in batches of up to MAX_BATCH per system call, either
+ * separately with sendmmsg or, with GSO, as runs of up to 64
+ * equal sized datagrams that the kernel splits apart.
+ */
+class udp_client
+{
+public:
+	static const size_t MAX_BATCH = 256;
+
+	udp_client(boost::asio::io_service& io_service, unsigned short port, const boost::shared_ptr<ResolverCache>& resolver, const QueueLimits& limits=QueueLimits(), const SocketOptions& options=SocketOptions(), size_t mtu=1500, const MulticastOptions& multicast=MulticastOptions()) :
+		s_(io_service),
+		resolver_(resolver),
+		resolveTicket_(0),
+		port_(port),
+		mtu_(mtu),
+		payload_(0),
+		writeBuffer_(limits),
+		options_(options),
+		multicast_(multicast),
+		connected_(false),
+		resolving_(false),
+		closing_(false),
+		failed_(false),
+		sequence_(0),
+		packet_(0),
+		current_(0),
+		offset_(0),
+		datagrams_(0),
+		gsoSegments_(1),
+		sendError_(0),
+		messages_(MAX_BATCH),
+		batch_(MAX_BATCH),
+		headers_(MAX_BATCH),
+		iovecs_(2*MAX_BATCH),
+		controls_(MAX_BATCH*CONTROL_SIZE)
+	{
+	}
+
+	/*
+	 * Close the socket and wait for the outstanding lookup and
+	 * send, if any, to finish with this client
+	 */
+	~udp_client()
+	{
+		boost::mutex::scoped_lock lock(writeLock_);
+		boost::system::error_code ec;
+		closing_ = true;
+		if (resolveTicket_)
+			resolver_->cancel(resolveTicket_);
+		s_.close(ec);
+		while (resolving_ || writeBuffer_.writing())
+			writeDone_.wait(lock);
+	}
+
+	/*
+	 * Start looking up the destination in the background, unless
+	 * that is already done.  Returns whether the socket is ready
+	 * to send
+	 */
+	bool connect()
+	{
+		boost::mutex::scoped_lock lock(writeLock_);
+		if (!connected_)
+			start_resolve();
+		return connected_;
+	}
+
+	bool connect_if_necessary()
+	{
+		return connect();
+	}
+
+	bool is_connected()
+	{
+		boost::mutex::scoped_lock lock(writeLock_);
+		return connected_;
+	}
+
+	/*
+	 * Whether the last attempt to set up the socket failed
+	 */
+	bool failed()
+	{
+		boost::mutex::scoped_lock lock(writeLock_);
+		return failed_;
+	}
+
+	/*
+	 * Queue the data to be sent and return once the socket can
+	 * take no more of it.  Returns false if the data was not
+	 * queued, either because the socket isn't set up yet or
+	 * because the send queue is full
+	 */
+	bool write(const SharedBuffer& data)
+	{
+		boost::mutex::scoped_lock lock(writeLock_);
+		if (!connected_)
+		{
+			start_resolve();
+			return false;
+		}
+
+		switch (writeBuffer_.push(data, dropped_))
+		{
+		case SendQueue::START_WRITE:
+			start_write();
+			return true;
+		case SendQueue::QUEUED:
+			return true;
+		case SendQueue::OVERFLOWED:
+			// There is no connection to drop, so emptying the queue
+			// is all the disconnect policy does here
+			std::cerr<<"ERROR udp send queue overflowed, discarding queued packets"<<std::endl;
+			return false;
+		default:
+			return false;
+		}
+	}
+
+	/*
+	 * Everything discarded so far, by the send queue or because
+	 * the socket refused it
+	 */
+	DropCounts dropped()
+	{
+		boost::mutex::scoped_lock lock(writeLock_);
+		return dropped_;
+	}
+
+	/*
+	 * The system call batches of datagrams are sent with, and
+	 * whether the kernel splits runs of them apart with GSO.  GSO
+	 * is turned off for good if the route turns out not to
+	 * support it
+	 */
+	std::string sendMethod()
+	{
+		boost::mutex::scoped_lock lock(writeLock_);
+#ifdef HAVE_SENDMMSG
+		std::string method = "sendmmsg";
+#else
+		std::string method = "sendmsg";
+#endif
+		return gsoSegments_ > 1 ? method + "+gso" : method;
+	}
+
+	/*
+	 * The number of datagrams sent so far
+	 */
+	boost::uint64_t datagrams()
+	{
+		boost::mutex::scoped_lock lock(writeLock_);
+		return datagrams_;
+	}
+
+private:
+	/*
+	 * Must be called with writeLock_ held
+	 */
+	void start_resolve()
+	{
+		if (connected_ || resolving_ || closing_)
+			return;
+
+		resolving_ = true;
+		resolveTicket_ = resolver_->async_resolve(boost::bind(&udp_client::handle_resolve, this, _1, _2));
+	}
+
+	/*
+	 * Open a socket connected to the first address of the host,
+	 * so that every send goes there without a route lookup
+	 */
+	void handle_resolve(const boost::system::error_code& error, const ResolverCache::Addresses& addresses)
+	{
+		boost::mutex::scoped_lock lock(writeLock_);
+		resolveTicket_ = 0;
+		resolving_ = false;
+		writeDone_.notify_all();
+
+		if (closing_ || error == boost::asio::error::operation_aborted)
+			return;
+
+		if (error)
+		{
+			std::cerr<<"ERROR unable to look up "<<resolver_->host()<<": "<<error.message()<<std::endl;
+			failed_ = true;
+			return;
+		}
+
+		udp::endpoint endpoint(addresses.front(), port_);
+		boost::system::error_code ec;
+		s_.open(endpoint.protocol(), ec);
+		if (!ec)
+		{
+			options_.apply(s_, endpoint.address().is_v6());
+			if (multicast_.enabled)
+				setup_multicast(endpoint.address(), ec);
+		}
+		if (!ec)
+			s_.non_blocking(true, ec);
+		if (!ec)
+			s_.connect(endpoint, ec);
+		if (ec)
+		{
+			std::cerr<<"ERROR unable to open udp socket to "<<endpoint<<": "<<ec.message()<<std::endl;
+			s_.close(ec);
+			failed_ = true;
+			return;
+		}
+
+		// Leave room for the IP and UDP headers as well as our own
+		size_t overhead = (endpoint.address().is_v6() ? 40 : 20) + 8 + sizeof(DatagramHeader);
+		payload_ = mtu_ > overhead ? mtu_ - overhead : 1;
+
+		// A run of segments has to fit in one UDP datagram
+		gsoSegments_ = 1;
+		if (options_.udpGso)
+		{
+			size_t limit = (endpoint.address().is_v6() ? 65535 : 65535 - 20) - 8;
+			size_t segments = limit / (sizeof(DatagramHeader) + payload_);
+			gsoSegments_ = segments > MAX_GSO_SEGMENTS ? MAX_GSO_SEGMENTS : std::max<size_t>(segments, 1);
+		}
+		connected_ = true;
+		failed_ = false;
+	}
+
+	/*
+	 * Set up the socket to send to a multicast group
+	 */
+	void setup_multicast(const boost::asio::ip::address& group, boost::system::error_code& ec)
+	{
+		if (!group.is_multicast())
+		{
+			std::cerr<<"ERROR "<<group<<" is not a multicast group"<<std::endl;
+			ec = boost::asio::error::invalid_argument;
+			return;
+		}
+
+		s_.set_option(boost::asio::ip::multicast::hops(multicast_.ttl), ec);
+		if (!ec)
+			s_.set_option(boost::asio::ip::multicast::enable_loopback(multicast_.loopback), ec);
+		if (ec || multicast_.interface.empty())
+			return;
+
+		// The interface may be given as one of its addresses or by name
+		boost::system::error_code parseError;
+		boost::asio::ip::address address = boost::asio::ip::address::from_string(multicast_.interface, parseError);
+		if (!parseError && address.is_v4() && group.is_v4())
+		{
+			s_.set_option(boost::asio::ip::multicast::outbound_interface(address.to_v4()), ec);
+			return;
+		}
+
+		unsigned int index = if_nametoindex(multicast_.interface.c_str());
+		if (index == 0)
+		{
+			std::cerr<<"ERROR unknown multicast interface "<<multicast_.interface<<std::endl;
+			ec = boost::asio::error::invalid_argument;
+		}
+		else if (group.is_v6())
+		{
+			s_.set_option(boost::asio::ip::multicast::outbound_interface(index), ec);
+		}
+		else
+		{
+			struct ip_mreqn request;
+			memset(&request, 0, sizeof(request));
+			request.imr_ifindex = index;
+			if (setsockopt(s_.native_handle(), IPPROTO_IP, IP_MULTICAST_IF, &request, sizeof(request)) != 0)
+				ec = boost::system::error_code(errno, boost::asio::error::get_system_category());
+		}
+	}
+
+	/*
+	 * Must be called with writeLock_ held
+	 */
+	void start_write()
+	{
+		if (!writeBuffer_.writing())
+		{
+			if (!writeBuffer_.startWrite(writeSequence_))
+				return;
+			current_ = 0;
+			offset_ = 0;
+		}
+
+		send_pending();
+	}
+
+	/*
+	 * Send datagrams until the queue is empty or the socket
+	 * buffer is full, in which case wait for room.  Each pass
+	 * hands the kernel a batch of datagrams with one system call,
+	 * and with GSO each message in the batch carries a run of
+	 * equal sized datagrams from one packet for the kernel to
+	 * split.  Must be called with writeLock_ held
+	 */
+	void send_pending()
+	{
+		do
+		{
+			while (true)
+			{
+				// Empty packets have nothing to send, but still count
+				while (current_ != writeSequence_.size() && boost::asio::buffer_size(writeSequence_[current_]) == 0)
+				{
+					++current_;
+					++packet_;
+				}
+				if (current_ == writeSequence_.size())
+					break;
+
+				size_t messages = build_batch();
+				int sent = send_batch(messages);
+				if (sent < 0)
+				{
+					if (errno == EAGAIN || errno == EWOULDBLOCK)
+					{
+						s_.async_send(boost::asio::null_buffers(),
+							boost::bind(&udp_client::handle_writable, this,
+									boost::asio::placeholders::error));
+						return;
+					}
+					else if (errno == ECONNREFUSED || errno == EINTR)
+					{
+						// Nobody was listening for an earlier datagram.  That
+						// is no reason to stop, and this batch wasn't sent yet
+						continue;
+					}
+					else if (gsoSegments_ > 1 && (errno == EIO || errno == EINVAL || errno == ENOPROTOOPT || errno == EOPNOTSUPP))
+					{
+						std::cerr<<"WARN unable to segment udp datagrams ("<<strerror(errno)<<"), sending them separately"<<std::endl;
+						gsoSegments_ = 1;
+						continue;
+					}
+
+					// A lasting error fails every packet, so only say
+					// when it starts; the drop counts keep track
+					if (errno != sendError_)
+					{
+						std::cerr<<"ERROR sending udp data: "<<strerror(errno)<<", dropping packets until it clears"<<std::endl;
+						sendError_ = errno;
+					}
+					size_t size = boost::asio::buffer_size(writeSequence_[current_]);
+					dropped_.packets++;
+					dropped_.bytes+=size-offset_;
+					++current_;
+					++packet_;
+					offset_ = 0;
+					continue;
+				}
+
+				if (sendError_)
+				{
+					std::cerr<<"INFO sending udp data again"<<std::endl;
+					sendError_ = 0;
+				}
+
+				// Move past what went out, leaving the rest to try again
+				for (int i=0; i!=sent; i++)
+				{
+					sequence_ += batch_[i].datagrams;
+					datagrams_ += batch_[i].datagrams;
+					offset_ += batch_[i].bytes;
+					if (offset_ == boost::asio::buffer_size(writeSequence_[current_]))
+					{
+						++current_;
+						++packet_;
+						offset_ = 0;
+					}
+				}
+			}
+
+			writeBuffer_.writeComplete();
+			writeDone_.notify_all();
+			current_ = 0;
+			offset_ = 0;
+		} while (!closing_ && writeBuffer_.startWrite(writeSequence_));
+	}
+
+	/*
+	 * Lay out as many of the datagrams still to send as fit in a
+	 * batch, starting from the current position, and return the
+	 * number of messages they take.  An empty packet ends the
+	 * batch early.  Must be called with writeLock_ held
+	 */
+	size_t build_batch()
+	{
+		size_t messages = 0;
+		size_t datagrams = 0;
+		size_t packet = current_;
+		size_t offset = offset_;
+
+		while (packet != writeSequence_.size() && messages != MAX_BATCH && datagrams != MAX_BATCH)
+		{
+			const char* data = boost::asio::buffer_cast<const char*>(writeSequence_[packet]);
+			size_t size = boost::asio::buffer_size(writeSequence_[packet]);
+			if (size == 0)
+				break;
+
+			// Only the last datagram of a message may be short, so a
+			// run stops at the end of its packet
+			size_t first = datagrams;
+			size_t bytes = 0;
+			do
+			{
+				size_t chunk = std::min(payload_, size - offset);
+				DatagramHeader& header = headers_[datagrams];
+				header.sequence = htonl(sequence_ + datagrams);
+				header.packet = htonl(packet_ + (packet - current_));
+				header.offset = htonl(offset);
+				header.length = htonl(size);
+
+				iovecs_[2*datagrams].iov_base = &header;
+				iovecs_[2*datagrams].iov_len = sizeof(header);
+				iovecs_[2*datagrams+1].iov_base = const_cast<char*>(data + offset);
+				iovecs_[2*datagrams+1].iov_len = chunk;
+
+				++datagrams;
+				offset += chunk;
+				bytes += chunk;
+			} while (offset != size && datagrams - first != gsoSegments_ && datagrams != MAX_BATCH);
+
+			struct msghdr& msg = messages_[messages].msg_hdr;
+			memset(&msg, 0, sizeof(msg));
+			msg.msg_iov = &iovecs_[2*first];
+			msg.msg_iovlen = 2*(datagrams - first);
+			if (datagrams - first > 1)
+			{
+				msg.msg_control = &controls_[messages * CONTROL_SIZE];
+				msg.msg_controllen = CONTROL_SIZE;
+				struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+				cmsg->cmsg_level = SOL_UDP;
+				cmsg->cmsg_type = UDP_SEGMENT;
+				cmsg->cmsg_len = CMSG_LEN(sizeof(boost::uint16_t));
+				boost::uint16_t segment = sizeof(DatagramHeader) + payload_;
+				memcpy(CMSG_DATA(cmsg), &segment, sizeof(segment));
+			}
+
+			batch_[messages].datagrams = datagrams - first;
+			batch_[messages].bytes = bytes;
+			++messages;
+
+			if (offset == size)
+			{
+				++packet;
+				offset = 0;
+			}
+		}
+
+		return messages;
+	}
+
+	/*
+	 * Returns the number of messages sent, or -1 with errno set
+	 * if not even the first one was
+	 */
+	int send_batch(size_t messages)
+	{
+#ifdef HAVE_SENDMMSG
+		return sendmmsg(s_.native_handle(), &messages_[0], messages, MSG_DONTWAIT);
+#else
+		for (size_t i=0; i!=messages; i++)
+		{
+			if (sendmsg(s_.native_handle(), &messages_[i].msg_hdr, MSG_DONTWAIT) < 0)
+				return i ? static_cast<int>(i) : -1;
+		}
+		return messages;
+#endif
+	}
+
+	void handle_writable(const boost::system::error_code& error)
+	{
+		boost::mutex::scoped_lock lock(writeLock_);
+		if (closing_ || error)
+		{
+			// Whatever was still to be sent is lost
+			if (error)
+			{
+				for (size_t i=current_; i!=writeSequence_.size(); i++)
+				{
+					dropped_.packets++;
+					dropped_.bytes+=boost::asio::buffer_size(writeSequence_[i]) - (i == current_ ? offset_ : 0);
+				}
+				writeBuffer_.clear(dropped_);
+			}
+			else
+				writeBuffer_.clear();
+			writeDone_.notify_all();
+			return;
+		}
+
+		send_pending();
+	}
+
+	udp::socket s_;
+	boost::shared_ptr<ResolverCache> resolver_;
+	unsigned long resolveTicket_;
+	unsigned short port_;
+	size_t mtu_;
+	size_t payload_;
+	SendQueue writeBuffer_;
+	SocketOptions options_;
+	MulticastOptions multicast_;
+	bool connected_;
+	bool resolving_;
+	bool closing_;
+	bool failed_;
+	boost::uint32_t sequence_;
+	boost::uint32_t packet_;
+	std::vector<boost::asio::const_buffer> writeSequence_;
+	size_t current_;
+	size_t offset_;
+	boost::uint64_t datagrams_;
+	size_t gsoSegments_;
+	int sendError_;
+
+	// Where each batch is laid out: a message per run of
+	// datagrams, and a header and a payload iovec per datagram
+	struct BatchEntry
+	{
+		size_t datagrams;
+		size_t bytes;
+	};
+	static const size_t MAX_GSO_SEGMENTS = 64;
+	static const size_t CONTROL_SIZE = CMSG_SPACE(sizeof(boost::uint16_t));
+	std::vector<struct mmsghdr> messages_;
+	std::vector<BatchEntry> batch_;
+	std::vector<DatagramHeader> headers_;
+	std::vector<struct iovec> iovecs_;
+	std::vector<char> controls_;
+	boost::mutex writeLock_;
+	boost::condition_variable writeDone_;
+	DropCounts dropped_;
+};
+
+
+#endif /* BOOSTUDPCLIENT_H_ */
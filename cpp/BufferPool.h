@@ -0,0 +1,110 @@
+/*
+ * This file is protected by Copyright. Please refer to the COPYRIGHT file distributed with this 
+ * source distribution.
+ * 
+ * This file is part of REDHAWK Basic Components sinksocket.
+ * 
+ * REDHAWK Basic Components sinksocket is free software: you can redistribute it and/or modify it under the terms of 
+ * the GNU Lesser General Public License as published by the Free Software Foundation, either 
+ * version 3 of the License, or (at your option) any later version.
+ * 
+ * REDHAWK Basic Components sinksocket is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; 
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR 
+ * PURPOSE.  See the GNU Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public License along with this 
+ * program.  If not, see http://www.gnu.org/licenses/.
+ */
+
+#ifndef BUFFERPOOL_H_
+#define BUFFERPOOL_H_
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <vector>
+
+/*
+ * A pool of byte vectors for building outgoing data.  get()
+ * hands out a vector that goes back to the pool, keeping its
+ * capacity, once the last reference to it is released; that
+ * may happen on any thread, and may be after the pool itself
+ * is gone.
+ */
+class BufferPool
+{
+public:
+	typedef boost::shared_ptr<std::vector<char> > BufferPtr;
+
+	BufferPool(size_t max_free=64) :
+		state_(new State(max_free))
+	{}
+
+	/*
+	 * A vector of exactly size bytes.  Its contents are undefined
+	 */
+	BufferPtr get(size_t size)
+	{
+		std::vector<char>* buffer = NULL;
+		{
+			boost::mutex::scoped_lock lock(state_->lock);
+			if (!state_->free.empty())
+			{
+				buffer = state_->free.back();
+				state_->free.pop_back();
+			}
+		}
+
+		if (!buffer)
+			buffer = new std::vector<char>();
+
+		buffer->resize(size);
+		return BufferPtr(buffer, Recycler(state_));
+	}
+
+private:
+	struct State
+	{
+		State(size_t max_free) :
+			maxFree(max_free)
+		{}
+
+		~State()
+		{
+			for (size_t i=0; i!=free.size(); i++)
+				delete free[i];
+		}
+
+		boost::mutex lock;
+		std::vector<std::vector<char>*> free;
+		size_t maxFree;
+	};
+
+	/*
+	 * The deleter for buffers handed out by get()
+	 */
+	struct Recycler
+	{
+		Recycler(const boost::shared_ptr<State>& state) :
+			state_(state)
+		{}
+
+		void operator()(std::vector<char>* buffer)
+		{
+			{
+				boost::mutex::scoped_lock lock(state_->lock);
+				if (state_->free.size() < state_->maxFree)
+				{
+					state_->free.push_back(buffer);
+					return;
+				}
+			}
+			delete buffer;
+		}
+
+		boost::shared_ptr<State> state_;
+	};
+
+	boost::shared_ptr<State> state_;
+};
+
+#endif /* BUFFERPOOL_H_ */
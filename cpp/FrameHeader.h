@@ -0,0 +1,109 @@
+/*
+ * This file is protected by Copyright. Please refer to the COPYRIGHT file distributed with this 
+ * source distribution.
+ * 
+ * This file is part of REDHAWK Basic Components sinksocket.
+ * 
+ * REDHAWK Basic Components sinksocket is free software: you can redistribute it and/or modify it under the terms of 
+ * the GNU Lesser General Public License as published by the Free Software Foundation, either 
+ * version 3 of the License, or (at your option) any later version.
+ * 
+ * REDHAWK Basic Components sinksocket is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; 
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR 
+ * PURPOSE.  See the GNU Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public License along with this 
+ * program.  If not, see http://www.gnu.org/licenses/.
+ */
+
+#ifndef FRAMEHEADER_H_
+#define FRAMEHEADER_H_
+
+#include "PacketTime.h"
+
+#include <boost/cstdint.hpp>
+#include <cstring>
+#include <endian.h>
+
+/*
+ * The header in front of every packet sent by a connection with
+ * header framing, so that a receiver can find the packets in a
+ * byte stream, resynchronize after a partial read by searching
+ * for the magic number, and recover the timing of the samples.
+ * Every field is in network byte order; the payload that follows
+ * is exactly length bytes.
+ */
+struct FrameHeader
+{
+	boost::uint32_t magic;			// FRAME_MAGIC
+	boost::uint16_t version;		// FRAME_VERSION
+	boost::uint16_t headerSize;		// sizeof(FrameHeader), to skip fields added later
+	boost::uint32_t sequence;		// counts every packet of this data type
+	boost::uint32_t length;			// size of the payload in bytes
+	boost::uint8_t dataType;		// the input port, as a struct module format character
+	boost::uint8_t byteOrder;		// FRAME_LITTLE_ENDIAN, FRAME_BIG_ENDIAN or FRAME_OTHER_ORDER
+	boost::uint16_t byteSwap;		// the connection's byte swap, 0 if none
+	boost::uint8_t flags;			// FRAME_SRI_CHANGED, FRAME_EOS, FRAME_TIME_VALID
+	boost::uint8_t reserved[3];
+	boost::uint64_t seconds;		// whole seconds of the first sample's time
+	boost::uint64_t picoseconds;	// and the fraction of a second
+	boost::uint64_t sampleDelta;	// the SRI xdelta, as the bits of an IEEE double
+};
+
+const boost::uint32_t FRAME_MAGIC = 0x534e4b46;	// "SNKF"
+const boost::uint16_t FRAME_VERSION = 1;
+
+enum FrameByteOrder
+{
+	FRAME_LITTLE_ENDIAN = 0,
+	FRAME_BIG_ENDIAN = 1,
+	FRAME_OTHER_ORDER = 2	// swapped at a width other than the sample size
+};
+
+enum FrameFlags
+{
+	FRAME_SRI_CHANGED = 1,	// the SRI changed with this packet
+	FRAME_EOS = 2,			// this packet ends its stream
+	FRAME_TIME_VALID = 4	// the time stamp is valid
+};
+
+/*
+ * Fill in a header for a payload of length bytes of samples of
+ * sampleSize bytes, byte swapped at numSwap bytes
+ */
+inline void encodeFrameHeader(FrameHeader& header, char dataType, size_t sampleSize, size_t length, boost::uint32_t sequence, unsigned short numSwap, boost::uint8_t flags, double wholeSeconds, double fractionalSeconds, double sampleDelta)
+{
+#if __BYTE_ORDER == __BIG_ENDIAN
+	boost::uint8_t hostOrder = FRAME_BIG_ENDIAN;
+#else
+	boost::uint8_t hostOrder = FRAME_LITTLE_ENDIAN;
+#endif
+
+	header.magic = htobe32(FRAME_MAGIC);
+	header.version = htobe16(FRAME_VERSION);
+	header.headerSize = htobe16(sizeof(FrameHeader));
+	header.sequence = htobe32(sequence);
+	header.length = htobe32(length);
+	header.dataType = dataType;
+	if (numSwap <= 1 || sampleSize == 1)
+		header.byteOrder = hostOrder;
+	else if (numSwap == sampleSize)
+		header.byteOrder = FRAME_BIG_ENDIAN + FRAME_LITTLE_ENDIAN - hostOrder;
+	else
+		header.byteOrder = FRAME_OTHER_ORDER;
+	header.byteSwap = htobe16(numSwap);
+	header.flags = flags;
+	memset(header.reserved, 0, sizeof(header.reserved));
+
+	boost::uint64_t seconds;
+	boost::uint64_t picoseconds;
+	splitTime(wholeSeconds, fractionalSeconds, 0, seconds, picoseconds);
+	header.seconds = htobe64(seconds);
+	header.picoseconds = htobe64(picoseconds);
+
+	boost::uint64_t delta;
+	memcpy(&delta, &sampleDelta, sizeof(delta));
+	header.sampleDelta = htobe64(delta);
+}
+
+#endif /* FRAMEHEADER_H_ */
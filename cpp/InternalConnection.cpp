@@ -18,6 +18,10 @@
 
 #include "InternalConnection.h"
 
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+
 PREPARE_LOGGING(InternalConnection)
 
 /*
@@ -26,9 +30,15 @@ PREPARE_LOGGING(InternalConnection)
  * connection will properly initialize the list
  * of servers or clients
  */
-InternalConnection::InternalConnection() :
+InternalConnection::InternalConnection(IoServicePool &ioPool, IoUringSender *sendEngine) :
 	clients(NULL),
-	servers(NULL)
+	ioPool(&ioPool),
+	sendEngine(sendEngine),
+	servers(NULL),
+	shmRings(NULL),
+	udpClients(NULL),
+	unixClients(NULL),
+	unixServers(NULL)
 {
 	LOG_TRACE(InternalConnection, __PRETTY_FUNCTION__);
 
@@ -39,9 +49,15 @@ InternalConnection::InternalConnection() :
  * Given a Connection_struct, initialize the
  * list of servers or clients
  */
-InternalConnection::InternalConnection(const Connection_struct &connection) :
+InternalConnection::InternalConnection(IoServicePool &ioPool, const Connection_struct &connection, IoUringSender *sendEngine) :
 	clients(NULL),
-	servers(NULL)
+	ioPool(&ioPool),
+	sendEngine(sendEngine),
+	servers(NULL),
+	shmRings(NULL),
+	udpClients(NULL),
+	unixClients(NULL),
+	unixServers(NULL)
 {
 	LOG_TRACE(InternalConnection, __PRETTY_FUNCTION__);
 
@@ -51,23 +67,19 @@ InternalConnection::InternalConnection(const Connection_struct &connection) :
 }
 
 /*
- * Erase the byteSent counters and delete and
- * erase the bytesPerSec objects, client objects,
- * and/or server objects
+ * Delete and erase the port counters, client
+ * objects, and/or server objects
  */
 void InternalConnection::cleanUp()
 {
 	LOG_TRACE(InternalConnection, __PRETTY_FUNCTION__);
 
-	// Erase all byte total mappings
-	bytesSent.clear();
-
 	// Delete and erase all statistics mappings
-	for (portStatsMap::iterator i = bytesPerSec.begin(); i != bytesPerSec.end(); ++i) {
+	for (portCountersMap::iterator i = counters.begin(); i != counters.end(); ++i) {
 		delete i->second;
 	}
 
-	bytesPerSec.clear();
+	counters.clear();
 
 	byteSwaps.clear();
 
@@ -82,6 +94,7 @@ void InternalConnection::cleanUp()
 
 		delete clients;
 		clients = NULL;
+		resolver.reset();
 	}
 
 	// If the servers exist, delete and erase all server mappings,
@@ -96,6 +109,59 @@ void InternalConnection::cleanUp()
 		delete servers;
 		servers = NULL;
 	}
+
+	// If the shared memory rings exist, delete and erase all ring
+	// mappings, and the map itself
+	if (shmRings) {
+		LOG_DEBUG(InternalConnection, "Deleting shm ring map");
+
+		for (portShmRingMap::iterator i = shmRings->begin(); i != shmRings->end(); ++i) {
+			delete i->second;
+		}
+
+		delete shmRings;
+		shmRings = NULL;
+	}
+
+	// If the udp clients exist, delete and erase all udp client
+	// mappings, and the map itself
+	if (udpClients) {
+		LOG_DEBUG(InternalConnection, "Deleting udp client map");
+
+		for (portUdpClientMap::iterator i = udpClients->begin(); i != udpClients->end(); ++i) {
+			delete i->second;
+		}
+
+		delete udpClients;
+		udpClients = NULL;
+		resolver.reset();
+	}
+
+	// If the unix clients exist, delete and erase all unix client
+	// mappings, and the map itself
+	if (unixClients) {
+		LOG_DEBUG(InternalConnection, "Deleting unix client map");
+
+		for (portUnixClientMap::iterator i = unixClients->begin(); i != unixClients->end(); ++i) {
+			delete i->second;
+		}
+
+		delete unixClients;
+		unixClients = NULL;
+	}
+
+	// If the unix servers exist, delete and erase all unix server
+	// mappings, and the map itself
+	if (unixServers) {
+		LOG_DEBUG(InternalConnection, "Deleting unix server map");
+
+		for (portUnixServerMap::iterator i = unixServers->begin(); i != unixServers->end(); ++i) {
+			delete i->second;
+		}
+
+		delete unixServers;
+		unixServers = NULL;
+	}
 }
 
 /*
@@ -104,7 +170,7 @@ void InternalConnection::cleanUp()
  * for that object, while returning the statistic
  * information
  */
-ConnectionStat_struct InternalConnection::createClientConnection(const unsigned short &port, const std::string &ip)
+ConnectionStat_struct InternalConnection::createClientConnection(const unsigned short &port, const std::string &ip, const QueueLimits &limits, const ReconnectPolicy &policy, const SocketOptions &options)
 {
 	LOG_TRACE(InternalConnection, __PRETTY_FUNCTION__);
 	LOG_INFO(InternalConnection, "Creating client connection to " << ip << ":" << port);
@@ -116,24 +182,28 @@ ConnectionStat_struct InternalConnection::createClientConnection(const unsigned
 	ConnectionStat_struct statistic;
 	statistic.bytes_per_second = 0;
 	statistic.bytes_sent = 0;
+	statistic.packets_dropped = 0;
+	statistic.bytes_dropped = 0;
+	statistic.datagrams_sent = 0;
+	statistic.zerocopy_sends = 0;
+	statistic.zerocopy_copied = 0;
 	statistic.ip_address = ip;
 	statistic.port = port;
 	statistic.status = "startup";
 
 	try {
 		// Instantiate a client
-		newClient = new client(port, ip);
+		newClient = new client(ioPool->get(), port, resolver, limits, policy, options, sendEngine);
 
-		// Try to connect the client and save the status
+		// Start connecting the client in the background
 		if (newClient->connect()) {
 			statistic.status = "connected";
 		} else {
 			statistic.status = "not_connected";
 		}
 
-		// Make a new QuickStats pair, bytesSent pair, and clients pair
-		bytesPerSec.insert(std::make_pair(port, new QuickStats));
-		bytesSent.insert(std::make_pair(port, 0));
+		// Make a new counters pair and clients pair
+		counters.insert(std::make_pair(port, new PortCounters));
 		clients->insert(std::make_pair(port, newClient));
 	} catch(std::exception &e) {
 		LOG_ERROR(InternalConnection, "Unable to create client connection to " << ip << ":" << port);
@@ -153,7 +223,7 @@ ConnectionStat_struct InternalConnection::createClientConnection(const unsigned
  * the relevant information for that object, while
  * returning the statistic information
  */
-ConnectionStat_struct InternalConnection::createServerConnection(const unsigned short &port)
+ConnectionStat_struct InternalConnection::createServerConnection(const unsigned short &port, const QueueLimits &limits, const SocketOptions &options)
 {
 	LOG_TRACE(InternalConnection, __PRETTY_FUNCTION__);
 	LOG_INFO(InternalConnection, "Creating server listening on port " << port);
@@ -165,13 +235,18 @@ ConnectionStat_struct InternalConnection::createServerConnection(const unsigned
 	ConnectionStat_struct statistic;
 	statistic.bytes_per_second = 0;
 	statistic.bytes_sent = 0;
+	statistic.packets_dropped = 0;
+	statistic.bytes_dropped = 0;
+	statistic.datagrams_sent = 0;
+	statistic.zerocopy_sends = 0;
+	statistic.zerocopy_copied = 0;
 	statistic.ip_address = "";
 	statistic.port = port;
 	statistic.status = "startup";
 
 	try {
 		// Instantiate a server
-		newServer = new server(port);
+		newServer = new server(ioPool->get(), tcp::v4(), tcp::endpoint(tcp::v4(), port), limits, options, sendEngine);
 
 		// Check if the server has a connection and save the status
 		if (newServer->is_connected()) {
@@ -180,9 +255,8 @@ ConnectionStat_struct InternalConnection::createServerConnection(const unsigned
 			statistic.status = "not_connected";
 		}
 
-		// Make a new QuickStats pair, bytesSent pair, and servers pair
-		bytesPerSec.insert(std::make_pair(port, new QuickStats));
-		bytesSent.insert(std::make_pair(port, 0));
+		// Make a new counters pair and servers pair
+		counters.insert(std::make_pair(port, new PortCounters));
 		servers->insert(std::make_pair(port, newServer));
 	} catch(std::exception &e) {
 		LOG_ERROR(InternalConnection, "Unable to create server listening on port " << port);
@@ -197,11 +271,413 @@ ConnectionStat_struct InternalConnection::createServerConnection(const unsigned
 	return statistic;
 }
 
+/*
+ * Given a port and socket path, create a unix client
+ * object and initialize the relevant information
+ * for that object, while returning the statistic
+ * information
+ */
+ConnectionStat_struct InternalConnection::createUnixClientConnection(const unsigned short &port, const std::string &path, const QueueLimits &limits, const ReconnectPolicy &policy, const SocketOptions &options, const unix_protocol &protocol)
+{
+	LOG_TRACE(InternalConnection, __PRETTY_FUNCTION__);
+
+	std::string socketPath = getUnixPath(path, port);
+
+	LOG_INFO(InternalConnection, "Creating unix client connection to " << socketPath);
+
+	unix_client *newClient = NULL;
+
+	// Populate the statistic struct with initial values appropriate
+	// for a unix client
+	ConnectionStat_struct statistic;
+	statistic.bytes_per_second = 0;
+	statistic.bytes_sent = 0;
+	statistic.packets_dropped = 0;
+	statistic.bytes_dropped = 0;
+	statistic.datagrams_sent = 0;
+	statistic.zerocopy_sends = 0;
+	statistic.zerocopy_copied = 0;
+	statistic.ip_address = socketPath;
+	statistic.port = port;
+	statistic.status = "startup";
+
+	try {
+		// Instantiate a unix client
+		newClient = new unix_client(ioPool->get(), protocol, unix_protocol::make_endpoint(socketPath), socketPath, limits, policy, options, sendEngine);
+
+		// Start connecting the client in the background
+		if (newClient->connect()) {
+			statistic.status = "connected";
+		} else {
+			statistic.status = "not_connected";
+		}
+
+		// Make a new counters pair and unix clients pair
+		counters.insert(std::make_pair(port, new PortCounters));
+		unixClients->insert(std::make_pair(port, newClient));
+	} catch(std::exception &e) {
+		LOG_ERROR(InternalConnection, "Unable to create unix client connection to " << socketPath);
+
+		if (newClient) {
+			delete newClient;
+		}
+
+		statistic.status = "error";
+	}
+
+	return statistic;
+}
+
+/*
+ * Given a port and segment name, create a shared
+ * memory ring and initialize the relevant information
+ * for that ring, while returning the statistic
+ * information
+ */
+ConnectionStat_struct InternalConnection::createShmConnection(const unsigned short &port, const std::string &name, size_t size)
+{
+	LOG_TRACE(InternalConnection, __PRETTY_FUNCTION__);
+
+	std::string segmentName = getUnixPath(name, port);
+
+	LOG_INFO(InternalConnection, "Creating shm ring " << segmentName << " of " << size << " bytes");
+
+	// Populate the statistic struct with initial values appropriate
+	// for a ring
+	ConnectionStat_struct statistic;
+	statistic.bytes_per_second = 0;
+	statistic.bytes_sent = 0;
+	statistic.packets_dropped = 0;
+	statistic.bytes_dropped = 0;
+	statistic.datagrams_sent = 0;
+	statistic.zerocopy_sends = 0;
+	statistic.zerocopy_copied = 0;
+	statistic.ip_address = segmentName;
+	statistic.port = port;
+	statistic.status = "startup";
+
+	ShmRingWriter *newRing = new ShmRingWriter;
+
+	if (newRing->create(segmentName, size)) {
+		// Readers attach whenever they like, so a ring is as
+		// connected as it gets as soon as it exists
+		statistic.status = "connected";
+
+		// Make a new counters pair and rings pair
+		counters.insert(std::make_pair(port, new PortCounters));
+		shmRings->insert(std::make_pair(port, newRing));
+	} else {
+		LOG_ERROR(InternalConnection, "Unable to create shm ring " << segmentName << ": " << strerror(errno));
+
+		delete newRing;
+
+		statistic.status = "error";
+	}
+
+	return statistic;
+}
+
+/*
+ * Given a port and socket path, create a unix server
+ * object and initialize the relevant information for
+ * that object, while returning the statistic
+ * information
+ */
+ConnectionStat_struct InternalConnection::createUnixServerConnection(const unsigned short &port, const std::string &path, const QueueLimits &limits, const SocketOptions &options, const unix_protocol &protocol)
+{
+	LOG_TRACE(InternalConnection, __PRETTY_FUNCTION__);
+
+	std::string socketPath = getUnixPath(path, port);
+
+	LOG_INFO(InternalConnection, "Creating unix server listening on " << socketPath);
+
+	unix_server *newServer = NULL;
+
+	// Populate the statistic struct with initial values appropriate
+	// for a unix server
+	ConnectionStat_struct statistic;
+	statistic.bytes_per_second = 0;
+	statistic.bytes_sent = 0;
+	statistic.packets_dropped = 0;
+	statistic.bytes_dropped = 0;
+	statistic.datagrams_sent = 0;
+	statistic.zerocopy_sends = 0;
+	statistic.zerocopy_copied = 0;
+	statistic.ip_address = socketPath;
+	statistic.port = port;
+	statistic.status = "startup";
+
+	try {
+		// Instantiate a unix server
+		newServer = new unix_server(ioPool->get(), protocol, unix_protocol::make_endpoint(socketPath), limits, options, sendEngine);
+
+		statistic.status = "not_connected";
+
+		// Make a new counters pair and unix servers pair
+		counters.insert(std::make_pair(port, new PortCounters));
+		unixServers->insert(std::make_pair(port, newServer));
+	} catch(std::exception &e) {
+		LOG_ERROR(InternalConnection, "Unable to create unix server listening on " << socketPath << ": " << e.what());
+
+		if (newServer) {
+			delete newServer;
+		}
+
+		statistic.status = "error";
+	}
+
+	return statistic;
+}
+
+/*
+ * Given a port and IP address, create a udp client
+ * object and initialize the relevant information
+ * for that object, while returning the statistic
+ * information
+ */
+ConnectionStat_struct InternalConnection::createUdpConnection(const unsigned short &port, const std::string &ip, const QueueLimits &limits, const SocketOptions &options, size_t mtu, const MulticastOptions &multicast)
+{
+	LOG_TRACE(InternalConnection, __PRETTY_FUNCTION__);
+	LOG_INFO(InternalConnection, "Creating udp connection to " << ip << ":" << port);
+
+	udp_client *newClient = NULL;
+
+	// Populate the statistic struct with initial values appropriate
+	// for a udp client
+	ConnectionStat_struct statistic;
+	statistic.bytes_per_second = 0;
+	statistic.bytes_sent = 0;
+	statistic.packets_dropped = 0;
+	statistic.bytes_dropped = 0;
+	statistic.datagrams_sent = 0;
+	statistic.zerocopy_sends = 0;
+	statistic.zerocopy_copied = 0;
+	statistic.ip_address = ip;
+	statistic.port = port;
+	statistic.status = "startup";
+
+	try {
+		// Instantiate a udp client
+		newClient = new udp_client(ioPool->get(), port, resolver, limits, options, mtu, multicast);
+
+		// Start looking up the destination in the background
+		if (newClient->connect()) {
+			statistic.status = "connected";
+		} else {
+			statistic.status = "not_connected";
+		}
+
+		// Make a new counters pair and udp clients pair
+		counters.insert(std::make_pair(port, new PortCounters));
+		udpClients->insert(std::make_pair(port, newClient));
+	} catch(std::exception &e) {
+		LOG_ERROR(InternalConnection, "Unable to create udp connection to " << ip << ":" << port);
+
+		if (newClient) {
+			delete newClient;
+		}
+
+		statistic.status = "error";
+	}
+
+	return statistic;
+}
+
+/*
+ * Translate the send queue settings of a Connection into
+ * QueueLimits, defaulting to dropping new data for an
+ * unrecognized overflow policy
+ */
+QueueLimits InternalConnection::getQueueLimits(const Connection_struct &connection)
+{
+	QueueLimits limits(connection.max_queue_bytes, connection.max_queue_packets, DROP_NEWEST);
+
+	if (connection.overflow_policy == "drop_oldest") {
+		limits.policy = DROP_OLDEST;
+	} else if (connection.overflow_policy == "conflate") {
+		limits.policy = CONFLATE;
+	} else if (connection.overflow_policy == "disconnect") {
+		limits.policy = DISCONNECT;
+	} else if (connection.overflow_policy != "drop_newest") {
+		LOG_WARN(InternalConnection, "Unknown overflow policy \"" << connection.overflow_policy << "\", using drop_newest");
+	}
+
+	return limits;
+}
+
+/*
+ * Translate the reconnect settings of a Connection into a
+ * ReconnectPolicy
+ */
+ReconnectPolicy InternalConnection::getReconnectPolicy(const Connection_struct &connection)
+{
+	unsigned long maxDelay = std::max(connection.reconnect_min_delay, connection.reconnect_max_delay);
+
+	return ReconnectPolicy(connection.reconnect_min_delay, maxDelay, connection.reconnect_max_attempts);
+}
+
+/*
+ * Translate the socket tuning settings of a Connection into
+ * SocketOptions
+ */
+SocketOptions InternalConnection::getSocketOptions(const Connection_struct &connection)
+{
+	SocketOptions options;
+
+	options.sendBufferSize = connection.send_buffer_size;
+	options.noDelay = connection.tcp_nodelay;
+	options.cork = connection.tcp_cork;
+	options.notSentLowat = connection.tcp_notsent_lowat;
+	options.priority = connection.so_priority;
+	options.dscp = connection.dscp;
+	options.congestion = connection.tcp_congestion;
+	options.zeroCopyThreshold = connection.zerocopy_threshold;
+	options.udpGso = connection.udp_gso;
+
+	if (options.dscp > 63) {
+		LOG_WARN(InternalConnection, "DSCP " << options.dscp << " is out of range, ignoring it");
+		options.dscp = 0;
+	}
+
+	return options;
+}
+
+/*
+ * The MTU of a udp Connection, kept within what a datagram
+ * can hold
+ */
+size_t InternalConnection::getMtu(const Connection_struct &connection)
+{
+	if (connection.mtu < 576) {
+		LOG_WARN(InternalConnection, "MTU " << connection.mtu << " is too small, using 576");
+		return 576;
+	} else if (connection.mtu > 65535) {
+		LOG_WARN(InternalConnection, "MTU " << connection.mtu << " is too large, using 65535");
+		return 65535;
+	}
+
+	return connection.mtu;
+}
+
+/*
+ * Translate the multicast settings of a Connection into
+ * MulticastOptions, which are only enabled for a multicast
+ * connection
+ */
+MulticastOptions InternalConnection::getMulticastOptions(const Connection_struct &connection)
+{
+	if (connection.multicast_ttl > 255) {
+		LOG_WARN(InternalConnection, "Multicast TTL " << connection.multicast_ttl << " is out of range, using 255");
+	}
+
+	return MulticastOptions(connection.connection_type == "multicast", std::min<unsigned short>(connection.multicast_ttl, 255), connection.multicast_interface, connection.multicast_loopback);
+}
+
+/*
+ * Both udp and multicast connections send datagrams with
+ * a udp_client
+ */
+bool InternalConnection::isDatagram(const std::string &connectionType)
+{
+	return (connectionType == "udp" || connectionType == "multicast");
+}
+
+/*
+ * The Connection this was last set to
+ */
+const Connection_struct &InternalConnection::getConnection() const
+{
+	return connectionInfo;
+}
+
+/*
+ * Whether each packet goes out behind a FrameHeader.  Only
+ * stream connections are framed, since datagrams and shm
+ * rings already keep packets apart
+ */
+bool InternalConnection::isFramed() const
+{
+	return (connectionInfo.framing == "header" && !isDatagram(connectionInfo.connection_type) && connectionInfo.connection_type != "shm");
+}
+
+/*
+ * Whether the packets go out as VITA-49 packets, written with
+ * writeVrt instead of write.  Like framing, this only applies to
+ * stream connections
+ */
+bool InternalConnection::isVrt() const
+{
+	return isVrt(connectionInfo);
+}
+
+bool InternalConnection::isVrt(const Connection_struct &connection)
+{
+	return (connection.framing == "vrt" && !isDatagram(connection.connection_type) && connection.connection_type != "shm");
+}
+
+/*
+ * Whether every packet written must reach the peer as a message
+ * of its own, which is the point of a seqpacket socket
+ */
+bool InternalConnection::keepsPacketBoundaries() const
+{
+	return (isUnix(connectionInfo.connection_type) && connectionInfo.unix_socket_type == "seqpacket");
+}
+
+/*
+ * The kind of Unix domain socket a unix Connection uses,
+ * defaulting to a stream for an unrecognized type
+ */
+unix_protocol InternalConnection::getUnixProtocol(const Connection_struct &connection)
+{
+	if (connection.unix_socket_type == "seqpacket") {
+		return unix_protocol::seqpacket();
+	} else if (connection.unix_socket_type != "stream") {
+		LOG_WARN(InternalConnection, "Unknown unix socket type \"" << connection.unix_socket_type << "\", using stream");
+	}
+
+	return unix_protocol::stream();
+}
+
+/*
+ * Every port of a unix or shm Connection has its own
+ * socket or segment, named by appending the port to
+ * the path
+ */
+std::string InternalConnection::getUnixPath(const std::string &path, unsigned short port)
+{
+	std::ostringstream socketPath;
+
+	socketPath << path << "." << port;
+
+	return socketPath.str();
+}
+
+bool InternalConnection::isUnix(const std::string &connectionType)
+{
+	return (connectionType == "unix_client" || connectionType == "unix_server");
+}
+
 std::vector<unsigned short> InternalConnection::getByteSwaps() const
 {
 	return connectionInfo.byte_swap;
 }
 
+/*
+ * The ports that were set up successfully, each of which can be
+ * written on its own
+ */
+std::vector<unsigned short> InternalConnection::getPorts() const
+{
+	std::vector<unsigned short> ports;
+
+	for (portCountersMap::const_iterator i = counters.begin(); i != counters.end(); ++i) {
+		ports.push_back(i->first);
+	}
+
+	return ports;
+}
+
 /*
  * A custom equals operator for comparing an Internal
  * Connection to a Connection_struct, which only
@@ -226,8 +702,11 @@ std::vector<ConnectionStat_struct> InternalConnection::populateClientMap(const C
 
 	std::vector<ConnectionStat_struct> statistics;
 
+	// All of the ports share the addresses looked up for the host
+	resolver.reset(new ResolverCache(ioPool->get(), connection.ip_address, connection.dns_ttl));
+
 	for (std::vector<unsigned short>::const_iterator i = connection.ports.begin(); i != connection.ports.end(); ++i) {
-		statistics.push_back(createClientConnection(*i, connection.ip_address));
+		statistics.push_back(createClientConnection(*i, connection.ip_address, getQueueLimits(connection), getReconnectPolicy(connection), getSocketOptions(connection)));
 	}
 
 	return statistics;
@@ -246,7 +725,86 @@ std::vector<ConnectionStat_struct> InternalConnection::populateServerMap(const C
 	std::vector<ConnectionStat_struct> statistics;
 
 	for (std::vector<unsigned short>::const_iterator i = connection.ports.begin(); i != connection.ports.end(); ++i) {
-		statistics.push_back(createServerConnection(*i));
+		statistics.push_back(createServerConnection(*i, getQueueLimits(connection), getSocketOptions(connection)));
+	}
+
+	return statistics;
+}
+
+/*
+ * Given a Connection, iterate over all of the ports
+ * and create a shared memory ring for each, while
+ * returning the statistic information for each
+ * created ring
+ */
+std::vector<ConnectionStat_struct> InternalConnection::populateShmRingMap(const Connection_struct &connection)
+{
+	LOG_TRACE(InternalConnection, __PRETTY_FUNCTION__);
+
+	std::vector<ConnectionStat_struct> statistics;
+
+	for (std::vector<unsigned short>::const_iterator i = connection.ports.begin(); i != connection.ports.end(); ++i) {
+		statistics.push_back(createShmConnection(*i, connection.ip_address, connection.shm_size));
+	}
+
+	return statistics;
+}
+
+/*
+ * Given a Connection, iterate over all of the ports
+ * and create udp clients sending to the specified
+ * port and IP address, while returning the statistic
+ * information for each created connection
+ */
+std::vector<ConnectionStat_struct> InternalConnection::populateUdpClientMap(const Connection_struct &connection)
+{
+	LOG_TRACE(InternalConnection, __PRETTY_FUNCTION__);
+
+	std::vector<ConnectionStat_struct> statistics;
+
+	// All of the ports share the addresses looked up for the host
+	resolver.reset(new ResolverCache(ioPool->get(), connection.ip_address, connection.dns_ttl));
+
+	for (std::vector<unsigned short>::const_iterator i = connection.ports.begin(); i != connection.ports.end(); ++i) {
+		statistics.push_back(createUdpConnection(*i, connection.ip_address, getQueueLimits(connection), getSocketOptions(connection), getMtu(connection), getMulticastOptions(connection)));
+	}
+
+	return statistics;
+}
+
+/*
+ * Given a Connection, iterate over all of the ports
+ * and create unix clients connecting to the socket
+ * for each port, while returning the statistic
+ * information for each created connection
+ */
+std::vector<ConnectionStat_struct> InternalConnection::populateUnixClientMap(const Connection_struct &connection)
+{
+	LOG_TRACE(InternalConnection, __PRETTY_FUNCTION__);
+
+	std::vector<ConnectionStat_struct> statistics;
+
+	for (std::vector<unsigned short>::const_iterator i = connection.ports.begin(); i != connection.ports.end(); ++i) {
+		statistics.push_back(createUnixClientConnection(*i, connection.ip_address, getQueueLimits(connection), getReconnectPolicy(connection), getSocketOptions(connection), getUnixProtocol(connection)));
+	}
+
+	return statistics;
+}
+
+/*
+ * Given a Connection, iterate over all of the ports
+ * and create unix servers listening on the socket
+ * for each port, while returning the statistic
+ * information for each created connection
+ */
+std::vector<ConnectionStat_struct> InternalConnection::populateUnixServerMap(const Connection_struct &connection)
+{
+	LOG_TRACE(InternalConnection, __PRETTY_FUNCTION__);
+
+	std::vector<ConnectionStat_struct> statistics;
+
+	for (std::vector<unsigned short>::const_iterator i = connection.ports.begin(); i != connection.ports.end(); ++i) {
+		statistics.push_back(createUnixServerConnection(*i, connection.ip_address, getQueueLimits(connection), getSocketOptions(connection), getUnixProtocol(connection)));
 	}
 
 	return statistics;
@@ -254,8 +812,8 @@ std::vector<ConnectionStat_struct> InternalConnection::populateServerMap(const C
 
 /*
  * Given a Connection, determine which type of
- * connection (client/server) to create or manage
- * an existing connection
+ * connection (client/server/udp/multicast/unix/shm) to
+ * create or manage an existing connection
  */
 std::vector<ConnectionStat_struct> InternalConnection::setConnection(const Connection_struct &connection)
 {
@@ -265,12 +823,17 @@ std::vector<ConnectionStat_struct> InternalConnection::setConnection(const Conne
 	std::vector<ConnectionStat_struct> statistics;
 
 	// Guard against an invalid connection type
-	if (connection.connection_type != "client" && connection.connection_type != "server") {
+	if (connection.connection_type != "client" && connection.connection_type != "server" && connection.connection_type != "shm" && !isDatagram(connection.connection_type) && !isUnix(connection.connection_type)) {
 		LOG_ERROR(InternalConnection, "Attempted to set connection type to \"" << connection.connection_type << "\"");
 
 		return statistics;
 	}
 
+	// Datagrams and shm rings already keep packets apart
+	if (connection.framing != "none" && (isDatagram(connection.connection_type) || connection.connection_type == "shm")) {
+		LOG_WARN(InternalConnection, "Framing \"" << connection.framing << "\" only applies to stream connections, ignoring it for " << connection.connection_type);
+	}
+
 	// If the connection type has changed, everything needs to be
 	// deleted and created from scratch.  Otherwise, only update
 	// the parts that have changed
@@ -286,6 +849,42 @@ std::vector<ConnectionStat_struct> InternalConnection::setConnection(const Conne
 
 			statistics = populateClientMap(connection);
 
+			// Save the connection information for later
+			connectionInfo = connection;
+		} else if (isDatagram(connection.connection_type)) {
+			LOG_DEBUG(InternalConnection, "Creating udp client map");
+
+			udpClients = new portUdpClientMap();
+
+			statistics = populateUdpClientMap(connection);
+
+			// Save the connection information for later
+			connectionInfo = connection;
+		} else if (connection.connection_type == "unix_client") {
+			LOG_DEBUG(InternalConnection, "Creating unix client map");
+
+			unixClients = new portUnixClientMap();
+
+			statistics = populateUnixClientMap(connection);
+
+			// Save the connection information for later
+			connectionInfo = connection;
+		} else if (connection.connection_type == "shm") {
+			LOG_DEBUG(InternalConnection, "Creating shm ring map");
+
+			shmRings = new portShmRingMap();
+
+			statistics = populateShmRingMap(connection);
+
+			// Save the connection information for later
+			connectionInfo = connection;
+		} else if (connection.connection_type == "unix_server") {
+			LOG_DEBUG(InternalConnection, "Creating unix server map");
+
+			unixServers = new portUnixServerMap();
+
+			statistics = populateUnixServerMap(connection);
+
 			// Save the connection information for later
 			connectionInfo = connection;
 		} else {
@@ -319,16 +918,15 @@ std::vector<ConnectionStat_struct> InternalConnection::setConnection(const Conne
 				// Check for added ports
 				for (std::vector<unsigned short>::const_iterator i = connection.ports.begin(); i != connection.ports.end(); ++i, ++counter) {
 					if (find(connectionInfo.ports.begin(), connectionInfo.ports.end(), *i) == connectionInfo.ports.end()) {
-						statistics.push_back(createClientConnection(*i, connection.ip_address));
+						statistics.push_back(createClientConnection(*i, connection.ip_address, getQueueLimits(connection), getReconnectPolicy(connection), getSocketOptions(connection)));
 					}
 				}
 
 				// Check for removed ports
 				for (std::vector<unsigned short>::const_iterator i = connectionInfo.ports.begin(); i != connectionInfo.ports.end(); ++i) {
 					if (find(connection.ports.begin(), connection.ports.end(), *i) == connection.ports.end()) {
-						delete bytesPerSec.at(*i);
-						bytesPerSec.erase(*i);
-						bytesSent.erase(*i);
+						delete counters.at(*i);
+						counters.erase(*i);
 						byteSwaps.erase(*i);
 						delete clients->at(*i);
 						clients->erase(*i);
@@ -336,6 +934,123 @@ std::vector<ConnectionStat_struct> InternalConnection::setConnection(const Conne
 				}
 			}
 
+			// Save the connection information for later
+			connectionInfo = connection;
+		} else if (isDatagram(connection.connection_type)) {
+			// If the IP address has changed, all of the connections need
+			// to be restarted
+			if (connectionInfo.ip_address != connection.ip_address) {
+				cleanUp();
+
+				udpClients = new portUdpClientMap();
+
+				statistics = populateUdpClientMap(connection);
+			}
+			// If the ports have changed, some connections may stay the
+			// same
+			else if (connectionInfo.ports != connection.ports) {
+				// Check for added ports
+				for (std::vector<unsigned short>::const_iterator i = connection.ports.begin(); i != connection.ports.end(); ++i) {
+					if (find(connectionInfo.ports.begin(), connectionInfo.ports.end(), *i) == connectionInfo.ports.end()) {
+						statistics.push_back(createUdpConnection(*i, connection.ip_address, getQueueLimits(connection), getSocketOptions(connection), getMtu(connection), getMulticastOptions(connection)));
+					}
+				}
+
+				// Check for removed ports
+				for (std::vector<unsigned short>::const_iterator i = connectionInfo.ports.begin(); i != connectionInfo.ports.end(); ++i) {
+					if (find(connection.ports.begin(), connection.ports.end(), *i) == connection.ports.end()) {
+						delete counters.at(*i);
+						counters.erase(*i);
+						byteSwaps.erase(*i);
+						delete udpClients->at(*i);
+						udpClients->erase(*i);
+					}
+				}
+			}
+
+			// Save the connection information for later
+			connectionInfo = connection;
+		} else if (connection.connection_type == "shm") {
+			// If the name or size has changed, all of the rings need to
+			// be created again
+			if (connectionInfo.ip_address != connection.ip_address || connectionInfo.shm_size != connection.shm_size) {
+				cleanUp();
+
+				shmRings = new portShmRingMap();
+
+				statistics = populateShmRingMap(connection);
+			}
+			// If the ports have changed, some rings may stay the same
+			else if (connectionInfo.ports != connection.ports) {
+				// Check for added ports
+				for (std::vector<unsigned short>::const_iterator i = connection.ports.begin(); i != connection.ports.end(); ++i) {
+					if (find(connectionInfo.ports.begin(), connectionInfo.ports.end(), *i) == connectionInfo.ports.end()) {
+						statistics.push_back(createShmConnection(*i, connection.ip_address, connection.shm_size));
+					}
+				}
+
+				// Check for removed ports
+				for (std::vector<unsigned short>::const_iterator i = connectionInfo.ports.begin(); i != connectionInfo.ports.end(); ++i) {
+					if (find(connection.ports.begin(), connection.ports.end(), *i) == connection.ports.end()) {
+						delete counters.at(*i);
+						counters.erase(*i);
+						byteSwaps.erase(*i);
+						delete shmRings->at(*i);
+						shmRings->erase(*i);
+					}
+				}
+			}
+
+			// Save the connection information for later
+			connectionInfo = connection;
+		} else if (isUnix(connection.connection_type)) {
+			// If the path or the kind of socket has changed, all of the
+			// connections need to be restarted
+			if (connectionInfo.ip_address != connection.ip_address || connectionInfo.unix_socket_type != connection.unix_socket_type) {
+				cleanUp();
+
+				if (connection.connection_type == "unix_client") {
+					unixClients = new portUnixClientMap();
+
+					statistics = populateUnixClientMap(connection);
+				} else {
+					unixServers = new portUnixServerMap();
+
+					statistics = populateUnixServerMap(connection);
+				}
+			}
+			// If the ports have changed, some connections may stay the
+			// same
+			else if (connectionInfo.ports != connection.ports) {
+				// Check for added ports
+				for (std::vector<unsigned short>::const_iterator i = connection.ports.begin(); i != connection.ports.end(); ++i) {
+					if (find(connectionInfo.ports.begin(), connectionInfo.ports.end(), *i) == connectionInfo.ports.end()) {
+						if (connection.connection_type == "unix_client") {
+							statistics.push_back(createUnixClientConnection(*i, connection.ip_address, getQueueLimits(connection), getReconnectPolicy(connection), getSocketOptions(connection), getUnixProtocol(connection)));
+						} else {
+							statistics.push_back(createUnixServerConnection(*i, connection.ip_address, getQueueLimits(connection), getSocketOptions(connection), getUnixProtocol(connection)));
+						}
+					}
+				}
+
+				// Check for removed ports
+				for (std::vector<unsigned short>::const_iterator i = connectionInfo.ports.begin(); i != connectionInfo.ports.end(); ++i) {
+					if (find(connection.ports.begin(), connection.ports.end(), *i) == connection.ports.end()) {
+						delete counters.at(*i);
+						counters.erase(*i);
+						byteSwaps.erase(*i);
+
+						if (unixClients) {
+							delete unixClients->at(*i);
+							unixClients->erase(*i);
+						} else {
+							delete unixServers->at(*i);
+							unixServers->erase(*i);
+						}
+					}
+				}
+			}
+
 			// Save the connection information for later
 			connectionInfo = connection;
 		} else {
@@ -348,16 +1063,15 @@ std::vector<ConnectionStat_struct> InternalConnection::setConnection(const Conne
 				// Check for added ports
 				for (std::vector<unsigned short>::const_iterator i = connection.ports.begin(); i != connection.ports.end(); ++i, ++counter) {
 					if (find(connectionInfo.ports.begin(), connectionInfo.ports.end(), *i) == connectionInfo.ports.end()) {
-						statistics.push_back(createServerConnection(*i));
+						statistics.push_back(createServerConnection(*i, getQueueLimits(connection), getSocketOptions(connection)));
 					}
 				}
 
 				// Check for removed ports
 				for (std::vector<unsigned short>::const_iterator i = connectionInfo.ports.begin(); i != connectionInfo.ports.end(); ++i) {
 					if (find(connection.ports.begin(), connection.ports.end(), *i) == connection.ports.end()) {
-						delete bytesPerSec.at(*i);
-						bytesPerSec.erase(*i);
-						bytesSent.erase(*i);
+						delete counters.at(*i);
+						counters.erase(*i);
 						delete servers->at(*i);
 						servers->erase(*i);
 					}
@@ -383,68 +1097,268 @@ std::vector<ConnectionStat_struct> InternalConnection::setConnection(const Conne
 	return statistics;
 }
 
-std::vector<ConnectionStat_struct> InternalConnection::writeByteSwap(std::map<unsigned short, std::vector<char> > &dataMap)
+/*
+ * The status reported for a TCP or unix client
+ */
+template<typename Client>
+static std::string clientStatus(Client *c)
+{
+	switch (c->status()) {
+	case Client::CONNECTED:
+		return "connected";
+	case Client::RECONNECTING:
+		return "reconnecting";
+	case Client::FAILED:
+		return "error";
+	default:
+		return "not_connected";
+	}
+}
+
+/*
+ * Build the statistics for every port from the counters
+ * bumped by the data path.  This is meant to be called
+ * periodically from outside of the data path
+ */
+std::vector<ConnectionStat_struct> InternalConnection::getStatistics()
 {
 	LOG_TRACE(InternalConnection, __PRETTY_FUNCTION__);
 
 	// Make a vector of Connection Statistics to return
 	std::vector<ConnectionStat_struct> statistics;
 
-	if (connectionInfo.connection_type == "client" && clients) {
-		statistics.reserve(clients->size());
+	for (portCountersMap::iterator i = counters.begin(); i != counters.end(); ++i) {
+		ConnectionStat_struct statistic;
+		DropCounts dropped;
+		ZeroCopyCounts zeroCopy;
 
-		for (portClientMap::iterator i = clients->begin(); i != clients->end(); ++i) {
-			ConnectionStat_struct statistic;
+		statistic.port = i->first;
+		statistic.datagrams_sent = 0;
 
-			statistic.ip_address = connectionInfo.ip_address;
-			statistic.port = i->first;
+		if (connectionInfo.connection_type == "client" && clients && clients->count(i->first)) {
+			client *c = clients->at(i->first);
 
-			if (i->second->connect_if_necessary()) {
-				statistic.status = "connected";
+			statistic.ip_address = connectionInfo.ip_address;
+			statistic.status = clientStatus(c);
+			dropped = c->dropped();
+			zeroCopy = c->zeroCopyCounts();
+			statistic.send_method = c->sendMethod();
+		} else if (connectionInfo.connection_type == "server" && servers && servers->count(i->first)) {
+			server *s = servers->at(i->first);
 
-				i->second->write(dataMap[byteSwaps[i->first]]);
+			statistic.ip_address = "";
+			statistic.status = s->is_connected() ? "connected" : "not_connected";
+			dropped = s->dropped();
+			zeroCopy = s->zeroCopyCounts();
+			statistic.send_method = s->sendMethod();
+		} else if (isDatagram(connectionInfo.connection_type) && udpClients && udpClients->count(i->first)) {
+			udp_client *u = udpClients->at(i->first);
 
-				size_t pktSize = dataMap[byteSwaps[i->first]].size();
+			statistic.ip_address = connectionInfo.ip_address;
+			dropped = u->dropped();
+			statistic.datagrams_sent = u->datagrams();
+			statistic.send_method = u->sendMethod();
 
-				statistic.bytes_per_second = bytesPerSec[i->first]->newPacket(pktSize);
-				statistic.bytes_sent = (bytesSent[i->first] += pktSize);
+			if (u->is_connected()) {
+				statistic.status = "connected";
+			} else if (u->failed()) {
+				statistic.status = "error";
 			} else {
 				statistic.status = "not_connected";
-				statistic.bytes_per_second = bytesPerSec[i->first]->newPacket(0);
 			}
+		} else if (connectionInfo.connection_type == "shm" && shmRings && shmRings->count(i->first)) {
+			ShmRingWriter *ring = shmRings->at(i->first);
 
-			statistics.push_back(statistic);
+			statistic.ip_address = ring->name();
+			statistic.status = "connected";
+			dropped.packets = ring->dropped_packets();
+			dropped.bytes = ring->dropped_bytes();
+			statistic.send_method = "shm";
+		} else if (connectionInfo.connection_type == "unix_client" && unixClients && unixClients->count(i->first)) {
+			unix_client *c = unixClients->at(i->first);
+
+			statistic.ip_address = getUnixPath(connectionInfo.ip_address, i->first);
+			statistic.status = clientStatus(c);
+			dropped = c->dropped();
+			zeroCopy = c->zeroCopyCounts();
+			statistic.send_method = c->sendMethod();
+		} else if (connectionInfo.connection_type == "unix_server" && unixServers && unixServers->count(i->first)) {
+			unix_server *s = unixServers->at(i->first);
+
+			statistic.ip_address = getUnixPath(connectionInfo.ip_address, i->first);
+			statistic.status = s->is_connected() ? "connected" : "not_connected";
+			dropped = s->dropped();
+			zeroCopy = s->zeroCopyCounts();
+			statistic.send_method = s->sendMethod();
+		} else {
+			continue;
 		}
-	} else if (connectionInfo.connection_type == "server" && servers) {
-		statistics.reserve(servers->size());
 
-		for (portServerMap::iterator i = servers->begin(); i != servers->end(); ++i) {
-			ConnectionStat_struct statistic;
+		// Feed the bytes sent since the last call to the estimator
+		boost::uint64_t bytesSent = i->second->bytesSent.load(boost::memory_order_relaxed);
 
-			statistic.ip_address = "";
-			statistic.port = i->first;
+		statistic.bytes_per_second = i->second->bytesPerSec.newPacket(bytesSent - i->second->publishedBytes);
+		statistic.bytes_sent = bytesSent;
+		statistic.packets_dropped = dropped.packets;
+		statistic.bytes_dropped = dropped.bytes;
+		statistic.zerocopy_sends = zeroCopy.sends;
+		statistic.zerocopy_copied = zeroCopy.copied;
 
-			if (i->second->is_connected()) {
-				statistic.status = "connected";
+		i->second->publishedBytes = bytesSent;
 
-				i->second->write(dataMap[byteSwaps[i->first]]);
+		statistics.push_back(statistic);
+	}
 
-				size_t pktSize = dataMap[byteSwaps[i->first]].size();
+	return statistics;
+}
 
-				statistic.bytes_per_second = bytesPerSec[i->first]->newPacket(pktSize);
-				statistic.bytes_sent = (bytesSent[i->first] += pktSize);
-			} else {
-				statistic.status = "not_connected";
-				statistic.bytes_per_second = bytesPerSec[i->first]->newPacket(0);
-			}
+/*
+ * Queue a packet and its frame header on a stream client.
+ * Datagrams are never framed, so the UDP client only takes
+ * the data
+ */
+template<typename Client>
+static bool queuePacket(Client *c, const SharedBuffer &data, const SharedBuffer &header)
+{
+	return c->write(data, header);
+}
+
+static bool queuePacket(udp_client *c, const SharedBuffer &data, const SharedBuffer &)
+{
+	return c->write(data);
+}
 
-			statistics.push_back(statistic);
+/*
+ * Queue data on a client of any kind, starting it connecting
+ * if it isn't already.  The client only queues the data, so
+ * this won't block on a slow peer
+ */
+template<typename Client>
+void InternalConnection::writeClient(unsigned short port, Client *c, const SharedBuffer &data, const SharedBuffer &header)
+{
+	if (c->connect_if_necessary()) {
+		if (queuePacket(c, data, header)) {
+			counters[port]->bytesSent.fetch_add(header.size() + data.size(), boost::memory_order_relaxed);
+		} else {
+			LOG_DEBUG(InternalConnection, "Send queue full for " << connectionInfo.ip_address << ":" << port << ", dropping packet");
+		}
+	}
+}
+
+/*
+ * Queue data on every session of a server of any kind
+ */
+template<typename Server>
+void InternalConnection::writeServer(unsigned short port, Server *s, const SharedBuffer &data, const SharedBuffer &header)
+{
+	if (s->is_connected()) {
+		s->write(data, header);
+
+		counters[port]->bytesSent.fetch_add(header.size() + data.size(), boost::memory_order_relaxed);
+	}
+}
+
+/*
+ * Copy data into a shared memory ring.  The ring never waits
+ * for its readers, so this only fails if the packet is larger
+ * than the ring
+ */
+void InternalConnection::writeShmRing(unsigned short port, ShmRingWriter *ring, const SharedBuffer &data)
+{
+	if (ring->write(data.data(), data.size())) {
+		counters[port]->bytesSent.fetch_add(data.size(), boost::memory_order_relaxed);
+	} else {
+		LOG_DEBUG(InternalConnection, "Packet of " << data.size() << " bytes is larger than shm ring " << ring->name() << ", dropping packet");
+	}
+}
+
+/*
+ * Write data, with its header if the connection is framed, to
+ * one port
+ */
+void InternalConnection::write(unsigned short port, const SharedBuffer &data, const SharedBuffer &header)
+{
+	LOG_TRACE(InternalConnection, __PRETTY_FUNCTION__);
+
+	const SharedBuffer none;
+	const SharedBuffer &frame = isFramed() ? header : none;
+
+	if (connectionInfo.connection_type == "client" && clients) {
+		if (clients->count(port)) {
+			writeClient(port, clients->at(port), data, frame);
+		}
+	} else if (connectionInfo.connection_type == "server" && servers) {
+		if (servers->count(port)) {
+			writeServer(port, servers->at(port), data, frame);
+		}
+	} else if (isDatagram(connectionInfo.connection_type) && udpClients) {
+		if (udpClients->count(port)) {
+			writeClient(port, udpClients->at(port), data, frame);
+		}
+	} else if (connectionInfo.connection_type == "shm" && shmRings) {
+		if (shmRings->count(port)) {
+			writeShmRing(port, shmRings->at(port), data);
+		}
+	} else if (connectionInfo.connection_type == "unix_client" && unixClients) {
+		if (unixClients->count(port)) {
+			writeClient(port, unixClients->at(port), data, frame);
+		}
+	} else if (connectionInfo.connection_type == "unix_server" && unixServers) {
+		if (unixServers->count(port)) {
+			writeServer(port, unixServers->at(port), data, frame);
 		}
 	} else {
 		LOG_ERROR(InternalConnection, "Invalid conditions for writing data");
 	}
+}
 
-	return statistics;
+/*
+ * Write the variant of the data with the port's byte swap to
+ * one port
+ */
+void InternalConnection::writeByteSwap(unsigned short port, const std::vector<SharedBuffer> &variants, const std::vector<SharedBuffer> &headers)
+{
+	LOG_TRACE(InternalConnection, __PRETTY_FUNCTION__);
+
+	portByteSwapMap::const_iterator numSwap = byteSwaps.find(port);
+
+	if (numSwap == byteSwaps.end()) {
+		return;
+	}
+
+	write(port, variants[numSwap->second], headers[numSwap->second]);
+}
+
+/*
+ * Queue each VITA-49 packet, its header and payload together, so
+ * that a full queue drops whole packets
+ */
+void InternalConnection::writeVrt(unsigned short port, const std::vector<SharedBuffer> &headers, const std::vector<SharedBuffer> &payloads)
+{
+	LOG_TRACE(InternalConnection, __PRETTY_FUNCTION__);
+
+	for (size_t packet = 0; packet < headers.size(); ++packet) {
+		if (connectionInfo.connection_type == "client" && clients) {
+			if (clients->count(port)) {
+				writeClient(port, clients->at(port), payloads[packet], headers[packet]);
+			}
+		} else if (connectionInfo.connection_type == "server" && servers) {
+			if (servers->count(port)) {
+				writeServer(port, servers->at(port), payloads[packet], headers[packet]);
+			}
+		} else if (connectionInfo.connection_type == "unix_client" && unixClients) {
+			if (unixClients->count(port)) {
+				writeClient(port, unixClients->at(port), payloads[packet], headers[packet]);
+			}
+		} else if (connectionInfo.connection_type == "unix_server" && unixServers) {
+			if (unixServers->count(port)) {
+				writeServer(port, unixServers->at(port), payloads[packet], headers[packet]);
+			}
+		} else {
+			LOG_ERROR(InternalConnection, "Invalid conditions for writing VITA-49 packets");
+			return;
+		}
+	}
 }
 
 InternalConnection::~InternalConnection()
@@ -453,4 +1367,3 @@ InternalConnection::~InternalConnection()
 
 	cleanUp();
 }
-
@@ -21,27 +21,51 @@
 
 #include "BoostClient.h"
 #include "BoostServer.h"
+#include "BoostUdpClient.h"
+#include "IoServicePool.h"
+#include "IoUringSender.h"
+#include "SharedBuffer.h"
+#include "ShmRing.h"
 #include "quickstats.h"
 #include "struct_props.h"
 
+#include <boost/atomic.hpp>
+#include <boost/cstdint.hpp>
+
+/*
+ * The statistics kept for each port.  The data path only
+ * bumps the atomic byte count; the rest belongs to whoever
+ * publishes the statistics
+ */
+struct PortCounters {
+	PortCounters() : bytesSent(0), publishedBytes(0) {}
+
+	boost::atomic<boost::uint64_t> bytesSent;
+	QuickStats bytesPerSec;
+	boost::uint64_t publishedBytes;
+};
 
-typedef std::map<unsigned short, double> portBytesMap;
 typedef std::map<unsigned short, unsigned short> portByteSwapMap;
 typedef std::map<unsigned short, client *> portClientMap;
+typedef std::map<unsigned short, PortCounters *> portCountersMap;
 typedef std::map<unsigned short, server *> portServerMap;
-typedef std::map<unsigned short, QuickStats *> portStatsMap;
+typedef std::map<unsigned short, ShmRingWriter *> portShmRingMap;
+typedef std::map<unsigned short, udp_client *> portUdpClientMap;
+typedef std::map<unsigned short, unix_client *> portUnixClientMap;
+typedef std::map<unsigned short, unix_server *> portUnixServerMap;
 
 /*
- * This class manages server or client connections
- * based on a Connection_struct, returning
- * ConnectionStat_struct(s) to notify the owner of
- * an object of this type's current status
+ * This class manages server, client, udp, multicast,
+ * Unix domain or shared memory connections based on a
+ * Connection_struct,
+ * returning ConnectionStat_struct(s) to notify the owner
+ * of an object of this type's current status
  */
 class InternalConnection {
 	ENABLE_LOGGING
 public:
-	InternalConnection();
-	InternalConnection(const Connection_struct &connection);
+	InternalConnection(IoServicePool &ioPool, IoUringSender *sendEngine=NULL);
+	InternalConnection(IoServicePool &ioPool, const Connection_struct &connection, IoUringSender *sendEngine=NULL);
 	virtual ~InternalConnection();
 
 private:
@@ -55,30 +79,71 @@ private:
 public:
 	std::vector<unsigned short> getByteSwaps() const;
 
+	std::vector<unsigned short> getPorts() const;
+
 	bool operator==(const Connection_struct &connection) const;
 	std::vector<ConnectionStat_struct> setConnection(const Connection_struct &connection);
 
-	template <typename T, typename U>
-	std::vector<ConnectionStat_struct> write(std::vector<T, U> &data);
+	std::vector<ConnectionStat_struct> getStatistics();
+
+	const Connection_struct &getConnection() const;
 
-	std::vector<ConnectionStat_struct> writeByteSwap(std::map<unsigned short, std::vector<char> > &dataMap);
+	bool isFramed() const;
+
+	bool isVrt() const;
+
+	static bool isVrt(const Connection_struct &connection);
+
+	bool keepsPacketBoundaries() const;
+
+	void write(unsigned short port, const SharedBuffer &data, const SharedBuffer &header);
+
+	void writeByteSwap(unsigned short port, const std::vector<SharedBuffer> &variants, const std::vector<SharedBuffer> &headers);
+
+	void writeVrt(unsigned short port, const std::vector<SharedBuffer> &headers, const std::vector<SharedBuffer> &payloads);
 
 private:
 	void cleanUp();
-	ConnectionStat_struct createClientConnection(const unsigned short &port, const std::string &ip);
-	ConnectionStat_struct createServerConnection(const unsigned short &port);
+	ConnectionStat_struct createClientConnection(const unsigned short &port, const std::string &ip, const QueueLimits &limits, const ReconnectPolicy &policy, const SocketOptions &options);
+	ConnectionStat_struct createServerConnection(const unsigned short &port, const QueueLimits &limits, const SocketOptions &options);
+	ConnectionStat_struct createShmConnection(const unsigned short &port, const std::string &name, size_t size);
+	ConnectionStat_struct createUnixClientConnection(const unsigned short &port, const std::string &path, const QueueLimits &limits, const ReconnectPolicy &policy, const SocketOptions &options, const unix_protocol &protocol);
+	ConnectionStat_struct createUnixServerConnection(const unsigned short &port, const std::string &path, const QueueLimits &limits, const SocketOptions &options, const unix_protocol &protocol);
+	ConnectionStat_struct createUdpConnection(const unsigned short &port, const std::string &ip, const QueueLimits &limits, const SocketOptions &options, size_t mtu, const MulticastOptions &multicast);
+	QueueLimits getQueueLimits(const Connection_struct &connection);
+	ReconnectPolicy getReconnectPolicy(const Connection_struct &connection);
+	SocketOptions getSocketOptions(const Connection_struct &connection);
+	size_t getMtu(const Connection_struct &connection);
+	MulticastOptions getMulticastOptions(const Connection_struct &connection);
+	static bool isDatagram(const std::string &connectionType);
+	unix_protocol getUnixProtocol(const Connection_struct &connection);
+	static std::string getUnixPath(const std::string &path, unsigned short port);
+	static bool isUnix(const std::string &connectionType);
 	std::vector<ConnectionStat_struct> populateClientMap(const Connection_struct &connection);
 	std::vector<ConnectionStat_struct> populateServerMap(const Connection_struct &connection);
+	std::vector<ConnectionStat_struct> populateShmRingMap(const Connection_struct &connection);
+	std::vector<ConnectionStat_struct> populateUdpClientMap(const Connection_struct &connection);
+	std::vector<ConnectionStat_struct> populateUnixClientMap(const Connection_struct &connection);
+	std::vector<ConnectionStat_struct> populateUnixServerMap(const Connection_struct &connection);
+	template<typename Client>
+	void writeClient(unsigned short port, Client *c, const SharedBuffer &data, const SharedBuffer &header);
+	template<typename Server>
+	void writeServer(unsigned short port, Server *s, const SharedBuffer &data, const SharedBuffer &header);
+	void writeShmRing(unsigned short port, ShmRingWriter *ring, const SharedBuffer &data);
 
 private:
-	portStatsMap bytesPerSec;
 	portByteSwapMap byteSwaps;
-	portBytesMap bytesSent;
 	portClientMap *clients;
 	Connection_struct connectionInfo;
+	portCountersMap counters;
+	IoServicePool *ioPool;
+	boost::shared_ptr<ResolverCache> resolver;
+	IoUringSender *sendEngine;
 	portServerMap *servers;
+	portShmRingMap *shmRings;
+	portUdpClientMap *udpClients;
+	portUnixClientMap *unixClients;
+	portUnixServerMap *unixServers;
 };
 
-#include "InternalConnectionTemplate.h"
-
 #endif /* INTERNALCONNECTION_H_ */
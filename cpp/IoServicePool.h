@@ -0,0 +1,139 @@
+/*
+ * This file is protected by Copyright. Please refer to the COPYRIGHT file distributed with this 
+ * source distribution.
+ * 
+ * This file is part of REDHAWK Basic Components sinksocket.
+ * 
+ * REDHAWK Basic Components sinksocket is free software: you can redistribute it and/or modify it under the terms of 
+ * the GNU Lesser General Public License as published by the Free Software Foundation, either 
+ * version 3 of the License, or (at your option) any later version.
+ * 
+ * REDHAWK Basic Components sinksocket is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; 
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR 
+ * PURPOSE.  See the GNU Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public License along with this 
+ * program.  If not, see http://www.gnu.org/licenses/.
+ */
+
+#ifndef IOSERVICEPOOL_H_
+#define IOSERVICEPOOL_H_
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <boost/asio.hpp>
+#include <boost/bind.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+#include <pthread.h>
+#include <vector>
+
+/*
+ * The I/O contexts shared by every server and client in the
+ * component.  Either a single io_service is run by all of the
+ * threads, or each thread runs its own io_service pinned to a
+ * core, with new connections handed out round robin.
+ */
+class IoServicePool
+{
+public:
+	IoServicePool() :
+		next_(0)
+	{}
+
+	~IoServicePool()
+	{
+		stop();
+	}
+
+	/*
+	 * Start the given number of threads, or one per core if 0.
+	 * Must not be called while any connection is using the pool
+	 */
+	void start(size_t threads, bool perCore)
+	{
+		stop();
+
+		if (threads == 0)
+			threads = std::max(boost::thread::hardware_concurrency(), 1u);
+
+		size_t contexts = perCore ? threads : 1;
+
+		for (size_t i=0; i!=contexts; i++)
+		{
+			services_.push_back(boost::shared_ptr<boost::asio::io_service>(new boost::asio::io_service()));
+			work_.push_back(boost::shared_ptr<boost::asio::io_service::work>(new boost::asio::io_service::work(*services_.back())));
+		}
+
+		for (size_t i=0; i!=threads; i++)
+		{
+			boost::asio::io_service& service = *services_[i % contexts];
+			threads_.push_back(new boost::thread(boost::bind(&IoServicePool::run, boost::ref(service))));
+
+			if (perCore)
+				pin(*threads_.back(), i);
+		}
+	}
+
+	void stop()
+	{
+		work_.clear();
+
+		for (size_t i=0; i!=services_.size(); i++)
+			services_[i]->stop();
+
+		for (size_t i=0; i!=threads_.size(); i++)
+		{
+			threads_[i]->join();
+			delete threads_[i];
+		}
+
+		threads_.clear();
+		services_.clear();
+		next_ = 0;
+	}
+
+	/*
+	 * The context for a new connection.  The pool must have
+	 * been started
+	 */
+	boost::asio::io_service& get()
+	{
+		boost::mutex::scoped_lock lock(lock_);
+		boost::asio::io_service& service = *services_[next_];
+		next_ = (next_ + 1) % services_.size();
+		return service;
+	}
+
+private:
+	static void run(boost::asio::io_service& service)
+	{
+		try
+		{
+			service.run();
+		}
+		catch (std::exception& e)
+		{
+			std::cerr << "Exception in thread: " << e.what() << "\n";
+			std::exit(1);
+		}
+	}
+
+	static void pin(boost::thread& thread, size_t index)
+	{
+		size_t cores = std::max(boost::thread::hardware_concurrency(), 1u);
+		cpu_set_t cpus;
+		CPU_ZERO(&cpus);
+		CPU_SET(index % cores, &cpus);
+		pthread_setaffinity_np(thread.native_handle(), sizeof(cpus), &cpus);
+	}
+
+	std::vector<boost::shared_ptr<boost::asio::io_service> > services_;
+	std::vector<boost::shared_ptr<boost::asio::io_service::work> > work_;
+	std::vector<boost::thread*> threads_;
+	size_t next_;
+	boost::mutex lock_;
+};
+
+#endif /* IOSERVICEPOOL_H_ */
@@ -0,0 +1,596 @@
+/*
+ * This file is protected by Copyright. Please refer to the COPYRIGHT file distributed with this 
+ * source distribution.
+ * 
+ * This file is part of REDHAWK Basic Components sinksocket.
+ * 
+ * REDHAWK Basic Components sinksocket is free software: you can redistribute it and/or modify it under the terms of 
+ * the GNU Lesser General Public License as published by the Free Software Foundation, either 
+ * version 3 of the License, or (at your option) any later version.
+ * 
+ * REDHAWK Basic Components sinksocket is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; 
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR 
+ * PURPOSE.  See the GNU Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public License along with this 
+ * program.  If not, see http://www.gnu.org/licenses/.
+ */
+
+#ifndef IOURINGSENDER_H_
+#define IOURINGSENDER_H_
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include <boost/asio.hpp>
+#include <boost/function.hpp>
+#include <boost/thread.hpp>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+// Headers older than Linux 5.5 lack part of what the engine uses
+#if defined(HAVE_LINUX_IO_URING_H) && HAVE_DECL_IORING_OP_SENDMSG && HAVE_DECL_IORING_REGISTER_FILES_UPDATE && \
+	HAVE_DECL_IORING_FEAT_SINGLE_MMAP && defined(HAVE_STRUCT_IO_URING_FILES_UPDATE)
+#define IO_URING_SENDER 1
+#endif
+
+#ifdef IO_URING_SENDER
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#ifndef __NR_io_uring_setup
+#define __NR_io_uring_setup 425
+#endif
+
+#ifndef __NR_io_uring_enter
+#define __NR_io_uring_enter 426
+#endif
+
+#ifndef __NR_io_uring_register
+#define __NR_io_uring_register 427
+#endif
+#endif
+
+/*
+ * Sends the writes of every connection through one io_uring,
+ * instead of a system call per write on the asio reactor.
+ * Sockets are registered in a fixed file table when they
+ * connect, and each write is a single sendmsg request for the
+ * whole gather, resubmitted until everything is sent.  Writes
+ * started within a batch are submitted together when the batch
+ * ends; any others are submitted right away.  One thread waits
+ * for completions and runs the handlers, which may start more
+ * writes.
+ *
+ * There is no liburing; the ring is set up with the raw system
+ * calls.  Where the kernel headers or the kernel lack io_uring,
+ * start() fails and the connections keep using asio.
+ */
+class IoUringSender
+{
+public:
+	typedef boost::function<void (const boost::system::error_code&)> Handler;
+
+	IoUringSender() :
+		ringFd_(-1),
+		queued_(0),
+		batches_(0),
+		stopping_(false),
+		thread_(NULL)
+	{}
+
+	~IoUringSender()
+	{
+		stop();
+	}
+
+	bool running() const
+	{
+		return thread_ != NULL;
+	}
+
+#ifdef IO_URING_SENDER
+	/*
+	 * Set up a ring with room for entries requests at a time and
+	 * a table of files sockets, and start the completion thread.
+	 * Returns false if io_uring isn't available
+	 */
+	bool start(unsigned entries=256, unsigned files=1024)
+	{
+		stop();
+
+		struct io_uring_params params;
+		memset(&params, 0, sizeof(params));
+		ringFd_ = syscall(__NR_io_uring_setup, entries, &params);
+		if (ringFd_ < 0)
+		{
+			std::cerr<<"WARN unable to set up io_uring: "<<strerror(errno)<<std::endl;
+			return false;
+		}
+
+		sqSize_ = params.sq_off.array + params.sq_entries*sizeof(unsigned);
+		cqSize_ = params.cq_off.cqes + params.cq_entries*sizeof(struct io_uring_cqe);
+		if (params.features & IORING_FEAT_SINGLE_MMAP)
+			sqSize_ = cqSize_ = std::max(sqSize_, cqSize_);
+
+		sqRing_ = mmap(NULL, sqSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQ_RING);
+		cqRing_ = (params.features & IORING_FEAT_SINGLE_MMAP) ? sqRing_ :
+			mmap(NULL, cqSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_CQ_RING);
+		sqes_ = static_cast<struct io_uring_sqe*>(mmap(NULL, params.sq_entries*sizeof(struct io_uring_sqe),
+			PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQES));
+		sqesSize_ = params.sq_entries*sizeof(struct io_uring_sqe);
+
+		if (sqRing_ == MAP_FAILED || cqRing_ == MAP_FAILED || sqes_ == MAP_FAILED)
+		{
+			std::cerr<<"WARN unable to map io_uring: "<<strerror(errno)<<std::endl;
+			unmap();
+			return false;
+		}
+
+		char* sq = static_cast<char*>(sqRing_);
+		sqHead_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+		sqTail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+		sqMask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+		sqEntries_ = params.sq_entries;
+		sqArray_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+
+		char* cq = static_cast<char*>(cqRing_);
+		cqHead_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+		cqTail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+		cqMask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+		cqes_ = reinterpret_cast<struct io_uring_cqe*>(cq + params.cq_off.cqes);
+
+		// An empty table to register sockets in as they connect
+		files_.assign(files, -1);
+		generations_.assign(files, 0);
+		outstanding_.assign(files, 0);
+		retired_.assign(files, false);
+		if (syscall(__NR_io_uring_register, ringFd_, IORING_REGISTER_FILES, &files_[0], files) != 0)
+		{
+			std::cerr<<"WARN unable to register io_uring files: "<<strerror(errno)<<std::endl;
+			unmap();
+			return false;
+		}
+
+		freeSlots_.clear();
+		for (unsigned i=files; i!=0; i--)
+			freeSlots_.push_back(i-1);
+
+		stopping_ = false;
+		thread_ = new boost::thread(boost::bind(&IoUringSender::run, this));
+		return true;
+	}
+
+	/*
+	 * Stop the completion thread and tear down the ring.  Every
+	 * socket must have been unregistered and every write finished
+	 */
+	void stop()
+	{
+		if (thread_)
+		{
+			{
+				boost::mutex::scoped_lock lock(lock_);
+				stopping_ = true;
+
+				// A request without a handler to wake the thread up
+				struct io_uring_sqe* sqe = next_sqe();
+				sqe->opcode = IORING_OP_NOP;
+				sqe->user_data = 0;
+				submit_queued();
+			}
+
+			thread_->join();
+			delete thread_;
+			thread_ = NULL;
+		}
+
+		unmap();
+	}
+
+	/*
+	 * Add a connected socket to the file table.  Returns the slot
+	 * to write to and sets its generation, or returns -1 if the
+	 * table is full
+	 */
+	int registerFile(int fd, unsigned& generation)
+	{
+		boost::mutex::scoped_lock lock(lock_);
+		if (freeSlots_.empty())
+			return -1;
+
+		int slot = freeSlots_.back();
+		if (!update_file(slot, fd))
+			return -1;
+
+		freeSlots_.pop_back();
+		generation = generations_[slot];
+		return slot;
+	}
+
+	/*
+	 * Remove a socket from the file table before it is closed.
+	 * Writes to it complete as aborted.  Requests still queued in
+	 * a batch refer to the slot by number, so it isn't handed out
+	 * again until every one of them has completed
+	 */
+	void unregisterFile(int slot)
+	{
+		boost::mutex::scoped_lock lock(lock_);
+		update_file(slot, -1);
+		generations_[slot]++;
+		if (outstanding_[slot] == 0)
+			freeSlots_.push_back(slot);
+		else
+			retired_[slot] = true;
+	}
+
+	/*
+	 * Send the whole buffer sequence to the socket in slot, then
+	 * call handler on the completion thread.  The buffers must
+	 * stay valid until then
+	 */
+	void async_write(int slot, unsigned generation, const std::vector<boost::asio::const_buffer>& buffers, const Handler& handler)
+	{
+		Request* request = new Request;
+		request->slot = slot;
+		request->generation = generation;
+		request->handler = handler;
+		request->next = 0;
+		request->iov.resize(buffers.size());
+		for (size_t i=0; i!=buffers.size(); i++)
+		{
+			request->iov[i].iov_base = const_cast<void*>(boost::asio::buffer_cast<const void*>(buffers[i]));
+			request->iov[i].iov_len = boost::asio::buffer_size(buffers[i]);
+		}
+
+		boost::mutex::scoped_lock lock(lock_);
+		queue(request);
+		if (batches_ == 0)
+			submit_queued();
+	}
+
+	/*
+	 * Hold back submitting writes until the matching endBatch
+	 */
+	void beginBatch()
+	{
+		boost::mutex::scoped_lock lock(lock_);
+		batches_++;
+	}
+
+	void endBatch()
+	{
+		boost::mutex::scoped_lock lock(lock_);
+		if (--batches_ == 0)
+			submit_queued();
+	}
+
+private:
+	struct Request
+	{
+		int slot;
+		unsigned generation;
+		std::vector<struct iovec> iov;
+		size_t next;
+		struct msghdr msg;
+		Handler handler;
+	};
+
+	/*
+	 * Must be called with lock_ held
+	 */
+	bool update_file(int slot, int fd)
+	{
+		struct io_uring_files_update update;
+		memset(&update, 0, sizeof(update));
+		update.offset = slot;
+		update.fds = reinterpret_cast<unsigned long>(&fd);
+		if (syscall(__NR_io_uring_register, ringFd_, IORING_REGISTER_FILES_UPDATE, &update, 1) < 0)
+		{
+			std::cerr<<"WARN unable to update io_uring file "<<slot<<": "<<strerror(errno)<<std::endl;
+			return false;
+		}
+		return true;
+	}
+
+	/*
+	 * A free submission queue entry, making room by submitting
+	 * if the queue is full.  Must be called with lock_ held
+	 */
+	struct io_uring_sqe* next_sqe()
+	{
+		unsigned tail = *sqTail_;
+		while (tail - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE) == sqEntries_)
+			submit_queued();
+
+		unsigned index = tail & sqMask_;
+		struct io_uring_sqe* sqe = &sqes_[index];
+		memset(sqe, 0, sizeof(*sqe));
+		sqArray_[index] = index;
+		__atomic_store_n(sqTail_, tail + 1, __ATOMIC_RELEASE);
+		queued_++;
+		return sqe;
+	}
+
+	/*
+	 * Queue a sendmsg for the rest of a request.  Must be called
+	 * with lock_ held
+	 */
+	void queue(Request* request)
+	{
+		memset(&request->msg, 0, sizeof(request->msg));
+		request->msg.msg_iov = &request->iov[request->next];
+		request->msg.msg_iovlen = std::min<size_t>(request->iov.size() - request->next, IOV_MAX);
+
+		outstanding_[request->slot]++;
+
+		struct io_uring_sqe* sqe = next_sqe();
+		sqe->opcode = IORING_OP_SENDMSG;
+		sqe->flags = IOSQE_FIXED_FILE;
+		sqe->fd = request->slot;
+		sqe->addr = reinterpret_cast<unsigned long>(&request->msg);
+		sqe->len = 1;
+		sqe->msg_flags = MSG_NOSIGNAL;
+		sqe->user_data = reinterpret_cast<unsigned long>(request);
+	}
+
+	/*
+	 * Must be called with lock_ held
+	 */
+	void submit_queued()
+	{
+		while (queued_)
+		{
+			int submitted = syscall(__NR_io_uring_enter, ringFd_, queued_, 0, 0, NULL, 0);
+			if (submitted < 0)
+			{
+				if (errno == EINTR || errno == EAGAIN || errno == EBUSY)
+					continue;
+				std::cerr<<"ERROR submitting to io_uring: "<<strerror(errno)<<std::endl;
+				return;
+			}
+			queued_ -= std::min<unsigned>(queued_, submitted);
+		}
+	}
+
+	/*
+	 * The completion thread
+	 */
+	void run()
+	{
+		std::vector<std::pair<Request*, int> > completions;
+		while (true)
+		{
+			if (syscall(__NR_io_uring_enter, ringFd_, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0) < 0 && errno != EINTR)
+			{
+				std::cerr<<"ERROR waiting on io_uring: "<<strerror(errno)<<std::endl;
+				return;
+			}
+
+			completions.clear();
+			bool wake = false;
+			unsigned head = *cqHead_;
+			unsigned tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+			for (; head != tail; head++)
+			{
+				struct io_uring_cqe* cqe = &cqes_[head & cqMask_];
+				if (cqe->user_data)
+					completions.push_back(std::make_pair(reinterpret_cast<Request*>(cqe->user_data), cqe->res));
+				else
+					wake = true;
+			}
+			__atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+
+			for (size_t i=0; i!=completions.size(); i++)
+				complete(completions[i].first, completions[i].second);
+
+			if (wake)
+			{
+				boost::mutex::scoped_lock lock(lock_);
+				if (stopping_)
+					return;
+			}
+		}
+	}
+
+	/*
+	 * Resubmit the rest of a short write, or finish the request
+	 */
+	void complete(Request* request, int result)
+	{
+		boost::system::error_code error;
+		{
+			boost::mutex::scoped_lock lock(lock_);
+			if (--outstanding_[request->slot] == 0 && retired_[request->slot])
+			{
+				retired_[request->slot] = false;
+				freeSlots_.push_back(request->slot);
+			}
+
+			if (generations_[request->slot] != request->generation)
+				error = boost::asio::error::operation_aborted;
+			else if (result < 0)
+				error = boost::system::error_code(-result, boost::asio::error::get_system_category());
+			else
+			{
+				// Drop what was sent from the front of the request
+				size_t sent = result;
+				while (request->next != request->iov.size() && sent >= request->iov[request->next].iov_len)
+					sent -= request->iov[request->next++].iov_len;
+				if (request->next != request->iov.size())
+				{
+					request->iov[request->next].iov_base = static_cast<char*>(request->iov[request->next].iov_base) + sent;
+					request->iov[request->next].iov_len -= sent;
+					queue(request);
+					if (batches_ == 0)
+						submit_queued();
+					return;
+				}
+			}
+		}
+
+		request->handler(error);
+		delete request;
+	}
+
+	void unmap()
+	{
+		if (ringFd_ < 0)
+			return;
+
+		if (sqes_ && sqes_ != MAP_FAILED)
+			munmap(sqes_, sqesSize_);
+		if (cqRing_ && cqRing_ != MAP_FAILED && cqRing_ != sqRing_)
+			munmap(cqRing_, cqSize_);
+		if (sqRing_ && sqRing_ != MAP_FAILED)
+			munmap(sqRing_, sqSize_);
+		::close(ringFd_);
+		ringFd_ = -1;
+		sqRing_ = cqRing_ = NULL;
+		sqes_ = NULL;
+		queued_ = 0;
+	}
+
+	void* sqRing_;
+	void* cqRing_;
+	size_t sqSize_;
+	size_t cqSize_;
+	size_t sqesSize_;
+	unsigned* sqHead_;
+	unsigned* sqTail_;
+	unsigned sqMask_;
+	unsigned sqEntries_;
+	unsigned* sqArray_;
+	struct io_uring_sqe* sqes_;
+	unsigned* cqHead_;
+	unsigned* cqTail_;
+	unsigned cqMask_;
+	struct io_uring_cqe* cqes_;
+	std::vector<int> files_;
+	std::vector<unsigned> generations_;
+	std::vector<unsigned> outstanding_;
+	std::vector<bool> retired_;
+	std::vector<int> freeSlots_;
+#else
+	bool start(unsigned entries=256, unsigned files=1024)
+	{
+		std::cerr<<"WARN built without io_uring support"<<std::endl;
+		return false;
+	}
+
+	void stop() {}
+
+	int registerFile(int fd, unsigned& generation)
+	{
+		return -1;
+	}
+
+	void unregisterFile(int slot) {}
+
+	void async_write(int slot, unsigned generation, const std::vector<boost::asio::const_buffer>& buffers, const Handler& handler) {}
+
+	void beginBatch() {}
+
+	void endBatch() {}
+
+private:
+#endif
+	int ringFd_;
+	unsigned queued_;
+	unsigned batches_;
+	bool stopping_;
+	boost::thread* thread_;
+	boost::mutex lock_;
+};
+
+/*
+ * A socket's place in an IoUringSender's file table, if it has
+ * one
+ */
+class IoUringFile
+{
+public:
+	IoUringFile(IoUringSender* engine) :
+		engine_(engine),
+		slot_(-1),
+		generation_(0)
+	{}
+
+	~IoUringFile()
+	{
+		release(-1);
+	}
+
+	/*
+	 * Register a newly connected socket.  Returns false if there
+	 * is no engine or no room for it, leaving it to asio
+	 */
+	bool attach(int fd)
+	{
+		release(-1);
+		if (engine_)
+			slot_ = engine_->registerFile(fd, generation_);
+		return slot_ >= 0;
+	}
+
+	/*
+	 * Unregister the socket before it is closed, shutting it down
+	 * so that a write blocked on it gives up
+	 */
+	void release(int fd)
+	{
+		if (slot_ < 0)
+			return;
+
+		engine_->unregisterFile(slot_);
+		slot_ = -1;
+		if (fd >= 0)
+			::shutdown(fd, SHUT_RDWR);
+	}
+
+	bool attached() const
+	{
+		return slot_ >= 0;
+	}
+
+	void async_write(const std::vector<boost::asio::const_buffer>& buffers, const IoUringSender::Handler& handler)
+	{
+		engine_->async_write(slot_, generation_, buffers, handler);
+	}
+
+private:
+	IoUringSender* engine_;
+	int slot_;
+	unsigned generation_;
+};
+
+/*
+ * Submits every write started in its lifetime together
+ */
+class IoUringBatch
+{
+public:
+	IoUringBatch(IoUringSender& engine) :
+		engine_(engine.running() ? &engine : NULL)
+	{
+		if (engine_)
+			engine_->beginBatch();
+	}
+
+	~IoUringBatch()
+	{
+		if (engine_)
+			engine_->endBatch();
+	}
+
+private:
+	IoUringSender* engine_;
+};
+
+#endif /* IOURINGSENDER_H_ */
@@ -0,0 +1,48 @@
+/*
+ * This file is protected by Copyright. Please refer to the COPYRIGHT file distributed with this 
+ * source distribution.
+ * 
+ * This file is part of REDHAWK Basic Components sinksocket.
+ * 
+ * REDHAWK Basic Components sinksocket is free software: you can redistribute it and/or modify it under the terms of 
+ * the GNU Lesser General Public License as published by the Free Software Foundation, either 
+ * version 3 of the License, or (at your option) any later version.
+ * 
+ * REDHAWK Basic Components sinksocket is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; 
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR 
+ * PURPOSE.  See the GNU Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public License along with this 
+ * program.  If not, see http://www.gnu.org/licenses/.
+ */
+
+#ifndef PACKETTIME_H_
+#define PACKETTIME_H_
+
+#include <boost/cstdint.hpp>
+#include <cmath>
+
+/*
+ * Split the time of a sample offset seconds after the time given
+ * in whole and fractional seconds into whole seconds, zero if
+ * negative, and picoseconds rounded to the nearest.  Header and
+ * VITA-49 framing both stamp their packets this way
+ */
+inline void splitTime(double wholeSeconds, double fractionalSeconds, double offset, boost::uint64_t& seconds, boost::uint64_t& picoseconds)
+{
+	// Either part may hold some of the other's
+	double whole = std::floor(wholeSeconds);
+	double fraction = (wholeSeconds - whole) + fractionalSeconds + offset;
+	whole += std::floor(fraction);
+	fraction -= std::floor(fraction);
+	double rounded = std::floor(fraction * 1e12 + 0.5);
+	if (rounded >= 1e12)
+	{
+		whole += 1;
+		rounded -= 1e12;
+	}
+	seconds = whole > 0 ? static_cast<boost::uint64_t>(whole) : 0;
+	picoseconds = static_cast<boost::uint64_t>(rounded);
+}
+
+#endif /* PACKETTIME_H_ */
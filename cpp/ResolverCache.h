@@ -0,0 +1,178 @@
+/*
+ * This file is protected by Copyright. Please refer to the COPYRIGHT file distributed with this 
+ * source distribution.
+ * 
+ * This file is part of REDHAWK Basic Components sinksocket.
+ * 
+ * REDHAWK Basic Components sinksocket is free software: you can redistribute it and/or modify it under the terms of 
+ * the GNU Lesser General Public License as published by the Free Software Foundation, either 
+ * version 3 of the License, or (at your option) any later version.
+ * 
+ * REDHAWK Basic Components sinksocket is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; 
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR 
+ * PURPOSE.  See the GNU Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public License along with this 
+ * program.  If not, see http://www.gnu.org/licenses/.
+ */
+
+#ifndef RESOLVERCACHE_H_
+#define RESOLVERCACHE_H_
+
+#include <boost/asio.hpp>
+#include <boost/bind.hpp>
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/function.hpp>
+#include <boost/thread/mutex.hpp>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+/*
+ * The addresses a host name resolves to, shared by every client
+ * connecting to that host.  Lookups are asynchronous, and any
+ * number of requests made while one is in flight all wait on
+ * it.  Once the addresses are older than the TTL, requests still
+ * get them right away while a refresh runs in the background.
+ * Literal addresses are never looked up.
+ */
+class ResolverCache : public boost::enable_shared_from_this<ResolverCache>
+{
+public:
+	typedef std::vector<boost::asio::ip::address> Addresses;
+	typedef boost::function<void (const boost::system::error_code&, const Addresses&)> Handler;
+
+	ResolverCache(boost::asio::io_service& io_service, const std::string& host, unsigned long ttl) :
+		io_service_(io_service),
+		resolver_(io_service),
+		host_(host),
+		ttl_(boost::posix_time::seconds(ttl)),
+		resolving_(false),
+		nextTicket_(1)
+	{
+		boost::system::error_code ec;
+		boost::asio::ip::address address = boost::asio::ip::address::from_string(host, ec);
+		if (!ec)
+		{
+			addresses_.push_back(address);
+			expires_ = boost::posix_time::pos_infin;
+		}
+	}
+
+	const std::string& host() const
+	{
+		return host_;
+	}
+
+	/*
+	 * Call handler on the io_service with the addresses of the
+	 * host.  Returns a ticket that can be used to cancel the
+	 * request
+	 */
+	unsigned long async_resolve(const Handler& handler)
+	{
+		boost::mutex::scoped_lock lock(lock_);
+		unsigned long ticket = nextTicket_++;
+
+		if (!addresses_.empty())
+		{
+			io_service_.post(boost::bind(handler, boost::system::error_code(), addresses_));
+			if (now() >= expires_)
+				start_resolve();
+		}
+		else
+		{
+			waiters_[ticket] = handler;
+			start_resolve();
+		}
+
+		return ticket;
+	}
+
+	/*
+	 * Complete a request that is still waiting with
+	 * operation_aborted
+	 */
+	void cancel(unsigned long ticket)
+	{
+		boost::mutex::scoped_lock lock(lock_);
+		std::map<unsigned long, Handler>::iterator i = waiters_.find(ticket);
+		if (i != waiters_.end())
+		{
+			io_service_.post(boost::bind(i->second, boost::asio::error::operation_aborted, Addresses()));
+			waiters_.erase(i);
+		}
+	}
+
+	/*
+	 * Treat the addresses as stale, so that the next request
+	 * refreshes them, for example after none of them answered
+	 */
+	void expire()
+	{
+		boost::mutex::scoped_lock lock(lock_);
+		if (!expires_.is_pos_infinity())
+			expires_ = now();
+	}
+
+private:
+	static boost::posix_time::ptime now()
+	{
+		return boost::posix_time::microsec_clock::universal_time();
+	}
+
+	/*
+	 * Must be called with lock_ held
+	 */
+	void start_resolve()
+	{
+		if (resolving_)
+			return;
+
+		resolving_ = true;
+		resolver_.async_resolve(boost::asio::ip::tcp::resolver::query(host_, ""),
+			boost::bind(&ResolverCache::handle_resolve, shared_from_this(),
+					boost::asio::placeholders::error,
+					boost::asio::placeholders::iterator));
+	}
+
+	void handle_resolve(const boost::system::error_code& error, boost::asio::ip::tcp::resolver::iterator iter)
+	{
+		boost::mutex::scoped_lock lock(lock_);
+		resolving_ = false;
+
+		// Keep using the old addresses if a refresh fails
+		if (!error)
+		{
+			addresses_.clear();
+			for (; iter != boost::asio::ip::tcp::resolver::iterator(); ++iter)
+			{
+				if (std::find(addresses_.begin(), addresses_.end(), iter->endpoint().address()) == addresses_.end())
+					addresses_.push_back(iter->endpoint().address());
+			}
+			expires_ = now() + ttl_;
+		}
+
+		boost::system::error_code result = error;
+		if (!error && addresses_.empty())
+			result = boost::asio::error::host_not_found;
+
+		for (std::map<unsigned long, Handler>::iterator i = waiters_.begin(); i != waiters_.end(); ++i)
+			io_service_.post(boost::bind(i->second, result, addresses_));
+		waiters_.clear();
+	}
+
+	boost::asio::io_service& io_service_;
+	boost::asio::ip::tcp::resolver resolver_;
+	std::string host_;
+	boost::posix_time::time_duration ttl_;
+	Addresses addresses_;
+	boost::posix_time::ptime expires_;
+	bool resolving_;
+	std::map<unsigned long, Handler> waiters_;
+	unsigned long nextTicket_;
+	boost::mutex lock_;
+};
+
+#endif /* RESOLVERCACHE_H_ */
@@ -0,0 +1,320 @@
+/*
+ * This file is protected by Copyright. Please refer to the COPYRIGHT file distributed with this 
+ * source distribution.
+ * 
+ * This file is part of REDHAWK Basic Components sinksocket.
+ * 
+ * REDHAWK Basic Components sinksocket is free software: you can redistribute it and/or modify it under the terms of 
+ * the GNU Lesser General Public License as published by the Free Software Foundation, either 
+ * version 3 of the License, or (at your option) any later version.
+ * 
+ * REDHAWK Basic Components sinksocket is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; 
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR 
+ * PURPOSE.  See the GNU Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public License along with this 
+ * program.  If not, see http://www.gnu.org/licenses/.
+ */
+
+#ifndef SENDQUEUE_H_
+#define SENDQUEUE_H_
+
+#include <boost/asio/buffer.hpp>
+#include <deque>
+#include <vector>
+
+#include "SharedBuffer.h"
+
+/*
+ * What a SendQueue does with new data once it is full
+ */
+enum OverflowPolicy
+{
+	DROP_NEWEST,	// discard the new data
+	DROP_OLDEST,	// discard the oldest data that hasn't started sending
+	CONFLATE,		// discard all data that hasn't started sending
+	DISCONNECT		// discard all data that hasn't started sending and close the socket
+};
+
+struct QueueLimits
+{
+	QueueLimits(size_t max_bytes=0, size_t max_packets=0, OverflowPolicy overflow_policy=DROP_NEWEST) :
+		maxBytes(max_bytes),
+		maxPackets(max_packets),
+		policy(overflow_policy)
+	{}
+
+	// Zero means no limit.  The byte limit includes data being
+	// written; the packet limit only counts data waiting to be
+	// written
+	size_t maxBytes;
+	size_t maxPackets;
+	OverflowPolicy policy;
+};
+
+/*
+ * Counts of data discarded by a SendQueue
+ */
+struct DropCounts
+{
+	DropCounts() :
+		packets(0),
+		bytes(0)
+	{}
+
+	DropCounts& operator+=(const DropCounts& other)
+	{
+		packets+=other.packets;
+		bytes+=other.bytes;
+		return *this;
+	}
+
+	size_t packets;
+	size_t bytes;
+};
+
+/*
+ * The buffers waiting to be written to one socket.  Everything
+ * that was queued while a write was in progress goes out in the
+ * next write as a single buffer sequence, so a backed up
+ * connection catches up with a few gather writes instead of one
+ * write per packet.  The queue never holds more than its limits
+ * allow; what happens to the excess is set by the overflow
+ * policy.  A packet may have a header, which is written in the
+ * same gather write just ahead of it and dropped along with it.
+ *
+ * This class does no locking of its own; the owner must
+ * serialize access to it.
+ */
+class SendQueue
+{
+public:
+	enum PushResult
+	{
+		QUEUED,			// the data was queued behind a write in progress
+		START_WRITE,	// the data was queued and the caller must start a write
+		DROPPED,		// the data was discarded
+		OVERFLOWED		// the queue was emptied and the caller must disconnect
+	};
+
+	// How much a single gather write takes by default
+	static const size_t DEFAULT_GATHER_BYTES = 4*1024*1024;
+	static const size_t DEFAULT_GATHER_BUFFERS = 256;
+
+	SendQueue(const QueueLimits& limits=QueueLimits(), size_t max_gather_bytes=DEFAULT_GATHER_BYTES, size_t max_gather_buffers=DEFAULT_GATHER_BUFFERS) :
+		limits_(limits),
+		maxGatherBytes_(max_gather_bytes),
+		maxGatherBuffers_(max_gather_buffers),
+		zeroCopyThreshold_(0),
+		zeroCopy_(false),
+		pendingBytes_(0),
+		inFlightPackets_(0),
+		inFlightBytes_(0)
+	{}
+
+	/*
+	 * Add a buffer, with its header if any, to the queue,
+	 * applying the overflow policy if the queue is full.  Anything
+	 * discarded is added to dropped
+	 */
+	PushResult push(const SharedBuffer& data, DropCounts& dropped, const SharedBuffer& header=SharedBuffer())
+	{
+		if (data.empty() && header.empty())
+			return QUEUED;
+
+		Packet packet;
+		packet.header = header;
+		packet.data = data;
+		size_t size = packet.size();
+
+		if (full(size))
+		{
+			switch (limits_.policy)
+			{
+			case DROP_NEWEST:
+				dropped.packets++;
+				dropped.bytes+=size;
+				return DROPPED;
+
+			case DROP_OLDEST:
+				while (!pending_.empty() && full(size))
+					dropPending(dropped);
+				break;
+
+			case CONFLATE:
+				while (!pending_.empty())
+					dropPending(dropped);
+				break;
+
+			case DISCONNECT:
+				dropped.packets++;
+				dropped.bytes+=size;
+				while (!pending_.empty())
+					dropPending(dropped);
+				return OVERFLOWED;
+			}
+		}
+
+		pending_.push_back(packet);
+		pendingBytes_+=size;
+		return inFlight_.empty() ? START_WRITE : QUEUED;
+	}
+
+	/*
+	 * Move as many pending buffers as the limits allow into the
+	 * in-flight set and return the buffer sequence to write.  The
+	 * first pending buffer is always taken, even if it alone is
+	 * larger than the byte limit.  With a zero copy threshold,
+	 * buffers at least that large are never written together
+	 * with smaller ones.  Returns false if there is nothing to
+	 * send
+	 */
+	bool startWrite(std::vector<boost::asio::const_buffer>& sequence)
+	{
+		sequence.clear();
+		zeroCopy_ = !pending_.empty() && isZeroCopy(pending_.front().data);
+		while (!pending_.empty() && inFlightPackets_ < maxGatherBuffers_)
+		{
+			const Packet& next = pending_.front();
+			if (!inFlight_.empty() && inFlightBytes_+next.size() > maxGatherBytes_)
+				break;
+			if (isZeroCopy(next.data) != zeroCopy_)
+				break;
+			if (!next.header.empty())
+			{
+				inFlight_.push_back(next.header);
+				sequence.push_back(next.header.buffer());
+			}
+			if (!next.data.empty())
+			{
+				inFlight_.push_back(next.data);
+				sequence.push_back(next.data.buffer());
+			}
+			inFlightPackets_++;
+			inFlightBytes_+=next.size();
+			pendingBytes_-=next.size();
+			pending_.pop_front();
+		}
+		return !inFlight_.empty();
+	}
+
+	/*
+	 * Release the buffers sent by the last write
+	 */
+	void writeComplete()
+	{
+		inFlight_.clear();
+		inFlightPackets_=0;
+		inFlightBytes_=0;
+	}
+
+	void clear()
+	{
+		pending_.clear();
+		pendingBytes_=0;
+		writeComplete();
+	}
+
+	/*
+	 * Empty the queue, adding the buffers that hadn't started
+	 * sending to dropped
+	 */
+	void clear(DropCounts& dropped)
+	{
+		while (!pending_.empty())
+			dropPending(dropped);
+		clear();
+	}
+
+	bool writing() const
+	{
+		return !inFlight_.empty();
+	}
+
+	/*
+	 * The buffers of the write in progress, headers included
+	 */
+	const std::vector<SharedBuffer>& inFlight() const
+	{
+		return inFlight_;
+	}
+
+	/*
+	 * Whether the write in progress should be sent without
+	 * copying
+	 */
+	bool zeroCopy() const
+	{
+		return zeroCopy_;
+	}
+
+	/*
+	 * Packets of at least threshold bytes are written on their
+	 * own, to be sent without copying.  Zero turns that off
+	 */
+	void setZeroCopyThreshold(size_t threshold)
+	{
+		zeroCopyThreshold_ = threshold;
+	}
+
+	/*
+	 * The number of bytes queued or being written
+	 */
+	size_t bytes() const
+	{
+		return pendingBytes_+inFlightBytes_;
+	}
+
+private:
+	struct Packet
+	{
+		size_t size() const
+		{
+			return header.size()+data.size();
+		}
+
+		SharedBuffer header;
+		SharedBuffer data;
+	};
+
+	/*
+	 * Whether adding newBytes more would exceed a limit
+	 */
+	bool full(size_t newBytes) const
+	{
+		if (limits_.maxBytes && bytes()+newBytes > limits_.maxBytes)
+			return true;
+		if (limits_.maxPackets && pending_.size() >= limits_.maxPackets)
+			return true;
+		return false;
+	}
+
+	bool isZeroCopy(const SharedBuffer& data) const
+	{
+		return zeroCopyThreshold_ && data.size() >= zeroCopyThreshold_;
+	}
+
+	/*
+	 * Discard the oldest buffer that hasn't started sending
+	 */
+	void dropPending(DropCounts& dropped)
+	{
+		dropped.packets++;
+		dropped.bytes+=pending_.front().size();
+		pendingBytes_-=pending_.front().size();
+		pending_.pop_front();
+	}
+
+	QueueLimits limits_;
+	size_t maxGatherBytes_;
+	size_t maxGatherBuffers_;
+	size_t zeroCopyThreshold_;
+	bool zeroCopy_;
+	std::deque<Packet> pending_;
+	std::vector<SharedBuffer> inFlight_;
+	size_t pendingBytes_;
+	size_t inFlightPackets_;
+	size_t inFlightBytes_;
+};
+
+#endif /* SENDQUEUE_H_ */
@@ -0,0 +1,113 @@
+/*
+ * This file is protected by Copyright. Please refer to the COPYRIGHT file distributed with this 
+ * source distribution.
+ * 
+ * This file is part of REDHAWK Basic Components sinksocket.
+ * 
+ * REDHAWK Basic Components sinksocket is free software: you can redistribute it and/or modify it under the terms of 
+ * the GNU Lesser General Public License as published by the Free Software Foundation, either 
+ * version 3 of the License, or (at your option) any later version.
+ * 
+ * REDHAWK Basic Components sinksocket is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; 
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR 
+ * PURPOSE.  See the GNU Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public License along with this 
+ * program.  If not, see http://www.gnu.org/licenses/.
+ */
+
+#ifndef SHAREDBUFFER_H_
+#define SHAREDBUFFER_H_
+
+#include <boost/asio/buffer.hpp>
+#include <boost/shared_ptr.hpp>
+#include <vector>
+
+/*
+ * An immutable, reference counted block of bytes.  The same
+ * SharedBuffer can be queued on any number of connections
+ * without copying the data it refers to, and the memory is
+ * released once the last connection is done sending it.
+ */
+class SharedBuffer
+{
+public:
+	SharedBuffer() :
+		data_(NULL),
+		size_(0)
+	{}
+
+	/*
+	 * Take ownership of the contents of a vector without copying
+	 * them.  The vector is left empty
+	 */
+	template<typename T, typename U>
+	static SharedBuffer adopt(std::vector<T, U>& data)
+	{
+		boost::shared_ptr<std::vector<T, U> > owner(new std::vector<T, U>(data.get_allocator()));
+		owner->swap(data);
+
+		if (owner->empty())
+			return SharedBuffer();
+
+		return SharedBuffer(owner, reinterpret_cast<const char*>(&(*owner)[0]), owner->size()*sizeof(T));
+	}
+
+	/*
+	 * Refer to size bytes at data, which stay valid for as long as
+	 * owner does
+	 */
+	template<typename T>
+	static SharedBuffer wrap(const boost::shared_ptr<T>& owner, const char* data, size_t size)
+	{
+		if (size==0)
+			return SharedBuffer();
+
+		return SharedBuffer(owner, data, size);
+	}
+
+	/*
+	 * Refer to size bytes of this buffer starting at offset,
+	 * keeping the whole buffer alive
+	 */
+	SharedBuffer slice(size_t offset, size_t size) const
+	{
+		if (size==0)
+			return SharedBuffer();
+
+		return SharedBuffer(owner_, data_+offset, size);
+	}
+
+	const char* data() const
+	{
+		return data_;
+	}
+
+	size_t size() const
+	{
+		return size_;
+	}
+
+	bool empty() const
+	{
+		return size_==0;
+	}
+
+	boost::asio::const_buffer buffer() const
+	{
+		return boost::asio::const_buffer(data_, size_);
+	}
+
+private:
+	SharedBuffer(const boost::shared_ptr<void>& owner, const char* data, size_t size) :
+		owner_(owner),
+		data_(data),
+		size_(size)
+	{}
+
+	boost::shared_ptr<void> owner_;
+	const char* data_;
+	size_t size_;
+};
+
+#endif /* SHAREDBUFFER_H_ */
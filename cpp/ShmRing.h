@@ -0,0 +1,506 @@
+/*
+ * This file is protected by Copyright. Please refer to the COPYRIGHT file distributed with this 
+ * source distribution.
+ * 
+ * This file is part of REDHAWK Basic Components sinksocket.
+ * 
+ * REDHAWK Basic Components sinksocket is free software: you can redistribute it and/or modify it under the terms of 
+ * the GNU Lesser General Public License as published by the Free Software Foundation, either 
+ * version 3 of the License, or (at your option) any later version.
+ * 
+ * REDHAWK Basic Components sinksocket is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; 
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR 
+ * PURPOSE.  See the GNU Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public License along with this 
+ * program.  If not, see http://www.gnu.org/licenses/.
+ */
+
+#ifndef SHMRING_H_
+#define SHMRING_H_
+
+#include <boost/cstdint.hpp>
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/*
+ * A ring of packets in POSIX shared memory, written by one
+ * process and read by any number of others on the same host.
+ * This header has no other dependencies, so readers can use
+ * it on its own.
+ *
+ * The segment starts with a 64 byte header, in host byte
+ * order:
+ *
+ *   offset  size  field
+ *        0     4  magic, SHM_RING_MAGIC
+ *        4     4  version, SHM_RING_VERSION
+ *        8     8  capacity, bytes of records after the header
+ *       16     8  reserved, position up to which the writer may be writing
+ *       24     8  head, position just past the last complete record
+ *       32     8  packets, the number of packets written
+ *       40     4  wakeups, bumped every time a record is completed
+ *       44     4  waiters, readers sleeping on wakeups
+ *       48     4  writer, process id of the writer
+ *
+ * Positions count bytes written since the segment was created;
+ * a position p is at byte p % capacity of the records.  Every
+ * record starts on a 16 byte boundary with its packet's
+ * sequence number and length, both 8 bytes, followed by the
+ * packet, and may wrap around the end of the records.
+ *
+ * The writer never waits for readers.  A reader that falls
+ * more than capacity bytes behind has lost data; it notices
+ * because the writer reserves the space it is about to
+ * overwrite before touching it, and skips ahead to the newest
+ * record.  The gap in sequence numbers tells it how many
+ * packets it missed.
+ */
+
+const boost::uint32_t SHM_RING_MAGIC = 0x53484d52;
+const boost::uint32_t SHM_RING_VERSION = 1;
+
+struct ShmRingHeader
+{
+	boost::uint32_t magic;
+	boost::uint32_t version;
+	boost::uint64_t capacity;
+	boost::uint64_t reserved;
+	boost::uint64_t head;
+	boost::uint64_t packets;
+	boost::uint32_t wakeups;
+	boost::uint32_t waiters;
+	boost::uint32_t writer;
+	char padding[12];
+};
+
+struct ShmRecordHeader
+{
+	boost::uint64_t sequence;
+	boost::uint64_t length;
+};
+
+inline boost::uint64_t shm_record_size(boost::uint64_t length)
+{
+	return sizeof(ShmRecordHeader) + ((length + 15) & ~boost::uint64_t(15));
+}
+
+/*
+ * Maps a ring segment and knows where its records are
+ */
+class ShmRingSegment
+{
+public:
+	ShmRingSegment() :
+		header_(NULL),
+		records_(NULL),
+		size_(0)
+	{}
+
+	~ShmRingSegment()
+	{
+		unmap();
+	}
+
+	bool is_open() const
+	{
+		return header_ != NULL;
+	}
+
+	const std::string& name() const
+	{
+		return name_;
+	}
+
+protected:
+	bool map(int fd, size_t size, int protection)
+	{
+		void* address = mmap(NULL, size, protection, MAP_SHARED, fd, 0);
+		::close(fd);
+		if (address == MAP_FAILED)
+			return false;
+
+		header_ = static_cast<ShmRingHeader*>(address);
+		records_ = static_cast<char*>(address) + sizeof(ShmRingHeader);
+		size_ = size;
+		return true;
+	}
+
+	void unmap()
+	{
+		if (header_)
+			munmap(header_, size_);
+		header_ = NULL;
+		records_ = NULL;
+		size_ = 0;
+	}
+
+	/*
+	 * Copy size bytes between the records at position and
+	 * memory, wrapping around the end of the records
+	 */
+	void copy_in(boost::uint64_t position, const char* data, size_t size)
+	{
+		size_t offset = position % header_->capacity;
+		size_t first = std::min<size_t>(size, header_->capacity - offset);
+		memcpy(records_ + offset, data, first);
+		memcpy(records_, data + first, size - first);
+	}
+
+	void copy_out(boost::uint64_t position, char* data, size_t size) const
+	{
+		size_t offset = position % header_->capacity;
+		size_t first = std::min<size_t>(size, header_->capacity - offset);
+		memcpy(data, records_ + offset, first);
+		memcpy(data + first, records_, size - first);
+	}
+
+	static long futex(boost::uint32_t* word, int op, boost::uint32_t value, const struct timespec* timeout)
+	{
+		return syscall(SYS_futex, word, op, value, timeout, NULL, 0);
+	}
+
+	ShmRingHeader* header_;
+	char* records_;
+	size_t size_;
+	std::string name_;
+};
+
+/*
+ * Creates a ring and writes packets into it.  Only one thread
+ * may write at a time
+ */
+class ShmRingWriter : public ShmRingSegment
+{
+public:
+	ShmRingWriter() :
+		droppedPackets_(0),
+		droppedBytes_(0)
+	{}
+
+	~ShmRingWriter()
+	{
+		close();
+	}
+
+	/*
+	 * Create the segment called name with room for capacity bytes
+	 * of records, readable and writable by the given users.  A
+	 * ring left behind by a writer that no longer runs is
+	 * replaced, but any other segment under that name is left
+	 * alone.  Returns false and sets errno on failure
+	 */
+	bool create(const std::string& name, size_t capacity, mode_t mode = 0600)
+	{
+		close();
+
+		capacity = (std::max<size_t>(capacity, 4096) + 15) & ~size_t(15);
+		size_t size = sizeof(ShmRingHeader) + capacity;
+
+		int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, mode);
+		if (fd < 0 && errno == EEXIST)
+		{
+			if (is_stale(name))
+			{
+				shm_unlink(name.c_str());
+				fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, mode);
+			}
+			else
+				errno = EEXIST;
+		}
+		if (fd < 0)
+			return false;
+
+		bool mapped = false;
+		if (ftruncate(fd, size) == 0)
+			mapped = map(fd, size, PROT_READ | PROT_WRITE);
+		else
+			::close(fd);
+
+		if (!mapped)
+		{
+			int error = errno;
+			shm_unlink(name.c_str());
+			errno = error;
+			return false;
+		}
+
+		memset(header_, 0, sizeof(ShmRingHeader));
+		header_->capacity = capacity;
+		header_->version = SHM_RING_VERSION;
+		header_->writer = getpid();
+		__atomic_store_n(&header_->magic, SHM_RING_MAGIC, __ATOMIC_RELEASE);
+		name_ = name;
+		return true;
+	}
+
+	/*
+	 * Remove the segment.  Readers that have it mapped keep it
+	 * until they close it, but get no more packets
+	 */
+	void close()
+	{
+		if (is_open())
+			shm_unlink(name_.c_str());
+		unmap();
+		name_.clear();
+	}
+
+	/*
+	 * Append a packet and wake up any waiting readers.  Returns
+	 * false if the packet is too large to ever fit
+	 */
+	bool write(const char* data, size_t size)
+	{
+		if (!is_open() || shm_record_size(size) > header_->capacity)
+		{
+			__atomic_add_fetch(&droppedPackets_, 1, __ATOMIC_RELAXED);
+			__atomic_add_fetch(&droppedBytes_, size, __ATOMIC_RELAXED);
+			return false;
+		}
+
+		boost::uint64_t position = header_->head;
+		boost::uint64_t end = position + shm_record_size(size);
+		ShmRecordHeader record;
+		record.sequence = header_->packets;
+		record.length = size;
+
+		// Claim the space before overwriting it, so that a reader
+		// copying out an old record there can tell it was torn
+		__atomic_store_n(&header_->reserved, end, __ATOMIC_RELAXED);
+		__atomic_thread_fence(__ATOMIC_RELEASE);
+
+		copy_in(position, reinterpret_cast<const char*>(&record), sizeof(record));
+		copy_in(position + sizeof(record), data, size);
+
+		__atomic_store_n(&header_->head, end, __ATOMIC_RELEASE);
+		__atomic_store_n(&header_->packets, record.sequence + 1, __ATOMIC_RELEASE);
+
+		__atomic_add_fetch(&header_->wakeups, 1, __ATOMIC_SEQ_CST);
+		if (__atomic_load_n(&header_->waiters, __ATOMIC_SEQ_CST) != 0)
+			futex(&header_->wakeups, FUTEX_WAKE, INT_MAX, NULL);
+
+		return true;
+	}
+
+	/*
+	 * The packets that didn't fit, safe to call from any thread
+	 */
+	boost::uint64_t dropped_packets() const
+	{
+		return __atomic_load_n(&droppedPackets_, __ATOMIC_RELAXED);
+	}
+
+	boost::uint64_t dropped_bytes() const
+	{
+		return __atomic_load_n(&droppedBytes_, __ATOMIC_RELAXED);
+	}
+
+	/*
+	 * The number of packets written
+	 */
+	boost::uint64_t packets() const
+	{
+		return is_open() ? __atomic_load_n(&header_->packets, __ATOMIC_RELAXED) : 0;
+	}
+
+private:
+	/*
+	 * Whether the segment called name is a ring whose writer has
+	 * exited without removing it
+	 */
+	static bool is_stale(const std::string& name)
+	{
+		int fd = shm_open(name.c_str(), O_RDONLY, 0);
+		if (fd < 0)
+			return false;
+
+		struct stat status;
+		void* address = MAP_FAILED;
+		if (fstat(fd, &status) == 0 && size_t(status.st_size) >= sizeof(ShmRingHeader))
+			address = mmap(NULL, sizeof(ShmRingHeader), PROT_READ, MAP_SHARED, fd, 0);
+		::close(fd);
+		if (address == MAP_FAILED)
+			return false;
+
+		const ShmRingHeader* header = static_cast<const ShmRingHeader*>(address);
+		pid_t writer = header->writer;
+		bool ring = __atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) == SHM_RING_MAGIC && writer != 0;
+		munmap(address, sizeof(ShmRingHeader));
+
+		return ring && kill(writer, 0) != 0 && errno == ESRCH;
+	}
+
+	boost::uint64_t droppedPackets_;
+	boost::uint64_t droppedBytes_;
+};
+
+/*
+ * Maps a ring and reads the packets written to it from the
+ * time it was opened on.  The only thing a reader changes in
+ * the segment is the count of waiters, but that means it must
+ * be able to write to it
+ */
+class ShmRingReader : public ShmRingSegment
+{
+public:
+	ShmRingReader() :
+		position_(0),
+		next_(0),
+		sequence_(0),
+		lost_(0)
+	{}
+
+	/*
+	 * Map the segment called name.  Returns false and sets errno
+	 * if it doesn't exist or isn't a ring
+	 */
+	bool open(const std::string& name)
+	{
+		close();
+
+		int fd = shm_open(name.c_str(), O_RDWR, 0);
+		if (fd < 0)
+			return false;
+
+		struct stat status;
+		if (fstat(fd, &status) != 0 || size_t(status.st_size) < sizeof(ShmRingHeader))
+		{
+			::close(fd);
+			errno = EINVAL;
+			return false;
+		}
+
+		if (!map(fd, status.st_size, PROT_READ | PROT_WRITE))
+			return false;
+
+		if (__atomic_load_n(&header_->magic, __ATOMIC_ACQUIRE) != SHM_RING_MAGIC || header_->version != SHM_RING_VERSION ||
+			header_->capacity + sizeof(ShmRingHeader) > size_)
+		{
+			unmap();
+			errno = EINVAL;
+			return false;
+		}
+
+		position_ = __atomic_load_n(&header_->head, __ATOMIC_ACQUIRE);
+		next_ = __atomic_load_n(&header_->packets, __ATOMIC_ACQUIRE);
+		lost_ = 0;
+		name_ = name;
+		return true;
+	}
+
+	void close()
+	{
+		unmap();
+		name_.clear();
+	}
+
+	/*
+	 * Copy the next packet into data.  Returns false if there
+	 * is no new packet yet
+	 */
+	bool read(std::vector<char>& data)
+	{
+		while (is_open())
+		{
+			boost::uint64_t head = __atomic_load_n(&header_->head, __ATOMIC_ACQUIRE);
+			if (position_ == head)
+				return false;
+
+			// Too far behind: the oldest record still intact can't be
+			// found, so start over at the newest
+			if (head - position_ > header_->capacity)
+			{
+				position_ = head;
+				continue;
+			}
+
+			ShmRecordHeader record;
+			copy_out(position_, reinterpret_cast<char*>(&record), sizeof(record));
+
+			bool valid = record.length <= header_->capacity && shm_record_size(record.length) <= head - position_;
+			if (valid)
+			{
+				data.resize(record.length);
+				if (record.length)
+					copy_out(position_ + sizeof(record), &data[0], record.length);
+			}
+
+			// If the writer claimed any of this record's space while it
+			// was being copied, the copy may be torn
+			__atomic_thread_fence(__ATOMIC_ACQUIRE);
+			boost::uint64_t reserved = __atomic_load_n(&header_->reserved, __ATOMIC_RELAXED);
+			if (!valid || reserved > position_ + header_->capacity)
+			{
+				position_ = __atomic_load_n(&header_->head, __ATOMIC_ACQUIRE);
+				continue;
+			}
+
+			lost_ += record.sequence - next_;
+			next_ = record.sequence + 1;
+			sequence_ = record.sequence;
+			position_ += shm_record_size(record.length);
+			return true;
+		}
+
+		return false;
+	}
+
+	/*
+	 * Wait up to timeout milliseconds for a new packet.  Returns
+	 * whether there is one
+	 */
+	bool wait(unsigned long timeout)
+	{
+		if (!is_open())
+			return false;
+
+		struct timespec delay;
+		delay.tv_sec = timeout / 1000;
+		delay.tv_nsec = (timeout % 1000) * 1000000;
+
+		__atomic_add_fetch(&header_->waiters, 1, __ATOMIC_SEQ_CST);
+		boost::uint32_t wakeups = __atomic_load_n(&header_->wakeups, __ATOMIC_SEQ_CST);
+		if (__atomic_load_n(&header_->head, __ATOMIC_ACQUIRE) == position_)
+			futex(&header_->wakeups, FUTEX_WAIT, wakeups, &delay);
+		__atomic_sub_fetch(&header_->waiters, 1, __ATOMIC_SEQ_CST);
+
+		return __atomic_load_n(&header_->head, __ATOMIC_ACQUIRE) != position_;
+	}
+
+	/*
+	 * The sequence number of the last packet read
+	 */
+	boost::uint64_t sequence() const
+	{
+		return sequence_;
+	}
+
+	/*
+	 * The number of packets overwritten before they were read
+	 */
+	boost::uint64_t lost() const
+	{
+		return lost_;
+	}
+
+private:
+	boost::uint64_t position_;
+	boost::uint64_t next_;
+	boost::uint64_t sequence_;
+	boost::uint64_t lost_;
+};
+
+#endif /* SHMRING_H_ */
@@ -0,0 +1,161 @@
+/*
+ * This file is protected by Copyright. Please refer to the COPYRIGHT file distributed with this 
+ * source distribution.
+ * 
+ * This file is part of REDHAWK Basic Components sinksocket.
+ * 
+ * REDHAWK Basic Components sinksocket is free software: you can redistribute it and/or modify it under the terms of 
+ * the GNU Lesser General Public License as published by the Free Software Foundation, either 
+ * version 3 of the License, or (at your option) any later version.
+ * 
+ * REDHAWK Basic Components sinksocket is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; 
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR 
+ * PURPOSE.  See the GNU Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public License along with this 
+ * program.  If not, see http://www.gnu.org/licenses/.
+ */
+
+#ifndef SOCKETOPTIONS_H_
+#define SOCKETOPTIONS_H_
+
+#include <iostream>
+#include <string>
+#include <boost/asio.hpp>
+#include <netinet/in.h>
+#include <netinet/ip.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include "UnixProtocol.h"
+
+#ifndef TCP_CONGESTION
+#define TCP_CONGESTION 13
+#endif
+
+#ifndef TCP_NOTSENT_LOWAT
+#define TCP_NOTSENT_LOWAT 25
+#endif
+
+/*
+ * Socket options applied to every socket of a connection:
+ * client sockets, accepted server sessions and datagram
+ * sockets, whether TCP, UDP or Unix domain.  Zero or empty values leave the kernel default
+ * alone.
+ */
+struct SocketOptions
+{
+	SocketOptions() :
+		sendBufferSize(0),
+		noDelay(false),
+		cork(false),
+		notSentLowat(0),
+		priority(0),
+		dscp(0),
+		zeroCopyThreshold(0),
+		udpGso(false)
+	{}
+
+	unsigned long sendBufferSize;
+	bool noDelay;
+	bool cork;
+	unsigned long notSentLowat;
+	unsigned long priority;
+	unsigned short dscp;
+	std::string congestion;
+
+	// Not a socket option as such: TCP sockets send packets of
+	// at least this many bytes with MSG_ZEROCOPY.  See ZeroCopy.h
+	size_t zeroCopyThreshold;
+
+	// Nor is this: UDP sockets hand the kernel runs of equal
+	// sized datagrams to split up itself.  See BoostUdpClient.h
+	bool udpGso;
+
+	void apply(boost::asio::ip::tcp::socket& socket) const
+	{
+		int fd = socket.native_handle();
+		boost::system::error_code ec;
+
+		applyCommon(fd, socket.local_endpoint(ec).address().is_v6());
+
+		if (noDelay)
+			set(fd, IPPROTO_TCP, TCP_NODELAY, 1, "TCP_NODELAY");
+		if (cork)
+			set(fd, IPPROTO_TCP, TCP_CORK, 1, "TCP_CORK");
+		if (notSentLowat)
+			set(fd, IPPROTO_TCP, TCP_NOTSENT_LOWAT, notSentLowat, "TCP_NOTSENT_LOWAT");
+		if (!congestion.empty())
+		{
+			if (setsockopt(fd, IPPROTO_TCP, TCP_CONGESTION, congestion.c_str(), congestion.size()) != 0)
+				std::cerr<<"ERROR unable to set TCP_CONGESTION to "<<congestion<<std::endl;
+		}
+	}
+
+	/*
+	 * Datagram sockets only take the options that aren't
+	 * specific to TCP
+	 */
+	void apply(boost::asio::ip::udp::socket& socket, bool v6) const
+	{
+		applyCommon(socket.native_handle(), v6);
+	}
+
+	/*
+	 * Unix domain sockets never reach the network, so only the
+	 * buffer size and priority apply
+	 */
+	void apply(unix_protocol::socket& socket) const
+	{
+		int fd = socket.native_handle();
+
+		if (sendBufferSize)
+			set(fd, SOL_SOCKET, SO_SNDBUF, sendBufferSize, "SO_SNDBUF");
+		if (priority)
+			set(fd, SOL_SOCKET, SO_PRIORITY, priority, "SO_PRIORITY");
+	}
+
+	/*
+	 * With TCP_CORK, push out the partial segment left at the
+	 * end of a burst instead of holding it back
+	 */
+	void flush(boost::asio::ip::tcp::socket& socket) const
+	{
+		if (cork && socket.is_open())
+		{
+			int fd = socket.native_handle();
+			set(fd, IPPROTO_TCP, TCP_CORK, 0, "TCP_CORK");
+			set(fd, IPPROTO_TCP, TCP_CORK, 1, "TCP_CORK");
+		}
+	}
+
+	void flush(unix_protocol::socket&) const
+	{
+	}
+
+private:
+	void applyCommon(int fd, bool v6) const
+	{
+		if (sendBufferSize)
+			set(fd, SOL_SOCKET, SO_SNDBUF, sendBufferSize, "SO_SNDBUF");
+		if (dscp)
+		{
+			if (v6)
+				set(fd, IPPROTO_IPV6, IPV6_TCLASS, dscp << 2, "IPV6_TCLASS");
+			else
+				set(fd, IPPROTO_IP, IP_TOS, dscp << 2, "IP_TOS");
+		}
+		// Setting the TOS also resets the priority, so this has to
+		// come after it
+		if (priority)
+			set(fd, SOL_SOCKET, SO_PRIORITY, priority, "SO_PRIORITY");
+	}
+
+	static void set(int fd, int level, int option, int value, const char* name)
+	{
+		if (setsockopt(fd, level, option, &value, sizeof(value)) != 0)
+			std::cerr<<"ERROR unable to set "<<name<<" to "<<value<<std::endl;
+	}
+};
+
+#endif /* SOCKETOPTIONS_H_ */
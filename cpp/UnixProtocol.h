@@ -0,0 +1,148 @@
+/*
+ * This file is protected by Copyright. Please refer to the COPYRIGHT file distributed with this 
+ * source distribution.
+ * 
+ * This file is part of REDHAWK Basic Components sinksocket.
+ * 
+ * REDHAWK Basic Components sinksocket is free software: you can redistribute it and/or modify it under the terms of 
+ * the GNU Lesser General Public License as published by the Free Software Foundation, either 
+ * version 3 of the License, or (at your option) any later version.
+ * 
+ * REDHAWK Basic Components sinksocket is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; 
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR 
+ * PURPOSE.  See the GNU Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public License along with this 
+ * program.  If not, see http://www.gnu.org/licenses/.
+ */
+
+#ifndef UNIXPROTOCOL_H_
+#define UNIXPROTOCOL_H_
+
+#include <cerrno>
+#include <string>
+#include <boost/asio.hpp>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+ * A Unix domain socket protocol for asio that is either a byte
+ * stream or a sequenced packet socket, which keeps the boundary
+ * of every packet written.  Both kinds use the stream socket
+ * and acceptor classes, so they can be handled just like TCP.
+ */
+class unix_protocol
+{
+public:
+	typedef boost::asio::local::basic_endpoint<unix_protocol> endpoint;
+	typedef boost::asio::basic_stream_socket<unix_protocol> socket;
+	typedef boost::asio::basic_socket_acceptor<unix_protocol> acceptor;
+
+	// An endpoint only carries the address, so this is what it
+	// reports as its protocol; open sockets with stream() or
+	// seqpacket() instead
+	unix_protocol() :
+		type_(SOCK_STREAM)
+	{}
+
+	static unix_protocol stream()
+	{
+		return unix_protocol(SOCK_STREAM);
+	}
+
+	static unix_protocol seqpacket()
+	{
+		return unix_protocol(SOCK_SEQPACKET);
+	}
+
+	int type() const
+	{
+		return type_;
+	}
+
+	int protocol() const
+	{
+		return 0;
+	}
+
+	int family() const
+	{
+		return AF_UNIX;
+	}
+
+	/*
+	 * The endpoint for a socket path.  A path starting with @
+	 * names a socket in the abstract namespace, which has no
+	 * file and goes away with the last socket using it
+	 */
+	static endpoint make_endpoint(const std::string& path)
+	{
+		if (!path.empty() && path[0] == '@')
+			return endpoint(std::string(1, '\0') + path.substr(1));
+
+		return endpoint(path);
+	}
+
+	friend bool operator==(const unix_protocol& p1, const unix_protocol& p2)
+	{
+		return p1.type_ == p2.type_;
+	}
+
+	friend bool operator!=(const unix_protocol& p1, const unix_protocol& p2)
+	{
+		return p1.type_ != p2.type_;
+	}
+
+private:
+	explicit unix_protocol(int type) :
+		type_(type)
+	{}
+
+	int type_;
+};
+
+/*
+ * Remove the file left behind by a socket bound to endpoint.
+ * Sockets in the abstract namespace and TCP sockets have none
+ */
+inline void unlink_socket_file(const unix_protocol::endpoint& endpoint)
+{
+	std::string path = endpoint.path();
+	if (!path.empty() && path[0] != '\0')
+		::unlink(path.c_str());
+}
+
+inline void unlink_socket_file(const boost::asio::ip::tcp::endpoint&)
+{
+}
+
+/*
+ * Remove the file left behind at endpoint by a socket that is
+ * no longer listening, so that it can be bound again.  Anything
+ * else at that path, a live server's socket included, is left
+ * alone for the bind to fail on
+ */
+inline void remove_stale_socket_file(const unix_protocol::endpoint& endpoint, const unix_protocol& protocol)
+{
+	std::string path = endpoint.path();
+	struct stat info;
+	if (path.empty() || path[0] == '\0' || ::lstat(path.c_str(), &info) != 0 || !S_ISSOCK(info.st_mode))
+		return;
+
+	int fd = ::socket(AF_UNIX, protocol.type(), 0);
+	if (fd < 0)
+		return;
+
+	bool stale = (::connect(fd, endpoint.data(), endpoint.size()) != 0 && errno == ECONNREFUSED);
+	::close(fd);
+
+	if (stale)
+		::unlink(path.c_str());
+}
+
+inline void remove_stale_socket_file(const boost::asio::ip::tcp::endpoint&, const boost::asio::ip::tcp&)
+{
+}
+
+#endif /* UNIXPROTOCOL_H_ */
@@ -0,0 +1,194 @@
+/*
+ * This file is protected by Copyright. Please refer to the COPYRIGHT file distributed with this 
+ * source distribution.
+ * 
+ * This file is part of REDHAWK Basic Components sinksocket.
+ * 
+ * REDHAWK Basic Components sinksocket is free software: you can redistribute it and/or modify it under the terms of 
+ * the GNU Lesser General Public License as published by the Free Software Foundation, either 
+ * version 3 of the License, or (at your option) any later version.
+ * 
+ * REDHAWK Basic Components sinksocket is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; 
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR 
+ * PURPOSE.  See the GNU Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public License along with this 
+ * program.  If not, see http://www.gnu.org/licenses/.
+ */
+#ifndef VRTPACKET_H_
+#define VRTPACKET_H_
+
+#include "PacketTime.h"
+
+#include <boost/cstdint.hpp>
+#include <endian.h>
+#include <string>
+
+/*
+ * The VITA-49.0 packets sent by a connection with vrt framing.
+ * Each input packet goes out as one or more IF data packets with
+ * a stream ID and, when the input time stamp is valid, a UTC
+ * integer time stamp and a real time fractional time stamp in
+ * picoseconds.  IF context packets with the same stream ID give
+ * the sample rate and the data format.  Every word is big
+ * endian, samples included.
+ */
+
+// Packet types, in the top four bits of the header
+const boost::uint32_t VRT_IF_DATA = 0x1;		// with a stream ID
+const boost::uint32_t VRT_IF_CONTEXT = 0x4;
+
+// Time stamp types, in the header
+const boost::uint32_t VRT_TSI_UTC = 0x1;
+const boost::uint32_t VRT_TSF_REAL_TIME = 0x2;
+
+// Indicators of the fields present in a context packet
+const boost::uint32_t VRT_CONTEXT_CHANGED = 0x80000000;
+const boost::uint32_t VRT_SAMPLE_RATE = 0x00200000;
+const boost::uint32_t VRT_DATA_FORMAT = 0x00008000;
+
+// Data item formats, in the data payload format field
+enum VrtItemFormat
+{
+	VRT_SIGNED_FIXED = 0x00,
+	VRT_UNSIGNED_FIXED = 0x10,
+	VRT_IEEE_HALF = 0x0d,
+	VRT_IEEE_SINGLE = 0x0e,
+	VRT_IEEE_DOUBLE = 0x0f
+};
+
+// A packet's size is counted in 16 bits of 32 bit words.  The
+// header has no class ID, so it is at most 5 words
+const size_t VRT_MAX_HEADER_WORDS = 5;
+const size_t VRT_MAX_CONTEXT_WORDS = VRT_MAX_HEADER_WORDS + 5;
+const size_t VRT_MAX_PACKET_WORDS = 65535;
+const size_t VRT_MAX_PAYLOAD_BYTES = (VRT_MAX_PACKET_WORDS - VRT_MAX_HEADER_WORDS) * 4;
+
+// The byte swap that makes samples big endian on this host
+#if __BYTE_ORDER == __BIG_ENDIAN
+const unsigned short VRT_BYTE_SWAP = 0;
+#else
+const unsigned short VRT_BYTE_SWAP = 1;
+#endif
+
+struct VrtTimestamp
+{
+	bool valid;
+	boost::uint32_t seconds;
+	boost::uint64_t picoseconds;
+};
+
+/*
+ * The time stamp of a sample offset seconds after the time given
+ * in whole and fractional seconds
+ */
+inline VrtTimestamp makeVrtTimestamp(bool valid, double wholeSeconds, double fractionalSeconds, double offset)
+{
+	VrtTimestamp time;
+	time.valid = valid;
+
+	boost::uint64_t seconds;
+	splitTime(wholeSeconds, fractionalSeconds, offset, seconds, time.picoseconds);
+	time.seconds = static_cast<boost::uint32_t>(seconds);
+	return time;
+}
+
+/*
+ * The 32 bit stream ID of a bulkio stream, the FNV-1a hash of its
+ * name, so that every run gives a stream the same ID
+ */
+inline boost::uint32_t vrtStreamId(const std::string& streamID)
+{
+	boost::uint32_t hash = 2166136261u;
+	for (std::string::const_iterator i = streamID.begin(); i != streamID.end(); ++i)
+	{
+		hash ^= static_cast<unsigned char>(*i);
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+/*
+ * The data item format of a struct module format character
+ */
+inline VrtItemFormat vrtItemFormat(char dataType)
+{
+	switch (dataType)
+	{
+	case 'e':
+		return VRT_IEEE_HALF;
+	case 'f':
+		return VRT_IEEE_SINGLE;
+	case 'd':
+		return VRT_IEEE_DOUBLE;
+	case 'B':
+	case 'H':
+	case 'I':
+		return VRT_UNSIGNED_FIXED;
+	default:
+		return VRT_SIGNED_FIXED;
+	}
+}
+
+/*
+ * The size of a header, in words
+ */
+inline size_t vrtHeaderWords(const VrtTimestamp& time)
+{
+	return time.valid ? VRT_MAX_HEADER_WORDS : 2;
+}
+
+/*
+ * Write the header of a packet of packetWords words, time stamps
+ * included if valid, and return the size of the header in words
+ */
+inline size_t encodeVrtHeader(boost::uint32_t* words, boost::uint32_t type, boost::uint32_t count, size_t packetWords, boost::uint32_t streamId, const VrtTimestamp& time)
+{
+	boost::uint32_t header = (type << 28) | ((count & 0xf) << 16) | (packetWords & 0xffff);
+	if (!time.valid)
+	{
+		words[0] = htobe32(header);
+		words[1] = htobe32(streamId);
+		return vrtHeaderWords(time);
+	}
+
+	header |= (VRT_TSI_UTC << 22) | (VRT_TSF_REAL_TIME << 20);
+	words[0] = htobe32(header);
+	words[1] = htobe32(streamId);
+	words[2] = htobe32(time.seconds);
+	words[3] = htobe32(static_cast<boost::uint32_t>(time.picoseconds >> 32));
+	words[4] = htobe32(static_cast<boost::uint32_t>(time.picoseconds));
+	return vrtHeaderWords(time);
+}
+
+/*
+ * Write an IF context packet with the sample rate, if known, and
+ * the format of samples of itemBits bits, and return its size in
+ * words
+ */
+inline size_t encodeVrtContext(boost::uint32_t* words, boost::uint32_t count, boost::uint32_t streamId, const VrtTimestamp& time, bool changed, double sampleRate, bool complex, VrtItemFormat format, size_t itemBits)
+{
+	size_t size = vrtHeaderWords(time) + 1;
+	boost::uint32_t indicators = VRT_DATA_FORMAT;
+	if (changed)
+		indicators |= VRT_CONTEXT_CHANGED;
+	if (sampleRate > 0)
+	{
+		// 64 bits with the radix point 20 bits from the right
+		boost::uint64_t rate = static_cast<boost::uint64_t>(sampleRate * 1048576.0 + 0.5);
+		indicators |= VRT_SAMPLE_RATE;
+		words[size++] = htobe32(static_cast<boost::uint32_t>(rate >> 32));
+		words[size++] = htobe32(static_cast<boost::uint32_t>(rate));
+	}
+
+	// Processing efficient packing, one item per field, no tags
+	boost::uint32_t payloadFormat = ((complex ? 1 : 0) << 29) | (format << 24) | ((itemBits - 1) << 6) | (itemBits - 1);
+	words[size++] = htobe32(payloadFormat);
+	words[size++] = 0;
+
+	encodeVrtHeader(words, VRT_IF_CONTEXT, count, size, streamId, time);
+	words[vrtHeaderWords(time)] = htobe32(indicators);
+	return size;
+}
+
+#endif /* VRTPACKET_H_ */
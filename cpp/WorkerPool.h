@@ -0,0 +1,151 @@
+/*
+ * This file is protected by Copyright. Please refer to the COPYRIGHT file distributed with this 
+ * source distribution.
+ * 
+ * This file is part of REDHAWK Basic Components sinksocket.
+ * 
+ * REDHAWK Basic Components sinksocket is free software: you can redistribute it and/or modify it under the terms of 
+ * the GNU Lesser General Public License as published by the Free Software Foundation, either 
+ * version 3 of the License, or (at your option) any later version.
+ * 
+ * REDHAWK Basic Components sinksocket is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; 
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR 
+ * PURPOSE.  See the GNU Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public License along with this 
+ * program.  If not, see http://www.gnu.org/licenses/.
+ */
+
+#ifndef WORKERPOOL_H_
+#define WORKERPOOL_H_
+
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <vector>
+
+/*
+ * A fixed set of threads that run the iterations of a loop
+ * in parallel.  The calling thread works on the loop too, and
+ * parallelFor() returns only once every iteration is done.
+ * With no threads, the loop simply runs on the caller.
+ */
+class WorkerPool
+{
+public:
+	WorkerPool() :
+		task_(NULL),
+		count_(0),
+		next_(0),
+		finished_(0),
+		stop_(false)
+	{}
+
+	~WorkerPool()
+	{
+		resize(0);
+	}
+
+	/*
+	 * Replace the worker threads.  Must not be called while
+	 * parallelFor() is running
+	 */
+	void resize(size_t threads)
+	{
+		{
+			boost::mutex::scoped_lock lock(lock_);
+			stop_ = true;
+		}
+
+		work_.notify_all();
+
+		for (size_t i=0; i!=threads_.size(); i++)
+		{
+			threads_[i]->join();
+			delete threads_[i];
+		}
+
+		threads_.clear();
+		stop_ = false;
+
+		for (size_t i=0; i!=threads; i++)
+			threads_.push_back(new boost::thread(boost::bind(&WorkerPool::run, this)));
+	}
+
+	size_t size() const
+	{
+		return threads_.size();
+	}
+
+	/*
+	 * Call task(i) for every i in [0, count)
+	 */
+	void parallelFor(size_t count, const boost::function<void (size_t)>& task)
+	{
+		if (threads_.size() == 0 || count < 2)
+		{
+			for (size_t i=0; i!=count; i++)
+				task(i);
+			return;
+		}
+
+		boost::mutex::scoped_lock lock(lock_);
+		task_ = &task;
+		count_ = count;
+		next_ = 0;
+		finished_ = 0;
+		work_.notify_all();
+
+		while (next_ < count_)
+		{
+			size_t i = next_++;
+			lock.unlock();
+			task(i);
+			lock.lock();
+			++finished_;
+		}
+
+		while (finished_ < count_)
+			done_.wait(lock);
+
+		task_ = NULL;
+	}
+
+private:
+	void run()
+	{
+		boost::mutex::scoped_lock lock(lock_);
+
+		while (true)
+		{
+			while (!stop_ && (task_ == NULL || next_ >= count_))
+				work_.wait(lock);
+
+			if (stop_)
+				return;
+
+			size_t i = next_++;
+			const boost::function<void (size_t)>* task = task_;
+			lock.unlock();
+			(*task)(i);
+			lock.lock();
+
+			if (++finished_ == count_)
+				done_.notify_all();
+		}
+	}
+
+	boost::mutex lock_;
+	boost::condition_variable work_;
+	boost::condition_variable done_;
+	const boost::function<void (size_t)>* task_;
+	size_t count_;
+	size_t next_;
+	size_t finished_;
+	bool stop_;
+	std::vector<boost::thread*> threads_;
+};
+
+#endif /* WORKERPOOL_H_ */
@@ -0,0 +1,510 @@
+/*
+ * This file is protected by Copyright. Please refer to the COPYRIGHT file distributed with this 
+ * source distribution.
+ * 
+ * This file is part of REDHAWK Basic Components sinksocket.
+ * 
+ * REDHAWK Basic Components sinksocket is free software: you can redistribute it and/or modify it under the terms of 
+ * the GNU Lesser General Public License as published by the Free Software Foundation, either 
+ * version 3 of the License, or (at your option) any later version.
+ * 
+ * REDHAWK Basic Components sinksocket is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; 
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR 
+ * PURPOSE.  See the GNU Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public License along with this 
+ * program.  If not, see http://www.gnu.org/licenses/.
+ */
+
+#ifndef ZEROCOPY_H_
+#define ZEROCOPY_H_
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <deque>
+#include <vector>
+#include <boost/asio.hpp>
+#include <boost/atomic.hpp>
+#include <boost/bind.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+#include <linux/errqueue.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "SharedBuffer.h"
+#include "UnixProtocol.h"
+
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY 60
+#endif
+
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY 0x4000000
+#endif
+
+#ifndef SO_EE_ORIGIN_ZEROCOPY
+#define SO_EE_ORIGIN_ZEROCOPY 5
+#endif
+
+#ifndef SO_EE_CODE_ZEROCOPY_COPIED
+#define SO_EE_CODE_ZEROCOPY_COPIED 1
+#endif
+
+struct ZeroCopyCounts
+{
+	ZeroCopyCounts() :
+		sends(0),
+		copied(0)
+	{}
+
+	boost::uint64_t sends;		// send calls made with MSG_ZEROCOPY
+	boost::uint64_t copied;		// of those, the ones the kernel copied anyway
+};
+
+/*
+ * Zero copy counts that a server's sessions share and that may
+ * be read from any thread
+ */
+struct ZeroCopyCounters
+{
+	ZeroCopyCounters() :
+		sends(0),
+		copied(0)
+	{}
+
+	ZeroCopyCounts load() const
+	{
+		ZeroCopyCounts counts;
+		counts.sends = sends.load(boost::memory_order_relaxed);
+		counts.copied = copied.load(boost::memory_order_relaxed);
+		return counts;
+	}
+
+	boost::atomic<boost::uint64_t> sends;
+	boost::atomic<boost::uint64_t> copied;
+};
+
+class ZeroCopyTracker;
+
+/*
+ * Writes still pinned when their socket was closed.  The kernel
+ * goes on sending a closed socket's data from the pinned pages,
+ * so each socket is kept open, shut down, on a descriptor of its
+ * own until the kernel reports its writes finished.  A peer that
+ * stops reading could hold them forever, so after
+ * ORPHAN_TIMEOUT_MS the socket is reset, which drops whatever
+ * it hadn't sent, and the buffers are released another
+ * ORPHAN_TIMEOUT_MS later.  One thread looks after them all
+ */
+class ZeroCopyOrphans
+{
+public:
+	static const long ORPHAN_TIMEOUT_MS = 10000;
+
+	static ZeroCopyOrphans& instance()
+	{
+		// Never destroyed, since the thread may outlive static
+		// destruction
+		static ZeroCopyOrphans* orphans = new ZeroCopyOrphans;
+		return *orphans;
+	}
+
+	/*
+	 * Take over the pinned writes of a tracker, along with the
+	 * descriptor of its shut down socket, or -1 if that was
+	 * already closed
+	 */
+	void adopt(const boost::shared_ptr<ZeroCopyTracker>& tracker, int fd);
+
+	/*
+	 * The number of sockets still waiting
+	 */
+	size_t size()
+	{
+		boost::mutex::scoped_lock lock(lock_);
+		return orphans_.size();
+	}
+
+private:
+	struct Orphan
+	{
+		boost::shared_ptr<ZeroCopyTracker> tracker;
+		int fd;
+		boost::posix_time::ptime deadline;
+	};
+
+	ZeroCopyOrphans() :
+		thread_(NULL)
+	{}
+
+	static boost::posix_time::ptime now()
+	{
+		return boost::posix_time::microsec_clock::universal_time();
+	}
+
+	void run();
+
+	boost::mutex lock_;
+	boost::condition_variable wakeup_;
+	std::deque<Orphan> orphans_;
+	boost::thread* thread_;
+};
+
+/*
+ * Keeps the buffers sent with MSG_ZEROCOPY alive until the
+ * kernel is done with them.  The kernel numbers every
+ * successful zero copy send call on a socket, starting at 0,
+ * and reports ranges of finished calls on the socket's error
+ * queue.  Every write pins its buffers under the numbers of
+ * the send calls it takes, and they are released once all of
+ * those calls are reported finished.  Not thread safe; the
+ * owner calls it with its write lock held
+ */
+class ZeroCopyTracker
+{
+public:
+	ZeroCopyTracker(const boost::shared_ptr<ZeroCopyCounters>& counters) :
+		counters_(counters),
+		enabled_(false),
+		nextId_(0),
+		closedFd_(-1)
+	{}
+
+	~ZeroCopyTracker()
+	{
+		clear();
+	}
+
+	/*
+	 * Turn on SO_ZEROCOPY for a newly connected socket.  Returns
+	 * whether the socket supports it
+	 */
+	bool enable(boost::asio::ip::tcp::socket& socket)
+	{
+		int on = 1;
+		clear();
+		enabled_ = setsockopt(socket.native_handle(), SOL_SOCKET, SO_ZEROCOPY, &on, sizeof(on)) == 0;
+		if (!enabled_)
+			std::cerr<<"WARN unable to set SO_ZEROCOPY, sending with copies: "<<strerror(errno)<<std::endl;
+		return enabled_;
+	}
+
+	bool enable(unix_protocol::socket&)
+	{
+		clear();
+		enabled_ = false;
+		return false;
+	}
+
+	bool enabled() const
+	{
+		return enabled_;
+	}
+
+	/*
+	 * Pin the buffers of a write about to start.  Any send calls
+	 * finished before the write completes belong to it
+	 */
+	void startWrite(const std::vector<SharedBuffer>& buffers)
+	{
+		pinned_.push_back(Pinned());
+		pinned_.back().first = nextId_;
+		pinned_.back().buffers = buffers;
+	}
+
+	/*
+	 * The write started last is done, after sends zero copy
+	 * send calls
+	 */
+	void writeComplete(boost::uint32_t sends)
+	{
+		// Cleared while the write was going
+		if (pinned_.empty() || !pinned_.back().writing)
+			return;
+
+		pinned_.back().writing = false;
+		pinned_.back().end = pinned_.back().first + sends;
+		nextId_ = pinned_.back().end;
+		release();
+	}
+
+	/*
+	 * Read every completion waiting on the socket's error queue
+	 * and release the buffers that are no longer needed
+	 */
+	void drain(int fd)
+	{
+		char control[256];
+		struct msghdr msg;
+
+		while (true)
+		{
+			memset(&msg, 0, sizeof(msg));
+			msg.msg_control = control;
+			msg.msg_controllen = sizeof(control);
+			if (recvmsg(fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0)
+				break;
+
+			for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+			{
+				if (!(cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR) &&
+					!(cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR))
+					continue;
+
+				struct sock_extended_err error;
+				memcpy(&error, CMSG_DATA(cmsg), sizeof(error));
+				if (error.ee_errno == 0 && error.ee_origin == SO_EE_ORIGIN_ZEROCOPY)
+					complete(error.ee_info, error.ee_data, error.ee_code & SO_EE_CODE_ZEROCOPY_COPIED);
+			}
+		}
+
+		release();
+	}
+
+	/*
+	 * Whether any buffers are waiting on the kernel
+	 */
+	bool pinned() const
+	{
+		return !pinned_.empty();
+	}
+
+	/*
+	 * Call just before closing the socket.  If the kernel still
+	 * has buffers pinned, the socket is shut down but kept open on
+	 * a duplicate descriptor, so that its completions can still be
+	 * read once it is closed
+	 */
+	void closing(int fd)
+	{
+		if (pinned_.empty() || closedFd_ >= 0)
+			return;
+
+		closedFd_ = dup(fd);
+		if (closedFd_ >= 0)
+			shutdown(closedFd_, SHUT_RDWR);
+	}
+
+	/*
+	 * Forget the socket.  Buffers still pinned are handed to
+	 * ZeroCopyOrphans, which holds on to them until the kernel is
+	 * done with them, since it may still be sending from them
+	 * after the socket is closed
+	 */
+	void clear()
+	{
+		if (!pinned_.empty())
+		{
+			boost::shared_ptr<ZeroCopyTracker> orphan(new ZeroCopyTracker(counters_));
+			orphan->pinned_.swap(pinned_);
+			ZeroCopyOrphans::instance().adopt(orphan, closedFd_);
+		}
+		else if (closedFd_ >= 0)
+			::close(closedFd_);
+
+		closedFd_ = -1;
+		nextId_ = 0;
+	}
+
+	ZeroCopyCounters& counters()
+	{
+		return *counters_;
+	}
+
+private:
+	friend class ZeroCopyOrphans;
+
+	struct Pinned
+	{
+		Pinned() :
+			first(0),
+			end(0),
+			finished(0),
+			writing(true)
+		{}
+
+		boost::uint32_t first;
+		boost::uint32_t end;
+		boost::uint32_t finished;
+		bool writing;
+		std::vector<SharedBuffer> buffers;
+	};
+
+	/*
+	 * Count the send calls from first to last, inclusive, as
+	 * finished.  Numbers wrap around, so everything is measured
+	 * from the oldest pinned write
+	 */
+	void complete(boost::uint32_t first, boost::uint32_t last, bool copied)
+	{
+		if (copied)
+			counters_->copied.fetch_add(boost::uint32_t(last - first) + 1, boost::memory_order_relaxed);
+
+		if (pinned_.empty())
+			return;
+
+		boost::uint32_t base = pinned_.front().first;
+		boost::uint64_t from = boost::uint32_t(first - base);
+		boost::uint64_t to = boost::uint64_t(boost::uint32_t(last - base)) + 1;
+
+		for (std::deque<Pinned>::iterator i = pinned_.begin(); i != pinned_.end(); ++i)
+		{
+			boost::uint64_t start = boost::uint32_t(i->first - base);
+			boost::uint64_t end = i->writing ? to : start + boost::uint32_t(i->end - i->first);
+			if (std::max(from, start) < std::min(to, end))
+				i->finished += std::min(to, end) - std::max(from, start);
+		}
+	}
+
+	void release()
+	{
+		while (!pinned_.empty() && !pinned_.front().writing &&
+			pinned_.front().finished >= boost::uint32_t(pinned_.front().end - pinned_.front().first))
+			pinned_.pop_front();
+	}
+
+	boost::shared_ptr<ZeroCopyCounters> counters_;
+	bool enabled_;
+	boost::uint32_t nextId_;
+	std::deque<Pinned> pinned_;
+	int closedFd_;
+};
+
+inline void ZeroCopyOrphans::adopt(const boost::shared_ptr<ZeroCopyTracker>& tracker, int fd)
+{
+	boost::mutex::scoped_lock lock(lock_);
+	Orphan orphan;
+	orphan.tracker = tracker;
+	orphan.fd = fd;
+	orphan.deadline = now() + boost::posix_time::milliseconds(ORPHAN_TIMEOUT_MS);
+	orphans_.push_back(orphan);
+
+	if (!thread_)
+		thread_ = new boost::thread(boost::bind(&ZeroCopyOrphans::run, this));
+	wakeup_.notify_all();
+}
+
+inline void ZeroCopyOrphans::run()
+{
+	boost::mutex::scoped_lock lock(lock_);
+	while (true)
+	{
+		while (orphans_.empty())
+			wakeup_.wait(lock);
+
+		boost::posix_time::ptime time = now();
+		for (std::deque<Orphan>::iterator i = orphans_.begin(); i != orphans_.end();)
+		{
+			if (i->fd >= 0)
+				i->tracker->drain(i->fd);
+
+			if (!i->tracker->pinned())
+			{
+				if (i->fd >= 0)
+					::close(i->fd);
+				i = orphans_.erase(i);
+			}
+			else if (time < i->deadline)
+				++i;
+			else if (i->fd >= 0)
+			{
+				struct linger reset;
+				reset.l_onoff = 1;
+				reset.l_linger = 0;
+				setsockopt(i->fd, SOL_SOCKET, SO_LINGER, &reset, sizeof(reset));
+				::close(i->fd);
+				std::cerr<<"WARN zero copy sends unfinished after "<<ORPHAN_TIMEOUT_MS<<" ms, resetting the connection"<<std::endl;
+
+				i->fd = -1;
+				i->deadline = time + boost::posix_time::milliseconds(ORPHAN_TIMEOUT_MS);
+				++i;
+			}
+			else
+			{
+				i->tracker->pinned_.clear();
+				i = orphans_.erase(i);
+			}
+		}
+
+		wakeup_.timed_wait(lock, boost::posix_time::milliseconds(100));
+	}
+}
+
+/*
+ * Writes a whole buffer sequence with MSG_ZEROCOPY, like
+ * boost::asio::async_write, then calls handler(error, sends)
+ * with the number of zero copy send calls it took.  If the
+ * kernel runs out of memory to pin pages, that call is retried
+ * as an ordinary copy.  The sequence is consumed as it is sent
+ */
+template<typename Socket, typename Handler>
+class zero_copy_write_op
+{
+public:
+	zero_copy_write_op(Socket& socket, std::vector<boost::asio::const_buffer>& buffers, ZeroCopyCounters& counters, const Handler& handler) :
+		socket_(&socket),
+		buffers_(&buffers),
+		counters_(&counters),
+		handler_(handler),
+		sends_(0),
+		flags_(MSG_ZEROCOPY)
+	{}
+
+	void start()
+	{
+		socket_->async_send(*buffers_, flags_, *this);
+	}
+
+	void operator()(const boost::system::error_code& error, size_t bytes)
+	{
+		if (error == boost::asio::error::no_buffer_space && flags_)
+		{
+			counters_->sends.fetch_add(1, boost::memory_order_relaxed);
+			counters_->copied.fetch_add(1, boost::memory_order_relaxed);
+			flags_ = 0;
+			start();
+			return;
+		}
+
+		if (!error && flags_)
+		{
+			sends_++;
+			counters_->sends.fetch_add(1, boost::memory_order_relaxed);
+		}
+		flags_ = MSG_ZEROCOPY;
+
+		// Drop what was sent from the front of the sequence
+		std::vector<boost::asio::const_buffer>::iterator i = buffers_->begin();
+		while (i != buffers_->end() && bytes >= boost::asio::buffer_size(*i))
+			bytes -= boost::asio::buffer_size(*i++);
+		if (i != buffers_->end() && bytes)
+			*i = *i + bytes;
+		buffers_->erase(buffers_->begin(), i);
+
+		if (error || buffers_->empty())
+			handler_(error, sends_);
+		else
+			start();
+	}
+
+private:
+	Socket* socket_;
+	std::vector<boost::asio::const_buffer>* buffers_;
+	ZeroCopyCounters* counters_;
+	Handler handler_;
+	boost::uint32_t sends_;
+	int flags_;
+};
+
+template<typename Socket, typename Handler>
+void async_zero_copy_write(Socket& socket, std::vector<boost::asio::const_buffer>& buffers, ZeroCopyCounters& counters, const Handler& handler)
+{
+	zero_copy_write_op<Socket, Handler>(socket, buffers, counters, handler).start();
+}
+
+#endif /* ZEROCOPY_H_ */
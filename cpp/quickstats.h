@@ -19,9 +19,18 @@
 #ifndef QUICKSTATS_H_
 #define QUICKSTATS_H_
 
-#include <list>
-#include <sys/time.h>
+#include <algorithm>
+#include <time.h>
 
+/*
+ * Estimates throughput over a sliding window of roughly max_time
+ * seconds, max_size packets, or max_bytes bytes, whichever is
+ * smallest.  Packets are accumulated into a fixed ring of time
+ * buckets, so no memory is allocated after construction and each
+ * packet costs O(1) amortized.  When a packet or byte limit cuts
+ * into a bucket, the part of it that is still in the window is
+ * estimated assuming its packets were evenly spread over its time
+ */
 class QuickStats
 {
 public:
@@ -29,39 +38,132 @@ public:
 		maxSize(max_size),
 		maxTime(max_time),
 		maxBytes(max_bytes),
-		totalBytes(0)
+		bucketTime(max_time / NUM_BUCKETS),
+		head(0),
+		numBuckets(0),
+		totalBytes(0),
+		totalPackets(0)
 	{}
 
 	float newPacket(size_t pktSize)
 	{
-		timeval now;
-		gettimeofday ( &now,NULL);
-		totalBytes+=pktSize;
-		times.push_back(now);
-		packetSizes.push_back(pktSize);
-		if (times.size()>1)
-		{
-			timeval& then = times.front();
-			float delT = now.tv_sec - then.tv_sec+(now.tv_usec - then.tv_usec)/1000000.0;
-			//std::cout<<"QuickStats delT = "<<delT<<" totalBytes " <<totalBytes <<" times.size() = "<<times.size()<<std::endl;
-			if (delT > maxTime || times.size()>maxSize || totalBytes>maxBytes)
-			{
-				totalBytes-=packetSizes.front();
-				times.pop_front();
-				packetSizes.pop_front();
+		double now = monotonicNow();
+
+		// Start a new bucket when the newest one has covered its
+		// share of the window, evicting the oldest if the ring is full
+		if (numBuckets == 0 || now - buckets[head].start >= bucketTime) {
+			if (numBuckets == NUM_BUCKETS) {
+				popOldest();
 			}
-			return totalBytes/delT;
+
+			head = (head + 1) % NUM_BUCKETS;
+			buckets[head].start = now;
+			buckets[head].bytes = 0;
+			buckets[head].packets = 0;
+			++numBuckets;
 		}
-		else
+
+		buckets[head].bytes += pktSize;
+		++buckets[head].packets;
+		totalBytes += pktSize;
+		++totalPackets;
+
+		// Age out old buckets, always keeping the newest.  A bucket
+		// that only partly exceeds the packet or byte limit is
+		// trimmed instead, as if its oldest packets had been evicted
+		// one at a time, so that the window never collapses to the
+		// newest bucket at high rates
+		while (numBuckets > 1 && now - buckets[tail()].start > maxTime) {
+			popOldest();
+		}
+
+		while (totalPackets > maxSize || totalBytes > maxBytes) {
+			Bucket &oldest = buckets[tail()];
+			double excess = 0.0;
+
+			if (totalPackets > maxSize) {
+				excess = double(totalPackets - maxSize) / oldest.packets;
+			}
+
+			if (totalBytes > maxBytes && oldest.bytes > 0) {
+				excess = std::max(excess, double(totalBytes - maxBytes) / oldest.bytes);
+			}
+
+			if (excess >= 1.0 && numBuckets > 1) {
+				popOldest();
+			} else {
+				trimOldest(std::min(excess, 1.0), now);
+				break;
+			}
+		}
+
+		double delT = now - buckets[tail()].start;
+
+		if (delT > 0) {
+			return totalBytes / delT;
+		} else {
 			return 0.0;
+		}
 	}
 private:
+	struct Bucket {
+		double start;
+		unsigned long bytes;
+		size_t packets;
+	};
+
+	static const size_t NUM_BUCKETS = 64;
+
+	static double monotonicNow()
+	{
+		timespec now;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		return now.tv_sec + now.tv_nsec / 1000000000.0;
+	}
+
+	size_t tail() const
+	{
+		return (head + NUM_BUCKETS + 1 - numBuckets) % NUM_BUCKETS;
+	}
+
+	/*
+	 * Drop the given fraction of the oldest bucket's packets,
+	 * moving its start forward by the same fraction of the time
+	 * it covers
+	 */
+	void trimOldest(double fraction, double now)
+	{
+		Bucket &oldest = buckets[tail()];
+		double end = (numBuckets > 1) ? buckets[(tail() + 1) % NUM_BUCKETS].start : now;
+		unsigned long bytes = static_cast<unsigned long>(oldest.bytes * fraction + 0.5);
+		size_t packets = static_cast<size_t>(oldest.packets * fraction + 0.5);
+
+		bytes = std::min(bytes, oldest.bytes);
+		packets = std::min(packets, oldest.packets);
+		oldest.bytes -= bytes;
+		oldest.packets -= packets;
+		totalBytes -= bytes;
+		totalPackets -= packets;
+		oldest.start += (end - oldest.start) * fraction;
+	}
+
+	void popOldest()
+	{
+		const Bucket &oldest = buckets[tail()];
+		totalBytes -= oldest.bytes;
+		totalPackets -= oldest.packets;
+		--numBuckets;
+	}
+
 	const size_t maxSize;
 	const float maxTime;
 	const unsigned long maxBytes;
-	std::list<size_t> packetSizes;
-	std::list<timeval> times;
+	const double bucketTime;
+	Bucket buckets[NUM_BUCKETS];
+	size_t head;
+	size_t numBuckets;
 	unsigned long totalBytes;
+	size_t totalPackets;
 
 };
 
@@ -0,0 +1,412 @@
+/*
+ * This file is protected by Copyright. Please refer to the COPYRIGHT file distributed with this 
+ * source distribution.
+ * 
+ * This file is part of REDHAWK Basic Components sinksocket.
+ * 
+ * REDHAWK Basic Components sinksocket is free software: you can redistribute it and/or modify it under the terms of 
+ * the GNU Lesser General Public License as published by the Free Software Foundation, either 
+ * version 3 of the License, or (at your option) any later version.
+ * 
+ * REDHAWK Basic Components sinksocket is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; 
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR 
+ * PURPOSE.  See the GNU Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public License along with this 
+ * program.  If not, see http://www.gnu.org/licenses/.
+ */
+#include "sampleconvert.h"
+
+#include <math.h>
+#include <string.h>
+
+// Compilers older than these can't build the vector kernels
+// without enabling the instruction sets for the whole file
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define SAMPLECONVERT_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+/*
+ * Plain C++ versions, used for the tail of every buffer and on
+ * CPUs without any of the vector extensions below.  The
+ * comparisons are written so that NaN clamps to the low end,
+ * as the vector min and max instructions do
+ */
+template<typename T>
+void toIntScalar(const float* from, T* to, size_t count, float scale, float low, float high)
+{
+	for (size_t i=0; i!=count; i++)
+	{
+		float value = from[i]*scale;
+		value = value > low ? value : low;
+		value = value < high ? value : high;
+		to[i] = static_cast<T>(lrintf(value));
+	}
+}
+
+uint16_t toHalfScalar(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	uint16_t sign = (bits >> 16) & 0x8000;
+	uint32_t exponent = (bits >> 23) & 0xff;
+	uint32_t mantissa = bits & 0x7fffff;
+
+	// Infinity stays infinity and NaN is quieted
+	if (exponent==0xff)
+		return sign | 0x7c00 | (mantissa ? 0x200 | (mantissa >> 13) : 0);
+
+	int halfExponent = static_cast<int>(exponent) - 127 + 15;
+	if (halfExponent >= 0x1f)
+		return sign | 0x7c00;
+
+	// Too small to be normal, so shift the implicit one in and
+	// round to a subnormal or zero
+	if (halfExponent <= 0)
+	{
+		if (halfExponent < -10)
+			return sign;
+		mantissa |= 0x800000;
+		int shift = 14 - halfExponent;
+		uint32_t half = mantissa >> shift;
+		uint32_t rest = mantissa & ((1u << shift) - 1);
+		uint32_t halfway = 1u << (shift - 1);
+		if (rest > halfway || (rest == halfway && (half & 1)))
+			half++;
+		return sign | half;
+	}
+
+	// Rounding up may carry into the exponent, up to infinity
+	uint32_t half = (halfExponent << 10) | (mantissa >> 13);
+	uint32_t rest = mantissa & 0x1fff;
+	if (rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+		half++;
+	return sign | half;
+}
+
+size_t toInt16Scalar(const float* from, char* to, size_t count, float scale)
+{
+	int16_t* out = reinterpret_cast<int16_t*>(to);
+	toIntScalar(from, out, count, scale, -32768.0f, 32767.0f);
+	return count;
+}
+
+size_t toInt8Scalar(const float* from, char* to, size_t count, float scale)
+{
+	int8_t* out = reinterpret_cast<int8_t*>(to);
+	toIntScalar(from, out, count, scale, -128.0f, 127.0f);
+	return count;
+}
+
+size_t toHalfScalar(const float* from, char* to, size_t count, float scale)
+{
+	uint16_t* out = reinterpret_cast<uint16_t*>(to);
+	for (size_t i=0; i!=count; i++)
+		out[i] = toHalfScalar(from[i]*scale);
+	return count;
+}
+
+size_t toFloatScalar(const double* from, float* to, size_t count, double scale)
+{
+	for (size_t i=0; i!=count; i++)
+		to[i] = static_cast<float>(from[i]*scale);
+	return count;
+}
+
+#ifdef SAMPLECONVERT_X86
+
+/*
+ * The vector kernels convert whole registers and return how
+ * many samples they did, leaving the rest to the plain version
+ */
+__attribute__((target("sse2")))
+size_t toInt16SSE2(const float* from, char* to, size_t count, float scale)
+{
+	const __m128 factor = _mm_set1_ps(scale);
+	const __m128 low = _mm_set1_ps(-32768.0f);
+	const __m128 high = _mm_set1_ps(32767.0f);
+	size_t done=0;
+	while (done+8 <= count)
+	{
+		__m128 a = _mm_mul_ps(_mm_loadu_ps(from+done), factor);
+		__m128 b = _mm_mul_ps(_mm_loadu_ps(from+done+4), factor);
+		a = _mm_min_ps(_mm_max_ps(a, low), high);
+		b = _mm_min_ps(_mm_max_ps(b, low), high);
+		__m128i packed = _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(to+2*done), packed);
+		done+=8;
+	}
+	return done;
+}
+
+__attribute__((target("sse2")))
+size_t toInt8SSE2(const float* from, char* to, size_t count, float scale)
+{
+	const __m128 factor = _mm_set1_ps(scale);
+	const __m128 low = _mm_set1_ps(-128.0f);
+	const __m128 high = _mm_set1_ps(127.0f);
+	size_t done=0;
+	while (done+16 <= count)
+	{
+		__m128i words[4];
+		for (int i=0; i!=4; i++)
+		{
+			__m128 value = _mm_mul_ps(_mm_loadu_ps(from+done+4*i), factor);
+			words[i] = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(value, low), high));
+		}
+		__m128i packed = _mm_packs_epi16(_mm_packs_epi32(words[0], words[1]), _mm_packs_epi32(words[2], words[3]));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(to+done), packed);
+		done+=16;
+	}
+	return done;
+}
+
+__attribute__((target("sse2")))
+size_t toFloatSSE2(const double* from, float* to, size_t count, double scale)
+{
+	const __m128d factor = _mm_set1_pd(scale);
+	size_t done=0;
+	while (done+4 <= count)
+	{
+		__m128 low = _mm_cvtpd_ps(_mm_mul_pd(_mm_loadu_pd(from+done), factor));
+		__m128 high = _mm_cvtpd_ps(_mm_mul_pd(_mm_loadu_pd(from+done+2), factor));
+		_mm_storeu_ps(to+done, _mm_movelh_ps(low, high));
+		done+=4;
+	}
+	return done;
+}
+
+__attribute__((target("avx2")))
+size_t toInt16AVX2(const float* from, char* to, size_t count, float scale)
+{
+	const __m256 factor = _mm256_set1_ps(scale);
+	const __m256 low = _mm256_set1_ps(-32768.0f);
+	const __m256 high = _mm256_set1_ps(32767.0f);
+	size_t done=0;
+	while (done+16 <= count)
+	{
+		__m256 a = _mm256_mul_ps(_mm256_loadu_ps(from+done), factor);
+		__m256 b = _mm256_mul_ps(_mm256_loadu_ps(from+done+8), factor);
+		a = _mm256_min_ps(_mm256_max_ps(a, low), high);
+		b = _mm256_min_ps(_mm256_max_ps(b, low), high);
+
+		// Packing works within each 128 bit lane, so put the
+		// quarters back in order afterwards
+		__m256i packed = _mm256_packs_epi32(_mm256_cvtps_epi32(a), _mm256_cvtps_epi32(b));
+		packed = _mm256_permute4x64_epi64(packed, 0xd8);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(to+2*done), packed);
+		done+=16;
+	}
+	_mm256_zeroupper();
+	return done;
+}
+
+__attribute__((target("avx2")))
+size_t toInt8AVX2(const float* from, char* to, size_t count, float scale)
+{
+	const __m256 factor = _mm256_set1_ps(scale);
+	const __m256 low = _mm256_set1_ps(-128.0f);
+	const __m256 high = _mm256_set1_ps(127.0f);
+	const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+	size_t done=0;
+	while (done+32 <= count)
+	{
+		__m256i words[4];
+		for (int i=0; i!=4; i++)
+		{
+			__m256 value = _mm256_mul_ps(_mm256_loadu_ps(from+done+8*i), factor);
+			words[i] = _mm256_cvtps_epi32(_mm256_min_ps(_mm256_max_ps(value, low), high));
+		}
+		__m256i packed = _mm256_packs_epi16(_mm256_packs_epi32(words[0], words[1]), _mm256_packs_epi32(words[2], words[3]));
+		packed = _mm256_permutevar8x32_epi32(packed, order);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(to+done), packed);
+		done+=32;
+	}
+	_mm256_zeroupper();
+	return done;
+}
+
+__attribute__((target("avx")))
+size_t toFloatAVX(const double* from, float* to, size_t count, double scale)
+{
+	const __m256d factor = _mm256_set1_pd(scale);
+	size_t done=0;
+	while (done+4 <= count)
+	{
+		_mm_storeu_ps(to+done, _mm256_cvtpd_ps(_mm256_mul_pd(_mm256_loadu_pd(from+done), factor)));
+		done+=4;
+	}
+	_mm256_zeroupper();
+	return done;
+}
+
+__attribute__((target("avx,f16c")))
+size_t toHalfF16C(const float* from, char* to, size_t count, float scale)
+{
+	const __m256 factor = _mm256_set1_ps(scale);
+	size_t done=0;
+	while (done+8 <= count)
+	{
+		__m128i half = _mm256_cvtps_ph(_mm256_mul_ps(_mm256_loadu_ps(from+done), factor), _MM_FROUND_TO_NEAREST_INT);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(to+2*done), half);
+		done+=8;
+	}
+	_mm256_zeroupper();
+	return done;
+}
+
+#endif
+
+typedef size_t (*FloatKernel)(const float*, char*, size_t, float);
+typedef size_t (*DoubleKernel)(const double*, float*, size_t, double);
+
+struct Dispatch
+{
+	Dispatch() :
+		toInt16(toInt16Scalar),
+		toInt8(toInt8Scalar),
+		toHalf(toHalfScalar),
+		toFloat(toFloatScalar),
+		name("scalar")
+	{
+#ifdef SAMPLECONVERT_X86
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2"))
+		{
+			toInt16 = toInt16AVX2;
+			toInt8 = toInt8AVX2;
+			toFloat = toFloatAVX;
+			name = "avx2";
+		} else if (__builtin_cpu_supports("sse2"))
+		{
+			toInt16 = toInt16SSE2;
+			toInt8 = toInt8SSE2;
+			toFloat = toFloatSSE2;
+			name = "sse2";
+		}
+		// toHalfF16C works on 256 bit vectors, so it needs avx as well
+		if (__builtin_cpu_supports("avx") && __builtin_cpu_supports("f16c"))
+		{
+			toHalf = toHalfF16C;
+			name = (toInt16 == toInt16AVX2) ? "avx2,f16c" : "sse2,f16c";
+		}
+#endif
+	}
+
+	FloatKernel toInt16;
+	FloatKernel toInt8;
+	FloatKernel toHalf;
+	DoubleKernel toFloat;
+	const char* name;
+};
+
+// Chosen once, before main, according to what the CPU supports
+const Dispatch dispatch;
+
+/*
+ * Run a vector kernel, then the plain version on what's left
+ */
+void convertFloat(FloatKernel kernel, FloatKernel scalar, const float* from, char* to, size_t count, float scale, size_t size)
+{
+	size_t done = kernel(from, to, count, scale);
+	scalar(from+done, to+done*size, count-done, scale);
+}
+
+}
+
+SampleFormat parseSampleFormat(const std::string& name)
+{
+	if (name=="float")
+		return SAMPLES_FLOAT;
+	if (name=="int16")
+		return SAMPLES_INT16;
+	if (name=="int8")
+		return SAMPLES_INT8;
+	if (name=="fp16")
+		return SAMPLES_FP16;
+	return SAMPLES_NATIVE;
+}
+
+size_t sampleFormatSize(SampleFormat format)
+{
+	switch (format)
+	{
+	case SAMPLES_FLOAT:
+		return 4;
+	case SAMPLES_INT16:
+	case SAMPLES_FP16:
+		return 2;
+	case SAMPLES_INT8:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+char sampleFormatType(SampleFormat format)
+{
+	switch (format)
+	{
+	case SAMPLES_FLOAT:
+		return 'f';
+	case SAMPLES_INT16:
+		return 'h';
+	case SAMPLES_INT8:
+		return 'b';
+	case SAMPLES_FP16:
+		return 'e';
+	default:
+		return 0;
+	}
+}
+
+void convertSamples(const float* from, char* to, size_t count, SampleFormat format, float scale)
+{
+	switch (format)
+	{
+	case SAMPLES_INT16:
+		convertFloat(dispatch.toInt16, toInt16Scalar, from, to, count, scale, 2);
+		break;
+	case SAMPLES_INT8:
+		convertFloat(dispatch.toInt8, toInt8Scalar, from, to, count, scale, 1);
+		break;
+	case SAMPLES_FP16:
+		convertFloat(dispatch.toHalf, toHalfScalar, from, to, count, scale, 2);
+		break;
+	default:
+		memcpy(to, from, count*sizeof(float));
+		break;
+	}
+}
+
+void convertSamples(const double* from, char* to, size_t count, SampleFormat format, float scale)
+{
+	if (format==SAMPLES_FLOAT)
+	{
+		float* out = reinterpret_cast<float*>(to);
+		size_t done = dispatch.toFloat(from, out, count, scale);
+		toFloatScalar(from+done, out+done, count-done, scale);
+		return;
+	}
+
+	// Narrower formats go through float a block at a time, which
+	// keeps the intermediate in the cache
+	float block[1024];
+	size_t size = sampleFormatSize(format);
+	for (size_t done=0; done < count; )
+	{
+		size_t chunk = count-done < 1024 ? count-done : 1024;
+		size_t converted = dispatch.toFloat(from+done, block, chunk, scale);
+		toFloatScalar(from+done+converted, block+converted, chunk-converted, scale);
+		convertSamples(block, to+done*size, chunk, format, 1.0f);
+		done+=chunk;
+	}
+}
+
+const char* sampleConvertImplementation()
+{
+	return dispatch.name;
+}
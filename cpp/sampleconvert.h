@@ -0,0 +1,67 @@
+/*
+ * This file is protected by Copyright. Please refer to the COPYRIGHT file distributed with this 
+ * source distribution.
+ * 
+ * This file is part of REDHAWK Basic Components sinksocket.
+ * 
+ * REDHAWK Basic Components sinksocket is free software: you can redistribute it and/or modify it under the terms of 
+ * the GNU Lesser General Public License as published by the Free Software Foundation, either 
+ * version 3 of the License, or (at your option) any later version.
+ * 
+ * REDHAWK Basic Components sinksocket is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; 
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR 
+ * PURPOSE.  See the GNU Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public License along with this 
+ * program.  If not, see http://www.gnu.org/licenses/.
+ */
+#ifndef SAMPLECONVERT_H_
+#define SAMPLECONVERT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+/*
+ * The sample formats a connection may send from the float and
+ * double ports
+ */
+enum SampleFormat
+{
+	SAMPLES_NATIVE,
+	SAMPLES_FLOAT,
+	SAMPLES_INT16,
+	SAMPLES_INT8,
+	SAMPLES_FP16
+};
+
+/*
+ * The format named by a Connection's sample_format, or
+ * SAMPLES_NATIVE for a name it doesn't know
+ */
+SampleFormat parseSampleFormat(const std::string& name);
+
+/*
+ * The size of one sample, and its struct module format character
+ */
+size_t sampleFormatSize(SampleFormat format);
+char sampleFormatType(SampleFormat format);
+
+/*
+ * Multiply count samples by scale and convert them to format,
+ * reading from 'from' and writing to 'to', which must not
+ * overlap.  Integers are rounded to nearest, ties to even, and
+ * saturated, with NaN giving the most negative value; floats
+ * are rounded to nearest and overflow to infinity.  SSE2, AVX2
+ * or F16C instructions are used when the CPU supports them; the
+ * results are identical to the plain C++ version.
+ */
+void convertSamples(const float* from, char* to, size_t count, SampleFormat format, float scale);
+void convertSamples(const double* from, char* to, size_t count, SampleFormat format, float scale);
+
+/*
+ * The name of the conversion implementation chosen for this CPU
+ */
+const char* sampleConvertImplementation();
+
+#endif /* SAMPLECONVERT_H_ */
@@ -27,6 +27,9 @@
 
 #include "sinksocket.h"
 #include "vectorswap.h"
+#include <algorithm>
+#include <cstring>
+#include <set>
 #include <sstream>
 
 // Because the vector of internal connections must store pointers to avoid
@@ -38,6 +41,39 @@ bool operator==(const InternalConnection *lhs, const Connection_struct &rhs)
 	return (*lhs) == rhs;
 }
 
+/*
+ * Whether two connections agree on everything but their ports,
+ * and so can be combined into one
+ */
+static bool sameSettings(const Connection_struct &lhs, const Connection_struct &rhs)
+{
+	Connection_struct left = lhs;
+	Connection_struct right = rhs;
+
+	left.ports.clear();
+	left.byte_swap.clear();
+	right.ports.clear();
+	right.byte_swap.clear();
+
+	return left == right;
+}
+
+/*
+ * Whether a connection in the list of the same type and to the
+ * same address as connection, but with other settings, already
+ * uses port
+ */
+static bool portTaken(const std::vector<Connection_struct> &connections, const Connection_struct &connection, unsigned short port)
+{
+	for (std::vector<Connection_struct>::const_iterator i = connections.begin(); i != connections.end(); ++i) {
+		if (i->connection_type == connection.connection_type && i->ip_address == connection.ip_address && not sameSettings(*i, connection) && find(i->ports.begin(), i->ports.end(), port) != i->ports.end()) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
 PREPARE_LOGGING(sinksocket_i)
 
 sinksocket_i::sinksocket_i(const char *uuid, const char *label) :
@@ -45,14 +81,28 @@ sinksocket_i::sinksocket_i(const char *uuid, const char *label) :
 {
 	bytesPerSecTemp = 0;
 	bytes_per_sec = 0;
-	onlyByteSwaps = false;
 	performByteSwap = false;
+	performFraming = false;
+	performVrt = false;
+	performBatching = true;
+	statsThread = NULL;
+
+	for (size_t i = 0; i < NUM_PORT_TYPES; ++i) {
+		sendsNative[i] = true;
+	}
+
 	totalBytesTemp = 0;
 	total_bytes = 0;
 }
 
 sinksocket_i::~sinksocket_i()
 {
+	if (statsThread) {
+		statsThread->interrupt();
+		statsThread->join();
+		delete statsThread;
+	}
+
 	boost::recursive_mutex::scoped_lock lock(socketsLock_);
 
 	for (std::vector<InternalConnection *>::iterator i = internalConnections.begin(); i != internalConnections.end(); ++i) {
@@ -65,67 +115,455 @@ void sinksocket_i::constructor()
     /***********************************************************************************
      This is the RH constructor. All properties are properly initialized before this function is called
     ***********************************************************************************/
+	LOG_DEBUG(sinksocket_i, "Using " << byteSwapImplementation() << " byte swapping");
+
+	// Every server and client shares these threads, so they are
+	// only sized at startup
+	LOG_DEBUG(sinksocket_i, "Starting " << io_threads << " I/O threads" << (io_per_core ? ", one context per core" : ""));
+	ioPool.start(io_threads, io_per_core);
+
+	if (send_engine == "io_uring") {
+		if (sendEngine.start()) {
+			LOG_DEBUG(sinksocket_i, "Sending through io_uring");
+		} else {
+			LOG_WARN(sinksocket_i, "Unable to start io_uring, sending with asio instead");
+		}
+	}
+
 	ConnectionsChanged(NULL,&Connections); // apply initial property configuration
 	addPropertyChangeListener("Connections", this, &sinksocket_i::ConnectionsChanged);
+
+	worker_threadsChanged(NULL, &worker_threads);
+	addPropertyChangeListener("worker_threads", this, &sinksocket_i::worker_threadsChanged);
+
+	statsThread = new boost::thread(&sinksocket_i::publishStatistics, this);
 }
 
-template<typename T, typename U>
-void sinksocket_i::createByteSwappedVector(const std::vector<T, U> &original, unsigned short byteSwap) {
-	unsigned int numSwap = byteSwap;
-	size_t dataSize = sizeof(T);
+/*
+ * Periodically gather the counters kept by the data path into
+ * the ConnectionStats, bytes_per_sec, and total_bytes properties,
+ * so that the data path never has to build them itself
+ */
+void sinksocket_i::publishStatistics()
+{
+	try {
+		while (true) {
+			// Never spin, even if the period is set to zero
+			boost::this_thread::sleep(boost::posix_time::microseconds(static_cast<long>(std::max(stats_period, 0.01f) * 1000000)));
+
+			boost::mutex::scoped_lock lock(statsLock_);
+
+			// Keep a list of stats to populate the ConnectionStats property
+			std::vector<ConnectionStat_struct> stats;
+			std::vector<ConnectionStat_struct> returned;
 
-	// If 1 is requested, use the word size associated with the data
-	if (numSwap == 1) {
-		numSwap = dataSize;
+			for (std::vector<InternalConnection *>::iterator i = internalConnections.begin(); i != internalConnections.end(); ++i) {
+				returned = (*i)->getStatistics();
+
+				stats.insert(stats.end(), returned.begin(), returned.end());
+			}
+
+			bytesPerSecTemp = 0;
+			totalBytesTemp = 0;
+
+			for (std::vector<ConnectionStat_struct>::const_iterator i = stats.begin(); i != stats.end(); ++i) {
+				bytesPerSecTemp += i->bytes_per_second;
+				totalBytesTemp += i->bytes_sent;
+			}
+
+			bytes_per_sec = bytesPerSecTemp;
+			ConnectionStats = stats;
+			total_bytes = totalBytesTemp;
+		}
+	} catch (boost::thread_interrupted &) {
 	}
+}
 
-	size_t numBytes = original.size() * dataSize;
-	size_t oldLeftoverSize = leftovers[typeid(T).name()][byteSwap].size();
+/*
+ * Build the numSwap variant of the original data, swapping
+ * straight from the original into a pooled buffer.  Words that
+ * straddle packets are completed using the leftovers from the
+ * previous packet of the same type.  Different numSwap values
+ * may be built in parallel
+ */
+void sinksocket_i::createByteSwappedVector(const SharedBuffer &original, size_t dataSize, SwapVariants &variants, unsigned short numSwap) {
+	if (numSwap != dataSize) {
+		LOG_WARN(sinksocket_i, "Data size of " << dataSize << " is not equal to byte swap size  of " << numSwap <<".");
+	}
+
+	std::vector<char> &leftover = variants.leftovers[numSwap];
+	const char *data = original.data();
+	size_t numBytes = original.size();
+	size_t oldLeftoverSize = leftover.size();
 	size_t totalSize = numBytes + oldLeftoverSize;
-	size_t newLeftoverSize;
 
-	// Create the vector to hold the swapped data
-	std::vector<char> newData;
+	// Make sure to send an exact multiple of numSwap
+	size_t newLeftoverSize = totalSize % numSwap;
+	size_t outSize = totalSize - newLeftoverSize;
+
+	if (newLeftoverSize != 0 || oldLeftoverSize != 0) {
+		LOG_WARN(sinksocket_i, "Byte swapping and packet sizes are not compatible.  Swapping bytes over adjacent packets");
+	}
 
-	// Make sure to send an exact multiple of numSwap if it's greater than 1
-	if (numSwap > 1) {
-		newLeftoverSize = totalSize % numSwap;
+	// Not even one whole word yet
+	if (outSize == 0) {
+		leftover.insert(leftover.end(), data, data + numBytes);
+		variants.data[numSwap] = SharedBuffer();
+		return;
+	}
 
-		if (numSwap != dataSize) {
-			LOG_WARN(sinksocket_i, "Data size of " << dataSize << " is not equal to byte swap size  of " << numSwap <<".");
-		}
+	BufferPool::BufferPtr buffer = bufferPool.get(outSize);
+	char *out = &(*buffer)[0];
+	size_t consumed = 0;
+
+	// Finish the word started by the previous packet
+	if (oldLeftoverSize != 0) {
+		consumed = numSwap - oldLeftoverSize;
+		leftover.insert(leftover.end(), data, data + consumed);
+		::byteSwap(&leftover[0], out, 1, numSwap);
+		out += numSwap;
+	}
+
+	::byteSwap(data + consumed, out, (numBytes - consumed - newLeftoverSize) / numSwap, numSwap);
+
+	leftover.assign(data + numBytes - newLeftoverSize, data + numBytes);
+
+	variants.data[numSwap] = SharedBuffer::wrap(buffer, &(*buffer)[0], outSize);
+}
+
+void sinksocket_i::swapJob(const SharedBuffer &original, size_t dataSize, SwapVariants &variants, size_t index)
+{
+	createByteSwappedVector(original, dataSize, variants, swapJobs[index]);
+}
+
+void sinksocket_i::writeJob(const SharedBuffer &data, const SharedBuffer &header, const VrtPackets &vrt, const std::vector<int> &groups, int group, size_t index)
+{
+	size_t connection = writeJobs[index].first;
+	unsigned short port = writeJobs[index].second;
+
+	// Only the connections sending this form of the packet
+	if ((groups.empty() ? -1 : groups[connection]) != group) {
+		return;
+	}
+
+	if (internalConnections[connection]->isVrt()) {
+		internalConnections[connection]->writeVrt(port, vrt.headers, vrt.payloads);
 	} else {
-		newLeftoverSize = 0;
+		internalConnections[connection]->write(port, data, header);
 	}
+}
 
-	//Don't have to deal with leftover data.  This should be the typical case
-	if (newLeftoverSize == 0 && oldLeftoverSize == 0) {
-		if (numSwap > 1) {
-			newData.resize(numBytes);
-			vectorSwap(reinterpret_cast<const char *>(original.data()), newData, numSwap);
-			byteSwapped[typeid(T).name()][byteSwap] = newData;
+void sinksocket_i::writeByteSwapJob(const std::vector<SharedBuffer> &variants, const std::vector<SharedBuffer> &headers, const VrtPackets &vrt, const std::vector<int> &groups, int group, size_t index)
+{
+	size_t connection = writeJobs[index].first;
+	unsigned short port = writeJobs[index].second;
+
+	if ((groups.empty() ? -1 : groups[connection]) != group) {
+		return;
+	}
+
+	if (internalConnections[connection]->isVrt()) {
+		internalConnections[connection]->writeVrt(port, vrt.headers, vrt.payloads);
+	} else {
+		internalConnections[connection]->writeByteSwap(port, variants, headers);
+	}
+}
+
+/*
+ * Convert the float or double samples of the current packet to
+ * the conversion's format, in a pooled buffer
+ */
+SharedBuffer sinksocket_i::createConvertedData(const SharedBuffer &data, const SampleConversion &conversion)
+{
+	bool fromDouble = (conversion.input == size_t(PortTypeIndex<bulkio::InDoublePort>::value));
+	size_t count = data.size() / (fromDouble ? sizeof(CORBA::Double) : sizeof(CORBA::Float));
+	size_t numBytes = count * sampleFormatSize(conversion.format);
+
+	if (numBytes == 0) {
+		return SharedBuffer();
+	}
+
+	BufferPool::BufferPtr buffer = bufferPool.get(numBytes);
+
+	if (fromDouble) {
+		convertSamples(reinterpret_cast<const double *>(data.data()), &(*buffer)[0], count, conversion.format, conversion.scale);
+	} else {
+		convertSamples(reinterpret_cast<const float *>(data.data()), &(*buffer)[0], count, conversion.format, conversion.scale);
+	}
+
+	return SharedBuffer::wrap(buffer, &(*buffer)[0], numBytes);
+}
+
+/*
+ * Group the connections by the samples they send from the float
+ * and double ports, so that each distinct format and scale is
+ * converted once per packet.  A conversion that was already in
+ * use keeps its state, such as the partial words of its byte
+ * swaps and its frame sequence number
+ */
+void sinksocket_i::updateConversions(size_t cacheSize)
+{
+	const size_t inputs[] = { PortTypeIndex<bulkio::InFloatPort>::value, PortTypeIndex<bulkio::InDoublePort>::value };
+	const size_t inputSizes[] = { sizeof(CORBA::Float), sizeof(CORBA::Double) };
+	std::vector<SampleConversion> updated;
+
+	for (size_t i = 0; i < 2; ++i) {
+		size_t input = inputs[i];
+
+		conversionGroups[input].clear();
+		sendsNative[input] = internalConnections.empty();
+
+		for (size_t index = 0; index < internalConnections.size(); ++index) {
+			const Connection_struct &connection = internalConnections[index]->getConnection();
+			SampleFormat format = parseSampleFormat(connection.sample_format);
+
+			// Only formats narrower than the input are converted to
+			if (format == SAMPLES_NATIVE || sampleFormatSize(format) >= inputSizes[i]) {
+				conversionGroups[input].push_back(-1);
+				sendsNative[input] = true;
+				continue;
+			}
+
+			size_t group = 0;
+
+			while (group < updated.size() && (updated[group].input != input || updated[group].format != format || updated[group].scale != connection.sample_scale)) {
+				++group;
+			}
+
+			if (group == updated.size()) {
+				SampleConversion conversion;
+				conversion.input = input;
+				conversion.format = format;
+				conversion.scale = connection.sample_scale;
+
+				for (std::vector<SampleConversion>::const_iterator j = conversions.begin(); j != conversions.end(); ++j) {
+					if (j->input == input && j->format == format && j->scale == connection.sample_scale) {
+						conversion.variants = j->variants;
+					}
+				}
+
+				conversion.variants.data.resize(cacheSize);
+				conversion.variants.leftovers.resize(cacheSize);
+				conversion.variants.headers.resize(cacheSize);
+				updated.push_back(conversion);
+			}
+
+			// VITA-49 samples are big endian, whatever the byte swap
+			std::vector<unsigned short> &widths = updated[group].widths;
+
+			if (InternalConnection::isVrt(connection)) {
+				if (VRT_BYTE_SWAP != 0 && find(widths.begin(), widths.end(), VRT_BYTE_SWAP) == widths.end()) {
+					widths.push_back(VRT_BYTE_SWAP);
+				}
+			} else {
+				for (std::vector<unsigned short>::const_iterator j = connection.byte_swap.begin(); j != connection.byte_swap.end(); ++j) {
+					if (*j != 0 && find(widths.begin(), widths.end(), *j) == widths.end()) {
+						widths.push_back(*j);
+					}
+				}
+			}
+
+			conversionGroups[input].push_back(group);
 		}
 	}
-	else
-	{
-		LOG_WARN(sinksocket_i, "Byte swapping and packet sizes are not compatible.  Swapping bytes over adjacent packets");
 
-		newData.reserve(totalSize - newLeftoverSize);
-		newData.insert(newData.begin(), leftovers[typeid(T).name()][byteSwap].begin(), leftovers[typeid(T).name()][byteSwap].end());
-		newData.insert(newData.begin() + oldLeftoverSize, reinterpret_cast<const char *>(original.data()), reinterpret_cast<const char *>(original.data()) + numBytes - newLeftoverSize);
+	conversions.swap(updated);
+}
+
+/*
+ * Build the frame header for length bytes of the packet's
+ * samples, byte swapped at numSwap, in a pooled buffer
+ */
+template<typename Packet>
+SharedBuffer sinksocket_i::createFrameHeader(const Packet *packet, char dataType, size_t sampleSize, size_t length, boost::uint32_t sequence, unsigned short numSwap)
+{
+	BufferPool::BufferPtr buffer = bufferPool.get(sizeof(FrameHeader));
+	boost::uint8_t flags = 0;
+
+	if (packet->sriChanged) {
+		flags |= FRAME_SRI_CHANGED;
+	}
+
+	if (packet->EOS) {
+		flags |= FRAME_EOS;
+	}
+
+	if (packet->T.tcstatus == BULKIO::TCS_VALID) {
+		flags |= FRAME_TIME_VALID;
+	}
+
+	encodeFrameHeader(*reinterpret_cast<FrameHeader *>(&(*buffer)[0]), dataType, sampleSize, length, sequence, numSwap, flags, packet->T.twsec, packet->T.tfsec, packet->SRI.xdelta);
+
+	return SharedBuffer::wrap(buffer, &(*buffer)[0], sizeof(FrameHeader));
+}
+
+/*
+ * Split the big endian payload of the packet into VITA-49 IF data
+ * packets, led by an IF context packet when the SRI has changed or
+ * vrt_context_interval packets of its stream have gone by.  Every
+ * stream counts its packets separately, starting over once it
+ * ends, so that a receiver can tell when it has lost some of
+ * the stream it follows.  The headers are all
+ * written into one pooled buffer and the payloads refer to the
+ * samples where they are, so only a final packet that isn't a
+ * whole number of words is copied, to pad it
+ */
+template<typename Packet>
+void sinksocket_i::createVrtPackets(const Packet *packet, char dataType, size_t sampleSize, const SharedBuffer &payload, VrtPackets &vrt)
+{
+	vrt.headers.clear();
+	vrt.payloads.clear();
+
+	boost::uint32_t streamId = vrtStreamId(std::string(packet->SRI.streamID));
+	VrtStreamCounts &counts = vrt.streams[streamId];
+
+	bool context = (packet->sriChanged || counts.sinceContext == 0);
+	size_t frameSize = sampleSize * (packet->SRI.mode ? 2 : 1);
+	size_t maxPayload = VRT_MAX_PAYLOAD_BYTES / frameSize * frameSize;
+	size_t numPackets = (payload.size() + maxPayload - 1) / maxPayload;
+
+	if (++counts.sinceContext >= vrt_context_interval) {
+		counts.sinceContext = 0;
+	}
+
+	if (not context && numPackets == 0) {
+		if (packet->EOS) {
+			vrt.streams.erase(streamId);
+		}
+		return;
+	}
+
+	BufferPool::BufferPtr buffer = bufferPool.get(((context ? VRT_MAX_CONTEXT_WORDS : 0) + numPackets * VRT_MAX_HEADER_WORDS) * sizeof(boost::uint32_t));
+	boost::uint32_t *words = reinterpret_cast<boost::uint32_t *>(&(*buffer)[0]);
+	bool valid = (packet->T.tcstatus == BULKIO::TCS_VALID);
+
+	if (context) {
+		VrtTimestamp time = makeVrtTimestamp(valid, packet->T.twsec, packet->T.tfsec, 0);
+		double sampleRate = (packet->SRI.xdelta > 0) ? 1.0 / packet->SRI.xdelta : 0;
+		size_t size = encodeVrtContext(words, counts.contextCount++, streamId, time, packet->sriChanged, sampleRate, packet->SRI.mode, vrtItemFormat(dataType), sampleSize * 8);
+
+		vrt.headers.push_back(SharedBuffer::wrap(buffer, reinterpret_cast<const char *>(words), size * sizeof(boost::uint32_t)));
+		vrt.payloads.push_back(SharedBuffer());
+		words += size;
+	}
+
+	for (size_t offset = 0; offset < payload.size(); offset += maxPayload) {
+		size_t numBytes = std::min(maxPayload, payload.size() - offset);
+		size_t paddedBytes = (numBytes + 3) / 4 * 4;
+		VrtTimestamp time = makeVrtTimestamp(valid, packet->T.twsec, packet->T.tfsec, (offset / frameSize) * packet->SRI.xdelta);
+		size_t size = encodeVrtHeader(words, VRT_IF_DATA, counts.dataCount++, vrtHeaderWords(time) + paddedBytes / 4, streamId, time);
+
+		vrt.headers.push_back(SharedBuffer::wrap(buffer, reinterpret_cast<const char *>(words), size * sizeof(boost::uint32_t)));
+		words += size;
+
+		if (paddedBytes == numBytes) {
+			vrt.payloads.push_back(payload.slice(offset, numBytes));
+		} else {
+			BufferPool::BufferPtr padded = bufferPool.get(paddedBytes);
+
+			memcpy(&(*padded)[0], payload.data() + offset, numBytes);
+			memset(&(*padded)[numBytes], 0, paddedBytes - numBytes);
+			vrt.payloads.push_back(SharedBuffer::wrap(padded, &(*padded)[0], paddedBytes));
+		}
+	}
+
+	// A stream that starts again after its end counts from 0
+	if (packet->EOS) {
+		vrt.streams.erase(streamId);
+	}
+}
+
+/*
+ * Send one form of the current packet, either the samples as they
+ * are or converted to one sample format, to the connections that
+ * use it.  Each byte swap in widths is built once and shared, as
+ * are the frame headers and VITA-49 packets
+ */
+template<typename Packet>
+void sinksocket_i::sendVariants(const Packet *packet, char dataType, size_t dataSize, const SharedBuffer &data, SwapVariants &variants, bool byteSwap, const std::vector<unsigned short> &widths, const std::vector<int> &groups, int group)
+{
+	boost::uint32_t sequence = performFraming ? variants.frames++ : 0;
+
+	// Avoid unnecessary processing and allocation if no byte swaps
+	// are being performed
+	if (byteSwap) {
+		// The unswapped data is passed along as is
+		variants.data[0] = data;
+
+		// Work out which swaps actually need building.  A byte swap
+		// of 1 means the word size, so it shares that variant
+		swapJobs.clear();
+
+		for (std::vector<unsigned short>::const_iterator i = widths.begin(); i != widths.end(); ++i) {
+			unsigned short numSwap = (*i == 1) ? dataSize : *i;
+
+			if (numSwap > 1 && find(swapJobs.begin(), swapJobs.end(), numSwap) == swapJobs.end()) {
+				swapJobs.push_back(numSwap);
+			}
+		}
+
+		// Build each byte swapped variant in use once, no matter how
+		// many connections share it
+		workerPool.parallelFor(swapJobs.size(), boost::bind(&sinksocket_i::swapJob, this, boost::cref(data), dataSize, boost::ref(variants), _1));
+
+		for (std::vector<unsigned short>::const_iterator i = widths.begin(); i != widths.end(); ++i) {
+			unsigned short numSwap = (*i == 1) ? dataSize : *i;
+
+			variants.data[*i] = (numSwap > 1) ? variants.data[numSwap] : data;
+		}
+
+		// Each variant gets its own header, since a partial word
+		// carried over can change its length
+		if (performFraming) {
+			variants.headers[0] = createFrameHeader(packet, dataType, dataSize, data.size(), sequence, 0);
+
+			for (std::vector<unsigned short>::const_iterator i = widths.begin(); i != widths.end(); ++i) {
+				unsigned short numSwap = (*i == 1) ? dataSize : *i;
 
-		if (numSwap > 1) {
-			vectorSwap(newData, numSwap);
+				variants.headers[*i] = createFrameHeader(packet, dataType, dataSize, variants.data[*i].size(), sequence, numSwap);
+			}
 		}
 
-		byteSwapped[typeid(T).name()][byteSwap] = newData;
-		leftovers[typeid(T).name()][byteSwap].clear();
+		if (performVrt) {
+			createVrtPackets(packet, dataType, dataSize, variants.data[VRT_BYTE_SWAP], variants.vrt);
+		}
+
+		workerPool.parallelFor(writeJobs.size(), boost::bind(&sinksocket_i::writeByteSwapJob, this, boost::cref(variants.data), boost::cref(variants.headers), boost::cref(variants.vrt), boost::cref(groups), group, _1));
+
+		// Release this packet's buffers back to the pool once the
+		// connections are done with them, keeping the cache slots
+		for (size_t i = 0; i < variants.data.size(); ++i) {
+			variants.data[i] = SharedBuffer();
+			variants.headers[i] = SharedBuffer();
+		}
+	} else {
+		SharedBuffer header;
 
-		// If we have new leftovers, populate it now
-		if (newLeftoverSize != 0) {
-			leftovers[typeid(T).name()][byteSwap].insert(leftovers[typeid(T).name()][byteSwap].begin(), reinterpret_cast<const char *>(original.data()) + numBytes - newLeftoverSize, reinterpret_cast<const char *>(original.data()) + numBytes);
+		if (performFraming) {
+			header = createFrameHeader(packet, dataType, dataSize, data.size(), sequence, 0);
 		}
+
+		// Only reached on a big endian host, where the samples are
+		// already in VITA-49 order
+		if (performVrt) {
+			createVrtPackets(packet, dataType, dataSize, data, variants.vrt);
+		}
+
+		// Write the data buffer to every port of every internal
+		// connection
+		workerPool.parallelFor(writeJobs.size(), boost::bind(&sinksocket_i::writeJob, this, boost::cref(data), boost::cref(header), boost::cref(variants.vrt), boost::cref(groups), group, _1));
 	}
+
+	variants.vrt.headers.clear();
+	variants.vrt.payloads.clear();
+}
+
+void sinksocket_i::worker_threadsChanged(const CORBA::ULong *oldValue, const CORBA::ULong *newValue)
+{
+	boost::recursive_mutex::scoped_lock lock(socketsLock_);
+
+	LOG_DEBUG(sinksocket_i, "Fanning out over " << *newValue << " worker threads");
+	workerPool.resize(*newValue);
 }
 
 void sinksocket_i::ConnectionsChanged(const std::vector<Connection_struct> *oldValue, const std::vector<Connection_struct> *newValue)
@@ -157,14 +595,37 @@ void sinksocket_i::ConnectionsChanged(const std::vector<Connection_struct> *oldV
 	// Now coalesce any servers or clients with duplicate information
 	std::vector<Connection_struct> duplicateFree;
 
-	for (std::vector<Connection_struct>::const_iterator i = cleanList.begin(); i != cleanList.end(); ++i) {
+	for (std::vector<Connection_struct>::iterator i = cleanList.begin(); i != cleanList.end(); ++i) {
 		bool found = false;
 		std::vector<Connection_struct>::iterator j;
 
+		// Entries with other settings can't share a port, so drop
+		// any port that an earlier one to the same address has
+		// already taken
+		std::vector<unsigned short> ports;
+		std::vector<unsigned short> byteSwaps;
+
+		for (size_t k = 0; k < i->ports.size(); ++k) {
+			if (portTaken(duplicateFree, *i, i->ports[k])) {
+				LOG_WARN(sinksocket_i, "Port " << i->ports[k] << " is already used by a " << i->connection_type << " connection to \"" << i->ip_address << "\" with other settings, ignoring it");
+			} else {
+				ports.push_back(i->ports[k]);
+				byteSwaps.push_back(i->byte_swap[k]);
+			}
+		}
+
+		if (ports.empty() && not i->ports.empty()) {
+			continue;
+		}
+
+		i->ports = ports;
+		i->byte_swap = byteSwaps;
+
 		// Check if the duplicate list already contains an entry with
-		// a matching connection type and IP
+		// a matching connection type and IP, and the same settings
+		// apart from its ports
 		for (j = duplicateFree.begin(); j != duplicateFree.end(); ++j) {
-			if (i->connection_type == j->connection_type && i->ip_address == j->ip_address) {
+			if (i->connection_type == j->connection_type && i->ip_address == j->ip_address && sameSettings(*i, *j)) {
 				found = true;
 				break;
 			}
@@ -172,10 +633,9 @@ void sinksocket_i::ConnectionsChanged(const std::vector<Connection_struct> *oldV
 
 		// Augment the existing entry to contain the new data
 		if (found) {
-			Connection_struct combined;
-
-			combined.connection_type = j->connection_type;
-			combined.ip_address = j->ip_address;
+			// The settings other than the ports and byte swaps are
+			// the same in both entries
+			Connection_struct combined = *j;
 
 			// Vectors used for combining and preserving the order
 			// of the ports and byte swaps lists
@@ -230,10 +690,10 @@ void sinksocket_i::ConnectionsChanged(const std::vector<Connection_struct> *oldV
 	Connections = duplicateFree;
 
 	boost::recursive_mutex::scoped_lock lock(socketsLock_);
+	boost::mutex::scoped_lock statsLock(statsLock_);
 
-	// Reinitialize the onlyByteSwaps and performByteSwap members
-	// and then set them appropriately
-	onlyByteSwaps = true;
+	// Reinitialize the performByteSwap member and then set it
+	// appropriately
 	performByteSwap = false;
 
 	// Keep a list of stats to populate the ConnectionStats property
@@ -247,7 +707,7 @@ void sinksocket_i::ConnectionsChanged(const std::vector<Connection_struct> *oldV
 		// This is a brand new connection
 		if (found == internalConnections.end()) {
 			LOG_DEBUG(sinksocket_i, "Adding new internal connection");
-			internalConnections.push_back(new InternalConnection());
+			internalConnections.push_back(new InternalConnection(ioPool, sendEngine.running() ? &sendEngine : NULL));
 
 			returned = internalConnections.back()->setConnection(*i);
 		} else {
@@ -260,15 +720,6 @@ void sinksocket_i::ConnectionsChanged(const std::vector<Connection_struct> *oldV
 
 		stats.insert(stats.end(), returned.begin(), returned.end());
 
-		// Set the onlyByteSwaps flag if necessary
-		if (onlyByteSwaps) {
-			for (std::vector<unsigned short>::const_iterator j = i->byte_swap.begin(); j != i->byte_swap.end(); ++j) {
-				if (not (onlyByteSwaps &= (*j != 0))) {
-					break;
-				}
-			}
-		}
-
 		// Set the performByteSwap flag if necessary
 		if (not performByteSwap) {
 			for (std::vector<unsigned short>::const_iterator j = i->byte_swap.begin(); j != i->byte_swap.end(); ++j) {
@@ -281,6 +732,39 @@ void sinksocket_i::ConnectionsChanged(const std::vector<Connection_struct> *oldV
 
 	ConnectionStats = stats;
 
+	// Collect the distinct byte swap values in use so that each
+	// variant is built once per packet, and size the cache so that
+	// every value, including the widest data type, has a slot
+	std::set<unsigned short> widths;
+	size_t cacheSize = sizeof(CORBA::Double) + 1;
+
+	for (std::vector<Connection_struct>::const_iterator i = duplicateFree.begin(); i != duplicateFree.end(); ++i) {
+		// VITA-49 samples are big endian, whatever the byte swap
+		if (InternalConnection::isVrt(*i)) {
+			if (VRT_BYTE_SWAP != 0) {
+				widths.insert(VRT_BYTE_SWAP);
+				performByteSwap = true;
+			}
+
+			continue;
+		}
+
+		for (std::vector<unsigned short>::const_iterator j = i->byte_swap.begin(); j != i->byte_swap.end(); ++j) {
+			if (*j != 0) {
+				widths.insert(*j);
+				cacheSize = std::max(cacheSize, size_t(*j) + 1);
+			}
+		}
+	}
+
+	swapWidths.assign(widths.begin(), widths.end());
+
+	for (size_t i = 0; i < NUM_PORT_TYPES; ++i) {
+		swapCache[i].data.resize(cacheSize);
+		swapCache[i].leftovers.resize(cacheSize);
+		swapCache[i].headers.resize(cacheSize);
+	}
+
 	// Remove from the current connections
 	if (oldValue != NULL){
 		for (std::vector<Connection_struct>::const_iterator i = oldValue->begin(); i != oldValue->end(); ++i) {
@@ -299,6 +783,38 @@ void sinksocket_i::ConnectionsChanged(const std::vector<Connection_struct> *oldV
 			}
 		}
 	}
+
+	// Frame headers and VITA-49 packets are only built if a
+	// remaining connection uses them
+	performFraming = false;
+	performVrt = false;
+
+	bool keepsPackets = false;
+
+	for (std::vector<InternalConnection *>::const_iterator i = internalConnections.begin(); i != internalConnections.end(); ++i) {
+		performFraming |= (*i)->isFramed();
+		performVrt |= (*i)->isVrt();
+		keepsPackets |= (*i)->keepsPacketBoundaries();
+	}
+
+	// A frame or a VITA-49 packet describes a single packet, and a
+	// seqpacket socket sends each packet as a message of its own,
+	// so any of them turns batching off
+	performBatching = not (performFraming or performVrt or keepsPackets);
+
+	// Servers, and clients to the same address, share one internal
+	// connection, so the writes are spread over the workers by port
+	writeJobs.clear();
+
+	for (size_t i = 0; i < internalConnections.size(); ++i) {
+		std::vector<unsigned short> ports = internalConnections[i]->getPorts();
+
+		for (std::vector<unsigned short>::const_iterator j = ports.begin(); j != ports.end(); ++j) {
+			writeJobs.push_back(std::make_pair(i, *j));
+		}
+	}
+
+	updateConversions(cacheSize);
 }
 
 int sinksocket_i::serviceFunction()
@@ -333,76 +849,111 @@ int sinksocket_i::serviceFunctionT(T* inputPort)
 		return NOOP;
 	}
 
-	if (packet->inputQueueFlushed) {
-		LOG_WARN(sinksocket_i, "Input Queue Flushed");
-	}
-
+	// ConnectionsChanged turns batching off under the lock, so hold
+	// it from before the batch is drained until it has been sent
 	boost::recursive_mutex::scoped_lock lock(socketsLock_);
 
-	// Keep a list of stats to populate the ConnectionStats property
-	std::vector<ConnectionStat_struct> stats;
-	std::vector<ConnectionStat_struct> returned;
+	// Drain whatever else is already queued, up to the batch limits,
+	// so that each run of packets from one stream is swapped and
+	// sent as one unit
+	std::vector<typename T::dataTransfer *> packets(1, packet);
+	size_t batchBytes = packet->dataBuffer.size() * sizeof(packet->dataBuffer[0]);
 
-	// Avoid unnecessary processing and allocation if no byte swaps
-	// are being performed
-	if (performByteSwap) {
-		// Use the data type as the key into the byteSwapped and
-		// leftovers member maps
-		std::string byteSwapKey = typeid(packet->dataBuffer[0]).name();
-
-		// This copy isn't necessary if all of the connections require
-		// byte swaps
-		if (not onlyByteSwaps) {
-			byteSwapped[byteSwapKey][0] = std::vector<char>(reinterpret_cast<char *>(packet->dataBuffer.data()),
-																				reinterpret_cast<char *>(packet->dataBuffer.data()) + packet->dataBuffer.size() * sizeof(packet->dataBuffer[0]));
-		}
+	while (performBatching && packets.size() < max_batch_packets && batchBytes < max_batch_bytes) {
+		packet = inputPort->getPacket(0.0);
 
-		// Iterate through the internal connections, building the byte
-		// swapped vectors as necessary.  This should prevent multiple
-		// byte swaps for the same byte swap values from being performed
-		// in the same service function call
-		for (std::vector<InternalConnection *>::iterator i = internalConnections.begin(); i != internalConnections.end(); ++i) {
-			std::vector<unsigned short> byteSwaps = (*i)->getByteSwaps();
-
-			for (std::vector<unsigned short>::iterator j = byteSwaps.begin(); j != byteSwaps.end(); ++j) {
-				if (*j != 0) {
-					if (byteSwapped[byteSwapKey].find(*j) == byteSwapped[byteSwapKey].end()) {
-						createByteSwappedVector(packet->dataBuffer, *j);
-					}
-				}
-			}
+		if (not packet) {
+			break;
+		}
 
-			returned = (*i)->writeByteSwap(byteSwapped[byteSwapKey]);
+		packets.push_back(packet);
+		batchBytes += packet->dataBuffer.size() * sizeof(packet->dataBuffer[0]);
+	}
 
-			stats.insert(stats.end(), returned.begin(), returned.end());
+	for (typename std::vector<typename T::dataTransfer *>::const_iterator i = packets.begin(); i != packets.end(); ++i) {
+		if ((*i)->inputQueueFlushed) {
+			LOG_WARN(sinksocket_i, "Input Queue Flushed");
 		}
+	}
 
-		byteSwapped[byteSwapKey].clear();
-	} else {
-		// Iterate through the internal connections and write the data buffer
-		for (std::vector<InternalConnection *>::iterator i = internalConnections.begin(); i != internalConnections.end(); ++i) {
-			returned = (*i)->write(packet->dataBuffer);
+	// Submit the writes to every connection to the io_uring
+	// together, with one system call
+	IoUringBatch batch(sendEngine);
 
-			stats.insert(stats.end(), returned.begin(), returned.end());
+	// Send the batch in runs of packets from one stream.  A run
+	// ends with an EOS, and before a packet that changes the SRI
+	size_t first = 0;
+
+	while (first < packets.size()) {
+		size_t last = first + 1;
+
+		while (last < packets.size() && not packets[last - 1]->EOS && not packets[last]->sriChanged && packets[last]->streamID == packets[first]->streamID) {
+			++last;
 		}
+
+		sendPackets<T>(packets, first, last);
+		first = last;
 	}
 
-	// Update the properties
-	bytesPerSecTemp = 0;
-	totalBytesTemp = 0;
+	for (typename std::vector<typename T::dataTransfer *>::iterator i = packets.begin(); i != packets.end(); ++i) {
+		delete *i;
+	}
+
+	return NORMAL;
+}
+
+/*
+ * Send packets first up to last of a batch as one unit, through
+ * every connection of the port's type.  Must be called with
+ * socketsLock_ held
+ */
+template<typename T>
+void sinksocket_i::sendPackets(const std::vector<typename T::dataTransfer *> &packets, size_t first, size_t last)
+{
+	size_t batchBytes = 0;
 
-	for (std::vector<ConnectionStat_struct>::const_iterator i = stats.begin(); i != stats.end(); ++i) {
-		bytesPerSecTemp += i->bytes_per_second;
-		totalBytesTemp += i->bytes_sent;
+	for (size_t i = first; i < last; ++i) {
+		batchBytes += packets[i]->dataBuffer.size() * sizeof(packets[i]->dataBuffer[0]);
 	}
 
-	bytes_per_sec = bytesPerSecTemp;
-	ConnectionStats = stats;
-	total_bytes = totalBytesTemp;
+	SharedBuffer data;
+
+	if (last - first == 1) {
+		// Take ownership of the packet data so that every connection
+		// shares the same buffer instead of making its own copy
+		data = SharedBuffer::adopt(packets[first]->dataBuffer);
+	} else if (batchBytes != 0) {
+		// Join the small packets into one pooled buffer
+		BufferPool::BufferPtr buffer = bufferPool.get(batchBytes);
+		char *out = &(*buffer)[0];
+
+		for (size_t i = first; i < last; ++i) {
+			size_t numBytes = packets[i]->dataBuffer.size() * sizeof(packets[i]->dataBuffer[0]);
+
+			if (numBytes != 0) {
+				memcpy(out, &packets[i]->dataBuffer[0], numBytes);
+				out += numBytes;
+			}
+		}
 
-	if (packet) {
-		delete packet;
+		data = SharedBuffer::wrap(buffer, &(*buffer)[0], batchBytes);
 	}
 
-	return NORMAL;
+	// Every connection sending the samples as they are, with the
+	// cache entry for this data type selected at compile time
+	if (sendsNative[PortTypeIndex<T>::value]) {
+		sendVariants(packets[first], PortTypeIndex<T>::format, sizeof(packets[first]->dataBuffer[0]), data, swapCache[PortTypeIndex<T>::value], performByteSwap, swapWidths, conversionGroups[PortTypeIndex<T>::value], -1);
+	}
+
+	// Then every format the samples are converted to, each made once
+	// and shared by the connections that use it
+	for (size_t i = 0; i < conversions.size(); ++i) {
+		SampleConversion &conversion = conversions[i];
+
+		if (conversion.input == PortTypeIndex<T>::value) {
+			SharedBuffer converted = createConvertedData(data, conversion);
+
+			sendVariants(packets[first], sampleFormatType(conversion.format), sampleFormatSize(conversion.format), converted, conversion.variants, not conversion.widths.empty(), conversion.widths, conversionGroups[PortTypeIndex<T>::value], i);
+		}
+	}
 }
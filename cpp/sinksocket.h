@@ -22,13 +22,93 @@
 #include "sinksocket_base.h"
 #include "BoostClient.h"
 #include "BoostServer.h"
+#include "BufferPool.h"
+#include "FrameHeader.h"
 #include "InternalConnection.h"
+#include "VrtPacket.h"
+#include "WorkerPool.h"
 #include "quickstats.h"
+#include "sampleconvert.h"
 
+#include <map>
 #include <vector>
 
 class sinksocket_i;
 
+/*
+ * Compile-time index of each input port's data type, used to
+ * select that type's entry in the byte swap cache, and the
+ * type's struct module format character for frame headers
+ */
+template<typename T>
+struct PortTypeIndex;
+
+template<> struct PortTypeIndex<bulkio::InOctetPort> { enum { value = 0, format = 'B' }; };
+template<> struct PortTypeIndex<bulkio::InCharPort> { enum { value = 1, format = 'b' }; };
+template<> struct PortTypeIndex<bulkio::InShortPort> { enum { value = 2, format = 'h' }; };
+template<> struct PortTypeIndex<bulkio::InUShortPort> { enum { value = 3, format = 'H' }; };
+template<> struct PortTypeIndex<bulkio::InLongPort> { enum { value = 4, format = 'i' }; };
+template<> struct PortTypeIndex<bulkio::InULongPort> { enum { value = 5, format = 'I' }; };
+template<> struct PortTypeIndex<bulkio::InFloatPort> { enum { value = 6, format = 'f' }; };
+template<> struct PortTypeIndex<bulkio::InDoublePort> { enum { value = 7, format = 'd' }; };
+
+const size_t NUM_PORT_TYPES = 8;
+
+/*
+ * The packet counts of the data and context packets of one
+ * VITA-49 stream, and its input packets since its last context
+ * packet
+ */
+struct VrtStreamCounts {
+	VrtStreamCounts() : dataCount(0), contextCount(0), sinceContext(0) {}
+
+	boost::uint32_t dataCount;
+	boost::uint32_t contextCount;
+	CORBA::ULong sinceContext;
+};
+
+/*
+ * The VITA-49 packets of the current packet for one data type,
+ * each a header and a payload, which is empty for a context
+ * packet, along with the counts of each stream, by stream ID,
+ * until it ends
+ */
+struct VrtPackets {
+	std::vector<SharedBuffer> headers;
+	std::vector<SharedBuffer> payloads;
+	std::map<boost::uint32_t, VrtStreamCounts> streams;
+};
+
+/*
+ * The byte swapped variants of the current packet for one data
+ * type, indexed by byte swap value, along with the bytes of any
+ * partial word carried over from the previous packet, the frame
+ * header for each variant, the sequence number of the next
+ * frame and the VITA-49 packets
+ */
+struct SwapVariants {
+	SwapVariants() : frames(0) {}
+
+	std::vector<SharedBuffer> data;
+	std::vector<std::vector<char> > leftovers;
+	std::vector<SharedBuffer> headers;
+	boost::uint32_t frames;
+	VrtPackets vrt;
+};
+
+/*
+ * A sample format that the float or double port is converted to
+ * for some connections, with its scale, the byte swaps those
+ * connections use and the variants of the converted samples
+ */
+struct SampleConversion {
+	size_t input;
+	SampleFormat format;
+	float scale;
+	std::vector<unsigned short> widths;
+	SwapVariants variants;
+};
+
 class sinksocket_i : public sinksocket_base
 {
 	ENABLE_LOGGING
@@ -40,8 +120,25 @@ public:
 	template<typename T>
 	int serviceFunctionT(T* inputPort);
 private:
-	template<typename T, typename U>
-	void createByteSwappedVector(const std::vector<T, U> &original, unsigned short byteSwap);
+	void publishStatistics();
+	void createByteSwappedVector(const SharedBuffer &original, size_t dataSize, SwapVariants &variants, unsigned short numSwap);
+	void swapJob(const SharedBuffer &original, size_t dataSize, SwapVariants &variants, size_t index);
+	void writeJob(const SharedBuffer &data, const SharedBuffer &header, const VrtPackets &vrt, const std::vector<int> &groups, int group, size_t index);
+	void writeByteSwapJob(const std::vector<SharedBuffer> &variants, const std::vector<SharedBuffer> &headers, const VrtPackets &vrt, const std::vector<int> &groups, int group, size_t index);
+	SharedBuffer createConvertedData(const SharedBuffer &data, const SampleConversion &conversion);
+	void updateConversions(size_t cacheSize);
+
+	template<typename Packet>
+	SharedBuffer createFrameHeader(const Packet *packet, char dataType, size_t sampleSize, size_t length, boost::uint32_t sequence, unsigned short numSwap);
+
+	template<typename T>
+	void sendPackets(const std::vector<typename T::dataTransfer *> &packets, size_t first, size_t last);
+
+	template<typename Packet>
+	void sendVariants(const Packet *packet, char dataType, size_t dataSize, const SharedBuffer &data, SwapVariants &variants, bool byteSwap, const std::vector<unsigned short> &widths, const std::vector<int> &groups, int group);
+
+	template<typename Packet>
+	void createVrtPackets(const Packet *packet, char dataType, size_t sampleSize, const SharedBuffer &payload, VrtPackets &vrt);
 
 	template<typename T, typename U>
 	void sendData(std::vector<T, U>& outData);
@@ -49,17 +146,31 @@ private:
 	template<typename T, typename U>
 	void newData(std::vector<T, U>& newData);
 
+	BufferPool bufferPool;
 	float bytesPerSecTemp;
-	std::map<std::string, std::map<unsigned short, std::vector<char> > > byteSwapped;
 	std::vector<InternalConnection *> internalConnections;
-	std::map<std::string, std::map<unsigned short, std::vector<char> > > leftovers;
-	bool onlyByteSwaps;
+	std::vector<std::pair<size_t, unsigned short> > writeJobs;
+	IoServicePool ioPool;
 	bool performByteSwap;
+	bool performFraming;
+	bool performVrt;
+	bool performBatching;
+	IoUringSender sendEngine;
+	SwapVariants swapCache[NUM_PORT_TYPES];
+	std::vector<unsigned short> swapJobs;
+	std::vector<unsigned short> swapWidths;
+	std::vector<SampleConversion> conversions;
+	std::vector<int> conversionGroups[NUM_PORT_TYPES];
+	bool sendsNative[NUM_PORT_TYPES];
 	boost::recursive_mutex socketsLock_;
+	boost::thread *statsThread;
+	boost::mutex statsLock_;
 	double totalBytesTemp;
+	WorkerPool workerPool;
 
 	//Property Change Listener
 	void ConnectionsChanged(const std::vector<Connection_struct> *oldValue, const std::vector<Connection_struct> *newValue);
+	void worker_threadsChanged(const CORBA::ULong *oldValue, const CORBA::ULong *newValue);
 };
 
 #endif
@@ -138,6 +138,78 @@ void sinksocket_base::loadProperties()
                 "external",
                 "property");
 
+    addProperty(stats_period,
+                0.5,
+                "stats_period",
+                "",
+                "readwrite",
+                "s",
+                "external",
+                "property");
+
+    addProperty(max_batch_packets,
+                64,
+                "max_batch_packets",
+                "",
+                "readwrite",
+                "",
+                "external",
+                "property");
+
+    addProperty(max_batch_bytes,
+                65536,
+                "max_batch_bytes",
+                "",
+                "readwrite",
+                "bytes",
+                "external",
+                "property");
+
+    addProperty(worker_threads,
+                0,
+                "worker_threads",
+                "",
+                "readwrite",
+                "",
+                "external",
+                "property");
+
+    addProperty(io_threads,
+                1,
+                "io_threads",
+                "",
+                "readwrite",
+                "",
+                "external",
+                "property");
+
+    addProperty(io_per_core,
+                false,
+                "io_per_core",
+                "",
+                "readwrite",
+                "",
+                "external",
+                "property");
+
+    addProperty(send_engine,
+                "asio",
+                "send_engine",
+                "",
+                "readwrite",
+                "",
+                "external",
+                "property");
+
+    addProperty(vrt_context_interval,
+                100,
+                "vrt_context_interval",
+                "",
+                "readwrite",
+                "packets",
+                "external",
+                "property");
+
 }
 
 
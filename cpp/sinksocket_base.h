@@ -50,6 +50,22 @@ class sinksocket_base : public Component, protected ThreadedComponent
         std::vector<Connection_struct> Connections;
         /// Property: ConnectionStats
         std::vector<ConnectionStat_struct> ConnectionStats;
+        /// Property: stats_period
+        float stats_period;
+        /// Property: max_batch_packets
+        CORBA::ULong max_batch_packets;
+        /// Property: max_batch_bytes
+        CORBA::ULong max_batch_bytes;
+        /// Property: worker_threads
+        CORBA::ULong worker_threads;
+        /// Property: io_threads
+        CORBA::ULong io_threads;
+        /// Property: io_per_core
+        bool io_per_core;
+        /// Property: send_engine
+        std::string send_engine;
+        /// Property: vrt_context_interval
+        CORBA::ULong vrt_context_interval;
 
         // Ports
         /// Port: dataOctet_in
@@ -36,6 +36,31 @@ struct Connection_struct {
         ip_address = "";
         byte_swap.push_back(0);
         ports.push_back(32191);
+        max_queue_bytes = 67108864;
+        max_queue_packets = 0;
+        overflow_policy = "drop_newest";
+        reconnect_min_delay = 100;
+        reconnect_max_delay = 30000;
+        reconnect_max_attempts = 0;
+        dns_ttl = 300;
+        send_buffer_size = 0;
+        tcp_nodelay = false;
+        tcp_cork = false;
+        tcp_notsent_lowat = 0;
+        so_priority = 0;
+        dscp = 0;
+        tcp_congestion = "";
+        mtu = 1500;
+        multicast_ttl = 1;
+        multicast_interface = "";
+        multicast_loopback = true;
+        unix_socket_type = "stream";
+        shm_size = 16777216;
+        zerocopy_threshold = 0;
+        udp_gso = false;
+        framing = "none";
+        sample_format = "native";
+        sample_scale = 1.0;
     };
 
     static std::string getId() {
@@ -46,6 +71,31 @@ struct Connection_struct {
     std::string ip_address;
     std::vector<unsigned short> byte_swap;
     std::vector<unsigned short> ports;
+    CORBA::ULong max_queue_bytes;
+    CORBA::ULong max_queue_packets;
+    std::string overflow_policy;
+    CORBA::ULong reconnect_min_delay;
+    CORBA::ULong reconnect_max_delay;
+    CORBA::ULong reconnect_max_attempts;
+    CORBA::ULong dns_ttl;
+    CORBA::ULong send_buffer_size;
+    bool tcp_nodelay;
+    bool tcp_cork;
+    CORBA::ULong tcp_notsent_lowat;
+    CORBA::ULong so_priority;
+    unsigned short dscp;
+    std::string tcp_congestion;
+    CORBA::ULong mtu;
+    unsigned short multicast_ttl;
+    std::string multicast_interface;
+    bool multicast_loopback;
+    std::string unix_socket_type;
+    CORBA::ULong shm_size;
+    CORBA::ULong zerocopy_threshold;
+    bool udp_gso;
+    std::string framing;
+    std::string sample_format;
+    float sample_scale;
 };
 
 inline bool operator>>= (const CORBA::Any& a, Connection_struct& s) {
@@ -64,6 +114,81 @@ inline bool operator>>= (const CORBA::Any& a, Connection_struct& s) {
     if (props.contains("Connection::ports")) {
         if (!(props["Connection::ports"] >>= s.ports)) return false;
     }
+    if (props.contains("Connection::max_queue_bytes")) {
+        if (!(props["Connection::max_queue_bytes"] >>= s.max_queue_bytes)) return false;
+    }
+    if (props.contains("Connection::max_queue_packets")) {
+        if (!(props["Connection::max_queue_packets"] >>= s.max_queue_packets)) return false;
+    }
+    if (props.contains("Connection::overflow_policy")) {
+        if (!(props["Connection::overflow_policy"] >>= s.overflow_policy)) return false;
+    }
+    if (props.contains("Connection::reconnect_min_delay")) {
+        if (!(props["Connection::reconnect_min_delay"] >>= s.reconnect_min_delay)) return false;
+    }
+    if (props.contains("Connection::reconnect_max_delay")) {
+        if (!(props["Connection::reconnect_max_delay"] >>= s.reconnect_max_delay)) return false;
+    }
+    if (props.contains("Connection::reconnect_max_attempts")) {
+        if (!(props["Connection::reconnect_max_attempts"] >>= s.reconnect_max_attempts)) return false;
+    }
+    if (props.contains("Connection::dns_ttl")) {
+        if (!(props["Connection::dns_ttl"] >>= s.dns_ttl)) return false;
+    }
+    if (props.contains("Connection::send_buffer_size")) {
+        if (!(props["Connection::send_buffer_size"] >>= s.send_buffer_size)) return false;
+    }
+    if (props.contains("Connection::tcp_nodelay")) {
+        if (!(props["Connection::tcp_nodelay"] >>= s.tcp_nodelay)) return false;
+    }
+    if (props.contains("Connection::tcp_cork")) {
+        if (!(props["Connection::tcp_cork"] >>= s.tcp_cork)) return false;
+    }
+    if (props.contains("Connection::tcp_notsent_lowat")) {
+        if (!(props["Connection::tcp_notsent_lowat"] >>= s.tcp_notsent_lowat)) return false;
+    }
+    if (props.contains("Connection::so_priority")) {
+        if (!(props["Connection::so_priority"] >>= s.so_priority)) return false;
+    }
+    if (props.contains("Connection::dscp")) {
+        if (!(props["Connection::dscp"] >>= s.dscp)) return false;
+    }
+    if (props.contains("Connection::tcp_congestion")) {
+        if (!(props["Connection::tcp_congestion"] >>= s.tcp_congestion)) return false;
+    }
+    if (props.contains("Connection::mtu")) {
+        if (!(props["Connection::mtu"] >>= s.mtu)) return false;
+    }
+    if (props.contains("Connection::multicast_ttl")) {
+        if (!(props["Connection::multicast_ttl"] >>= s.multicast_ttl)) return false;
+    }
+    if (props.contains("Connection::multicast_interface")) {
+        if (!(props["Connection::multicast_interface"] >>= s.multicast_interface)) return false;
+    }
+    if (props.contains("Connection::multicast_loopback")) {
+        if (!(props["Connection::multicast_loopback"] >>= s.multicast_loopback)) return false;
+    }
+    if (props.contains("Connection::unix_socket_type")) {
+        if (!(props["Connection::unix_socket_type"] >>= s.unix_socket_type)) return false;
+    }
+    if (props.contains("Connection::shm_size")) {
+        if (!(props["Connection::shm_size"] >>= s.shm_size)) return false;
+    }
+    if (props.contains("Connection::zerocopy_threshold")) {
+        if (!(props["Connection::zerocopy_threshold"] >>= s.zerocopy_threshold)) return false;
+    }
+    if (props.contains("Connection::udp_gso")) {
+        if (!(props["Connection::udp_gso"] >>= s.udp_gso)) return false;
+    }
+    if (props.contains("Connection::framing")) {
+        if (!(props["Connection::framing"] >>= s.framing)) return false;
+    }
+    if (props.contains("Connection::sample_format")) {
+        if (!(props["Connection::sample_format"] >>= s.sample_format)) return false;
+    }
+    if (props.contains("Connection::sample_scale")) {
+        if (!(props["Connection::sample_scale"] >>= s.sample_scale)) return false;
+    }
     return true;
 }
 
@@ -77,6 +202,56 @@ inline void operator<<= (CORBA::Any& a, const Connection_struct& s) {
     props["Connection::byte_swap"] = s.byte_swap;
  
     props["Connection::ports"] = s.ports;
+ 
+    props["Connection::max_queue_bytes"] = s.max_queue_bytes;
+ 
+    props["Connection::max_queue_packets"] = s.max_queue_packets;
+ 
+    props["Connection::overflow_policy"] = s.overflow_policy;
+ 
+    props["Connection::reconnect_min_delay"] = s.reconnect_min_delay;
+ 
+    props["Connection::reconnect_max_delay"] = s.reconnect_max_delay;
+ 
+    props["Connection::reconnect_max_attempts"] = s.reconnect_max_attempts;
+ 
+    props["Connection::dns_ttl"] = s.dns_ttl;
+ 
+    props["Connection::send_buffer_size"] = s.send_buffer_size;
+ 
+    props["Connection::tcp_nodelay"] = s.tcp_nodelay;
+ 
+    props["Connection::tcp_cork"] = s.tcp_cork;
+ 
+    props["Connection::tcp_notsent_lowat"] = s.tcp_notsent_lowat;
+ 
+    props["Connection::so_priority"] = s.so_priority;
+ 
+    props["Connection::dscp"] = s.dscp;
+ 
+    props["Connection::tcp_congestion"] = s.tcp_congestion;
+ 
+    props["Connection::mtu"] = s.mtu;
+ 
+    props["Connection::multicast_ttl"] = s.multicast_ttl;
+ 
+    props["Connection::multicast_interface"] = s.multicast_interface;
+ 
+    props["Connection::multicast_loopback"] = s.multicast_loopback;
+ 
+    props["Connection::unix_socket_type"] = s.unix_socket_type;
+ 
+    props["Connection::shm_size"] = s.shm_size;
+ 
+    props["Connection::zerocopy_threshold"] = s.zerocopy_threshold;
+ 
+    props["Connection::udp_gso"] = s.udp_gso;
+ 
+    props["Connection::framing"] = s.framing;
+ 
+    props["Connection::sample_format"] = s.sample_format;
+ 
+    props["Connection::sample_scale"] = s.sample_scale;
     a <<= props;
 }
 
@@ -89,6 +264,56 @@ inline bool operator== (const Connection_struct& s1, const Connection_struct& s2
         return false;
     if (s1.ports!=s2.ports)
         return false;
+    if (s1.max_queue_bytes!=s2.max_queue_bytes)
+        return false;
+    if (s1.max_queue_packets!=s2.max_queue_packets)
+        return false;
+    if (s1.overflow_policy!=s2.overflow_policy)
+        return false;
+    if (s1.reconnect_min_delay!=s2.reconnect_min_delay)
+        return false;
+    if (s1.reconnect_max_delay!=s2.reconnect_max_delay)
+        return false;
+    if (s1.reconnect_max_attempts!=s2.reconnect_max_attempts)
+        return false;
+    if (s1.dns_ttl!=s2.dns_ttl)
+        return false;
+    if (s1.send_buffer_size!=s2.send_buffer_size)
+        return false;
+    if (s1.tcp_nodelay!=s2.tcp_nodelay)
+        return false;
+    if (s1.tcp_cork!=s2.tcp_cork)
+        return false;
+    if (s1.tcp_notsent_lowat!=s2.tcp_notsent_lowat)
+        return false;
+    if (s1.so_priority!=s2.so_priority)
+        return false;
+    if (s1.dscp!=s2.dscp)
+        return false;
+    if (s1.tcp_congestion!=s2.tcp_congestion)
+        return false;
+    if (s1.mtu!=s2.mtu)
+        return false;
+    if (s1.multicast_ttl!=s2.multicast_ttl)
+        return false;
+    if (s1.multicast_interface!=s2.multicast_interface)
+        return false;
+    if (s1.multicast_loopback!=s2.multicast_loopback)
+        return false;
+    if (s1.unix_socket_type!=s2.unix_socket_type)
+        return false;
+    if (s1.shm_size!=s2.shm_size)
+        return false;
+    if (s1.zerocopy_threshold!=s2.zerocopy_threshold)
+        return false;
+    if (s1.udp_gso!=s2.udp_gso)
+        return false;
+    if (s1.framing!=s2.framing)
+        return false;
+    if (s1.sample_format!=s2.sample_format)
+        return false;
+    if (s1.sample_scale!=s2.sample_scale)
+        return false;
     return true;
 }
 
@@ -110,6 +335,12 @@ struct ConnectionStat_struct {
     std::string status;
     float bytes_per_second;
     double bytes_sent;
+    double packets_dropped;
+    double bytes_dropped;
+    double datagrams_sent;
+    double zerocopy_sends;
+    double zerocopy_copied;
+    std::string send_method;
 };
 
 inline bool operator>>= (const CORBA::Any& a, ConnectionStat_struct& s) {
@@ -131,6 +362,24 @@ inline bool operator>>= (const CORBA::Any& a, ConnectionStat_struct& s) {
     if (props.contains("ConnectionStat::bytes_sent")) {
         if (!(props["ConnectionStat::bytes_sent"] >>= s.bytes_sent)) return false;
     }
+    if (props.contains("ConnectionStat::packets_dropped")) {
+        if (!(props["ConnectionStat::packets_dropped"] >>= s.packets_dropped)) return false;
+    }
+    if (props.contains("ConnectionStat::bytes_dropped")) {
+        if (!(props["ConnectionStat::bytes_dropped"] >>= s.bytes_dropped)) return false;
+    }
+    if (props.contains("ConnectionStat::datagrams_sent")) {
+        if (!(props["ConnectionStat::datagrams_sent"] >>= s.datagrams_sent)) return false;
+    }
+    if (props.contains("ConnectionStat::zerocopy_sends")) {
+        if (!(props["ConnectionStat::zerocopy_sends"] >>= s.zerocopy_sends)) return false;
+    }
+    if (props.contains("ConnectionStat::zerocopy_copied")) {
+        if (!(props["ConnectionStat::zerocopy_copied"] >>= s.zerocopy_copied)) return false;
+    }
+    if (props.contains("ConnectionStat::send_method")) {
+        if (!(props["ConnectionStat::send_method"] >>= s.send_method)) return false;
+    }
     return true;
 }
 
@@ -146,6 +395,18 @@ inline void operator<<= (CORBA::Any& a, const ConnectionStat_struct& s) {
     props["ConnectionStat::bytes_per_second"] = s.bytes_per_second;
  
     props["ConnectionStat::bytes_sent"] = s.bytes_sent;
+ 
+    props["ConnectionStat::packets_dropped"] = s.packets_dropped;
+ 
+    props["ConnectionStat::bytes_dropped"] = s.bytes_dropped;
+ 
+    props["ConnectionStat::datagrams_sent"] = s.datagrams_sent;
+ 
+    props["ConnectionStat::zerocopy_sends"] = s.zerocopy_sends;
+ 
+    props["ConnectionStat::zerocopy_copied"] = s.zerocopy_copied;
+ 
+    props["ConnectionStat::send_method"] = s.send_method;
     a <<= props;
 }
 
@@ -160,6 +421,18 @@ inline bool operator== (const ConnectionStat_struct& s1, const ConnectionStat_st
         return false;
     if (s1.bytes_sent!=s2.bytes_sent)
         return false;
+    if (s1.packets_dropped!=s2.packets_dropped)
+        return false;
+    if (s1.bytes_dropped!=s2.bytes_dropped)
+        return false;
+    if (s1.datagrams_sent!=s2.datagrams_sent)
+        return false;
+    if (s1.zerocopy_sends!=s2.zerocopy_sends)
+        return false;
+    if (s1.zerocopy_copied!=s2.zerocopy_copied)
+        return false;
+    if (s1.send_method!=s2.send_method)
+        return false;
     return true;
 }
 
@@ -0,0 +1,285 @@
+/*
+ * This file is protected by Copyright. Please refer to the COPYRIGHT file distributed with this 
+ * source distribution.
+ * 
+ * This file is part of REDHAWK Basic Components sinksocket.
+ * 
+ * REDHAWK Basic Components sinksocket is free software: you can redistribute it and/or modify it under the terms of 
+ * the GNU Lesser General Public License as published by the Free Software Foundation, either 
+ * version 3 of the License, or (at your option) any later version.
+ * 
+ * REDHAWK Basic Components sinksocket is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; 
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR 
+ * PURPOSE.  See the GNU Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public License along with this 
+ * program.  If not, see http://www.gnu.org/licenses/.
+ */
+
+#include "vectorswap.h"
+
+#include <stdint.h>
+#include <string.h>
+
+// Compilers older than these can't build the vector kernels
+// without enabling the instruction sets for the whole file
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define VECTORSWAP_X86 1
+#include <immintrin.h>
+#if defined(__clang__) || __GNUC__ >= 5
+#define VECTORSWAP_AVX512 1
+#endif
+#endif
+
+namespace {
+
+/*
+ * Plain C++ version, used for the tail of every buffer, for
+ * words wider than a vector register, and on CPUs without any
+ * of the vector extensions below
+ */
+void swapScalar(const char* from, char* to, size_t numSwap, unsigned short numBytes)
+{
+	if (numBytes==2)
+	{
+		for (size_t i=0; i!=numSwap; i++)
+		{
+			uint16_t word;
+			memcpy(&word, from, 2);
+			word = bswap_16(word);
+			memcpy(to, &word, 2);
+			from+=2;
+			to+=2;
+		}
+	} else if (numBytes==4)
+	{
+		for (size_t i=0; i!=numSwap; i++)
+		{
+			uint32_t word;
+			memcpy(&word, from, 4);
+			word = bswap_32(word);
+			memcpy(to, &word, 4);
+			from+=4;
+			to+=4;
+		}
+	} else if (numBytes==8)
+	{
+		for (size_t i=0; i!=numSwap; i++)
+		{
+			uint64_t word;
+			memcpy(&word, from, 8);
+			word = bswap_64(word);
+			memcpy(to, &word, 8);
+			from+=8;
+			to+=8;
+		}
+	} else if (from==to)
+	{
+		for (size_t i=0; i!=numSwap; i++)
+		{
+			std::reverse(to, to+numBytes);
+			to+=numBytes;
+		}
+	} else
+	{
+		for (size_t i=0; i!=numSwap; i++)
+		{
+			std::reverse_copy(from, from+numBytes, to);
+			from+=numBytes;
+			to+=numBytes;
+		}
+	}
+}
+
+#ifdef VECTORSWAP_X86
+
+/*
+ * The vector kernels work on 16 byte lanes.  Each lane holds as
+ * many whole words as fit (e.g. 5 words of 3 bytes) and the
+ * shuffle mask reverses each of those words while leaving the
+ * bytes past the last whole word where they are.  Storing the
+ * full lane therefore rewrites those trailing bytes with their
+ * original values, which keeps the kernels correct when swapping
+ * in place; the next lane starts at the first byte that was not
+ * swapped.
+ */
+struct LaneMask
+{
+	unsigned char bytes[16];
+	size_t step;
+};
+
+void buildMask(unsigned short numBytes, LaneMask& mask)
+{
+	size_t wordsPerLane = 16/numBytes;
+	mask.step = wordsPerLane*numBytes;
+	for (size_t i=0; i!=16; i++)
+	{
+		if (i < mask.step)
+		{
+			size_t word = i/numBytes;
+			size_t offset = i%numBytes;
+			mask.bytes[i] = word*numBytes + numBytes-1-offset;
+		} else
+		{
+			mask.bytes[i] = i;
+		}
+	}
+}
+
+__attribute__((target("ssse3")))
+size_t swapSSSE3(const char* from, char* to, size_t totalBytes, const LaneMask& mask)
+{
+	const __m128i shuffle = _mm_loadu_si128(reinterpret_cast<const __m128i*>(mask.bytes));
+	size_t done=0;
+	while (done+16 <= totalBytes)
+	{
+		__m128i lane = _mm_loadu_si128(reinterpret_cast<const __m128i*>(from+done));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(to+done), _mm_shuffle_epi8(lane, shuffle));
+		done+=mask.step;
+	}
+	return done;
+}
+
+__attribute__((target("avx2")))
+size_t swapAVX2(const char* from, char* to, size_t totalBytes, const LaneMask& mask)
+{
+	const __m128i half = _mm_loadu_si128(reinterpret_cast<const __m128i*>(mask.bytes));
+	const __m256i shuffle = _mm256_inserti128_si256(_mm256_castsi128_si256(half), half, 1);
+	size_t done=0;
+
+	if (mask.step==16)
+	{
+		// Whole words fill each lane, so the lanes are contiguous
+		while (done+32 <= totalBytes)
+		{
+			__m256i data = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(from+done));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(to+done), _mm256_shuffle_epi8(data, shuffle));
+			done+=32;
+		}
+	} else
+	{
+		// The second lane starts where the first one's whole words
+		// end, so load and store the lanes separately, in order
+		while (done+mask.step+16 <= totalBytes)
+		{
+			__m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(from+done));
+			__m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(from+done+mask.step));
+			__m256i data = _mm256_shuffle_epi8(_mm256_inserti128_si256(_mm256_castsi128_si256(low), high, 1), shuffle);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(to+done), _mm256_castsi256_si128(data));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(to+done+mask.step), _mm256_extracti128_si256(data, 1));
+			done+=2*mask.step;
+		}
+	}
+
+	_mm256_zeroupper();
+	return done;
+}
+
+#ifdef VECTORSWAP_AVX512
+__attribute__((target("avx512f,avx512bw")))
+size_t swapAVX512(const char* from, char* to, size_t totalBytes, const LaneMask& mask)
+{
+	unsigned char masks[64];
+	for (size_t i=0; i!=64; i++)
+		masks[i] = mask.bytes[i%16];
+	const __m512i shuffle = _mm512_loadu_si512(masks);
+	const __m128i zero = _mm_setzero_si128();
+	size_t done=0;
+
+	if (mask.step==16)
+	{
+		while (done+64 <= totalBytes)
+		{
+			__m512i data = _mm512_loadu_si512(from+done);
+			_mm512_storeu_si512(to+done, _mm512_shuffle_epi8(data, shuffle));
+			done+=64;
+		}
+	} else
+	{
+		const size_t step = mask.step;
+		while (done+3*step+16 <= totalBytes)
+		{
+			__m512i data = _mm512_inserti32x4(_mm512_setzero_si512(), _mm_loadu_si128(reinterpret_cast<const __m128i*>(from+done)), 0);
+			data = _mm512_inserti32x4(data, _mm_loadu_si128(reinterpret_cast<const __m128i*>(from+done+step)), 1);
+			data = _mm512_inserti32x4(data, _mm_loadu_si128(reinterpret_cast<const __m128i*>(from+done+2*step)), 2);
+			data = _mm512_inserti32x4(data, _mm_loadu_si128(reinterpret_cast<const __m128i*>(from+done+3*step)), 3);
+			data = _mm512_shuffle_epi8(data, shuffle);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(to+done), _mm512_mask_extracti32x4_epi32(zero, 0xff, data, 0));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(to+done+step), _mm512_mask_extracti32x4_epi32(zero, 0xff, data, 1));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(to+done+2*step), _mm512_mask_extracti32x4_epi32(zero, 0xff, data, 2));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(to+done+3*step), _mm512_mask_extracti32x4_epi32(zero, 0xff, data, 3));
+			done+=4*step;
+		}
+	}
+
+	_mm256_zeroupper();
+	return done;
+}
+#endif
+
+#endif
+
+typedef size_t (*VectorKernel)(const char*, char*, size_t, const LaneMask&);
+
+struct Dispatch
+{
+	Dispatch() :
+		kernel(NULL),
+		name("scalar")
+	{
+#ifdef VECTORSWAP_X86
+		__builtin_cpu_init();
+#ifdef VECTORSWAP_AVX512
+		if (__builtin_cpu_supports("avx512bw"))
+		{
+			kernel = swapAVX512;
+			name = "avx512";
+		} else
+#endif
+		if (__builtin_cpu_supports("avx2"))
+		{
+			kernel = swapAVX2;
+			name = "avx2";
+		} else if (__builtin_cpu_supports("ssse3"))
+		{
+			kernel = swapSSSE3;
+			name = "ssse3";
+		}
+#endif
+	}
+
+	VectorKernel kernel;
+	const char* name;
+};
+
+// Chosen once, before main, according to what the CPU supports
+const Dispatch dispatch;
+
+}
+
+void byteSwap(const char* from, char* to, size_t numSwap, unsigned short numBytes)
+{
+	if (numBytes<2 || numSwap==0)
+	{
+		if (from!=to)
+			memmove(to, from, numSwap*numBytes);
+		return;
+	}
+
+	size_t done=0;
+#ifdef VECTORSWAP_X86
+	if (dispatch.kernel && numBytes<=16)
+	{
+		LaneMask mask;
+		buildMask(numBytes, mask);
+		done = dispatch.kernel(from, to, numSwap*numBytes, mask);
+	}
+#endif
+	swapScalar(from+done, to+done, numSwap-done/numBytes, numBytes);
+}
+
+const char* byteSwapImplementation()
+{
+	return dispatch.name;
+}
@@ -20,9 +20,24 @@
 #define VECTORSWAP_H_
 
 #include <byteswap.h>
+#include <cassert>
 #include <vector>
 #include <algorithm>
 
+/*
+ * Reverse the bytes of numSwap consecutive words of numBytes
+ * bytes each, reading from 'from' and writing to 'to', which
+ * may be the same buffer.  SSSE3, AVX2 or AVX-512 shuffles are
+ * used when the CPU supports them, for any word size up to 16
+ * bytes; the results are identical to the plain C++ version.
+ */
+void byteSwap(const char* from, char* to, size_t numSwap, unsigned short numBytes);
+
+/*
+ * The name of the byte swap implementation chosen for this CPU
+ */
+const char* byteSwapImplementation();
+
 //in place byte swap
 template<typename T, typename U> void vectorSwap(std::vector<T, U>& dataVec, const unsigned char numBytes)
 {
@@ -30,45 +45,8 @@ template<typename T, typename U> void vectorSwap(std::vector<T, U>& dataVec, con
 	{
 		size_t totalBytes = dataVec.size()*sizeof(T);
 		assert(totalBytes%numBytes==0);
-		size_t numSwap = totalBytes/numBytes;
-		if (numBytes==2)
-		{
-			uint16_t* p = reinterpret_cast< uint16_t* >(&dataVec[0]);
-			for (size_t i=0; i!=numSwap; i++)
-			{
-				*p = bswap_16(*p);
-				p++;
-			}
-		} else if (numBytes==4)
-		{
-			uint32_t* p = reinterpret_cast< uint32_t* >(&dataVec[0]);
-			for (size_t i=0; i!=numSwap; i++)
-			{
-				*p = bswap_32(*p);
-				p++;
-			}
-		} else if(numBytes==8)
-		{
-			uint64_t* p = reinterpret_cast< uint64_t* >(&dataVec[0]);
-			for (size_t i=0; i!=numSwap; i++)
-			{
-				*p = bswap_64(*p);
-				p++;
-			}
-		}else
-		{
-			//explicitly swap all the bytes out by hand if we don't have a good optimized macro available for us
-			char* next = reinterpret_cast< char* >(&dataVec[0]);
-			char* first;
-			char* second;
-			for (size_t i=0; i!=numSwap; i++)
-			{
-				first = next;
-				next = first+numBytes;
-				second = next;
-				std::reverse(first, second);
-			}
-		}
+		char* data = reinterpret_cast< char* >(&dataVec[0]);
+		byteSwap(data, data, totalBytes/numBytes, numBytes);
 	}
 }
 
@@ -79,51 +57,7 @@ template<typename T, typename U> void vectorSwap(const char* data, std::vector<T
 	{
 		size_t totalBytes = outVec.size()*sizeof(T);
 		assert(totalBytes%numBytes==0);
-		size_t numSwap = totalBytes/numBytes;
-		if (numBytes==2)
-		{
-			const uint16_t* from = reinterpret_cast<const uint16_t* >(data);
-			uint16_t* to = reinterpret_cast< uint16_t* >(&outVec[0]);
-			for (size_t i=0; i!=numSwap; i++)
-			{
-				*to = bswap_16(*from);
-				to++;
-				from++;
-			}
-		} else if (numBytes==4)
-		{
-			const uint32_t* from = reinterpret_cast<const uint32_t* >(data);
-			uint32_t* to = reinterpret_cast< uint32_t* >(&outVec[0]);
-			for (size_t i=0; i!=numSwap; i++)
-			{
-				*to = bswap_32(*from);
-				to++;
-				from++;
-			}
-		} else if(numBytes==8)
-		{
-			const uint64_t* from = reinterpret_cast<const uint64_t* >(data);
-			uint64_t* to = reinterpret_cast< uint64_t* >(&outVec[0]);
-			for (size_t i=0; i!=numSwap; i++)
-			{
-				*to = bswap_64(*from);
-				to++;
-				from++;
-			}
-		}else
-		{
-			//explicitly swap all the bytes out by hand if we don't have a good optimized macro available for us
-			const char* next = reinterpret_cast<const char* >(data);
-			const char* first;
-			char* to = reinterpret_cast< char* >(&outVec[0]);
-			for (size_t i=0; i!=numSwap; i++)
-			{
-				first = next;
-				next+=numBytes;
-				std::reverse_copy(first, next, to);
-				to+=numBytes;
-			}
-		}
+		byteSwap(data, reinterpret_cast< char* >(&outVec[0]), totalBytes/numBytes, numBytes);
 	}
 }
 
@@ -0,0 +1,91 @@
+#!/usr/bin/env python
+#
+# This file is protected by Copyright. Please refer to the COPYRIGHT file distributed with this 
+# source distribution.
+# 
+# This file is part of REDHAWK Basic Components sinksocket.
+# 
+# REDHAWK Basic Components sinksocket is free software: you can redistribute it and/or modify it under the terms of 
+# the GNU Lesser General Public License as published by the Free Software Foundation, either 
+# version 3 of the License, or (at your option) any later version.
+# 
+# REDHAWK Basic Components sinksocket is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; 
+# without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR 
+# PURPOSE.  See the GNU Lesser General Public License for more details.
+# 
+# You should have received a copy of the GNU Lesser General Public License along with this 
+# program.  If not, see http://www.gnu.org/licenses/.
+#
+
+"""
+Compare the throughput of the asio and io_uring send engines over
+loopback.  Each run launches a sinksocket with the given engine,
+connects a reader to each of its server ports, and times how long
+it takes every reader to receive the same data.
+
+    python benchmark_send_engine.py [connections] [packet bytes] [total MiB]
+"""
+
+import socket
+import sys
+import threading
+import time
+
+from ossie.utils import sb
+
+PORT = 8745
+
+def drain(sock, total, results, index):
+    received = 0
+    while received < total:
+        data = sock.recv(1024*1024)
+        if not data:
+            break
+        received += len(data)
+    results[index] = received
+
+def run(engine, connections, packetBytes, totalBytes):
+    comp = sb.launch('../sinksocket.spd.xml', properties={'send_engine' : engine})
+    src = sb.DataSource(dataFormat='octet')
+    src.connect(comp, 'dataOctet_in')
+    comp.Connections = [{'connection_type' : 'server',
+                         'ports' : [PORT + i for i in xrange(connections)],
+                         'byte_swap' : [0] * connections}]
+    sb.start()
+
+    socks = []
+    for i in xrange(connections):
+        sock = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+        sock.connect(('127.0.0.1', PORT + i))
+        socks.append(sock)
+    time.sleep(.5)
+
+    packets = totalBytes / packetBytes
+    packet = [1] * packetBytes
+    results = [0] * connections
+    readers = [threading.Thread(target=drain, args=(sock, packets * packetBytes, results, i)) for i, sock in enumerate(socks)]
+    for reader in readers:
+        reader.start()
+
+    start = time.time()
+    for _ in xrange(packets):
+        src.push(packet, False, "benchmark", 1.0)
+    for reader in readers:
+        reader.join()
+    elapsed = time.time() - start
+
+    sb.stop()
+    for sock in socks:
+        sock.close()
+    comp.releaseObject()
+    src.releaseObject()
+
+    return sum(results) / elapsed / 1e6
+
+if __name__ == "__main__":
+    connections = int(sys.argv[1]) if len(sys.argv) > 1 else 4
+    packetBytes = int(sys.argv[2]) if len(sys.argv) > 2 else 16384
+    totalBytes = (int(sys.argv[3]) if len(sys.argv) > 3 else 256) * 1024 * 1024
+
+    for engine in ('asio', 'io_uring'):
+        print "%-8s %d connections, %d byte packets: %.1f MB/s" % (engine, connections, packetBytes, run(engine, connections, packetBytes, totalBytes))
@@ -0,0 +1,184 @@
+/*
+ * This file is protected by Copyright. Please refer to the COPYRIGHT file distributed with this
+ * source distribution.
+ *
+ * This file is part of REDHAWK Basic Components sinksocket.
+ *
+ * REDHAWK Basic Components sinksocket is free software: you can redistribute it and/or modify it under the terms of
+ * the GNU Lesser General Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * REDHAWK Basic Components sinksocket is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with this
+ * program.  If not, see http://www.gnu.org/licenses/.
+ */
+
+/*
+ * Exercises the file table of IoUringSender.h directly, since a
+ * socket closing while a batch is open is hard to arrange
+ * through the component.  test_sinksocket.py builds and runs it:
+ *
+ *   g++ -DHAVE_LINUX_IO_URING_H -DHAVE_DECL_IORING_OP_SENDMSG=1 \
+ *       -DHAVE_DECL_IORING_REGISTER_FILES_UPDATE=1 -DHAVE_DECL_IORING_FEAT_SINGLE_MMAP=1 \
+ *       -DHAVE_STRUCT_IO_URING_FILES_UPDATE -I../cpp test_io_uring_sender.cpp -o test_io_uring_sender \
+ *       -lboost_thread -lboost_system -lpthread
+ *
+ * Prints one line per failed check and exits non-zero if any
+ * failed, or exits with 77 if io_uring isn't available.
+ */
+
+#include "IoUringSender.h"
+
+#include <cstdio>
+#include <fcntl.h>
+#include <poll.h>
+
+namespace {
+
+int failures = 0;
+
+void check(bool condition, const std::string& message)
+{
+	if (!condition) {
+		std::printf("FAIL: %s\n", message.c_str());
+		failures++;
+	}
+}
+
+/*
+ * Remembers how a write finished
+ */
+struct Result
+{
+	Result() :
+		done(false)
+	{}
+
+	void operator()(const boost::system::error_code& error)
+	{
+		boost::mutex::scoped_lock lock(mutex);
+		this->error = error;
+		done = true;
+		finished.notify_all();
+	}
+
+	bool wait()
+	{
+		boost::mutex::scoped_lock lock(mutex);
+		boost::system_time deadline = boost::get_system_time() + boost::posix_time::seconds(5);
+		while (!done)
+			if (!finished.timed_wait(lock, deadline))
+				return false;
+		return true;
+	}
+
+	boost::mutex mutex;
+	boost::condition_variable finished;
+	boost::system::error_code error;
+	bool done;
+};
+
+/*
+ * Everything that arrives on fd within a short while
+ */
+std::string receive(int fd)
+{
+	std::string received;
+	char buffer[256];
+	struct pollfd ready;
+	ready.fd = fd;
+	ready.events = POLLIN;
+
+	while (poll(&ready, 1, 200) > 0) {
+		ssize_t size = recv(fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+		if (size <= 0)
+			break;
+		received.append(buffer, size);
+	}
+
+	return received;
+}
+
+std::vector<boost::asio::const_buffer> buffers(const std::string& data)
+{
+	return std::vector<boost::asio::const_buffer>(1, boost::asio::buffer(data));
+}
+
+/*
+ * A write queued in a batch to a socket that closes before the
+ * batch ends must not go out on the socket registered after it
+ */
+void testCloseInBatch(IoUringSender& engine)
+{
+	int stale[2];
+	int fresh[2];
+	socketpair(AF_UNIX, SOCK_STREAM, 0, stale);
+	socketpair(AF_UNIX, SOCK_STREAM, 0, fresh);
+
+	unsigned staleGeneration = 0;
+	unsigned freshGeneration = 0;
+	std::string staleData("stale data");
+	std::string freshData("fresh data");
+	Result staleResult;
+	Result freshResult;
+
+	int staleSlot = engine.registerFile(stale[0], staleGeneration);
+	check(staleSlot >= 0, "register the first socket");
+
+	engine.beginBatch();
+	engine.async_write(staleSlot, staleGeneration, buffers(staleData), boost::ref(staleResult));
+
+	engine.unregisterFile(staleSlot);
+	::close(stale[0]);
+
+	int freshSlot = engine.registerFile(fresh[0], freshGeneration);
+	check(freshSlot >= 0 && freshSlot != staleSlot, "slot with a queued write not handed out again");
+
+	engine.async_write(freshSlot, freshGeneration, buffers(freshData), boost::ref(freshResult));
+	engine.endBatch();
+
+	check(staleResult.wait() && staleResult.error, "write to the closed socket fails");
+	check(freshResult.wait() && !freshResult.error, "write to the new socket succeeds");
+	check(receive(fresh[1]) == freshData, "new socket gets only its own data");
+
+	// Once nothing refers to it, the slot is free again
+	int other[2];
+	socketpair(AF_UNIX, SOCK_STREAM, 0, other);
+	unsigned otherGeneration = 0;
+	int otherSlot = engine.registerFile(other[0], otherGeneration);
+	check(otherSlot == staleSlot, "slot reused after its writes completed");
+
+	Result otherResult;
+	engine.async_write(otherSlot, otherGeneration, buffers(freshData), boost::ref(otherResult));
+	check(otherResult.wait() && !otherResult.error && receive(other[1]) == freshData, "reused slot writes to its new socket");
+
+	engine.unregisterFile(otherSlot);
+	engine.unregisterFile(freshSlot);
+	::close(stale[1]);
+	::close(fresh[0]);
+	::close(fresh[1]);
+	::close(other[0]);
+	::close(other[1]);
+}
+
+}
+
+int main()
+{
+	IoUringSender engine;
+	if (!engine.start(8, 4)) {
+		std::printf("SKIP: io_uring is not available\n");
+		return 77;
+	}
+
+	testCloseInBatch(engine);
+	engine.stop();
+
+	if (failures == 0)
+		std::printf("OK\n");
+
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,227 @@
+/*
+ * This file is protected by Copyright. Please refer to the COPYRIGHT file distributed with this
+ * source distribution.
+ *
+ * This file is part of REDHAWK Basic Components sinksocket.
+ *
+ * REDHAWK Basic Components sinksocket is free software: you can redistribute it and/or modify it under the terms of
+ * the GNU Lesser General Public License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * REDHAWK Basic Components sinksocket is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with this
+ * program.  If not, see http://www.gnu.org/licenses/.
+ */
+
+/*
+ * Exercises ShmRing.h on its own, the way a reader in another
+ * process would use it.  test_sinksocket.py builds and runs it:
+ *
+ *   g++ -I../cpp test_shm_ring.cpp -o test_shm_ring -lpthread -lrt
+ *
+ * Prints one line per failed check and exits non-zero if any
+ * failed.
+ */
+
+#include "ShmRing.h"
+
+#include <cstdio>
+#include <sstream>
+#include <pthread.h>
+#include <sys/wait.h>
+
+namespace {
+
+const char* RING_NAME = "/sinksocket_test_ring";
+const boost::uint64_t PACKETS = 20000;
+const int READERS = 4;
+
+int failures = 0;
+
+void check(bool condition, const std::string& message)
+{
+	if (!condition) {
+		std::printf("FAIL: %s\n", message.c_str());
+		failures++;
+	}
+}
+
+/*
+ * Packet n starts with n and is filled with bytes derived from
+ * it, so a reader can tell a torn or misplaced copy
+ */
+void makePacket(boost::uint64_t n, std::vector<char>& data)
+{
+	data.resize(sizeof(n) + n % 300);
+	memcpy(&data[0], &n, sizeof(n));
+
+	for (size_t i = sizeof(n); i < data.size(); ++i)
+		data[i] = char(n + i);
+}
+
+struct Reader
+{
+	bool slow;
+	bool opened;
+	boost::uint64_t received;
+	boost::uint64_t last;
+	boost::uint64_t lost;
+	boost::uint64_t bad;
+};
+
+void* readPackets(void* argument)
+{
+	Reader* reader = static_cast<Reader*>(argument);
+	ShmRingReader ring;
+	std::vector<char> data;
+
+	reader->opened = ring.open(RING_NAME);
+
+	while (ring.is_open()) {
+		if (!ring.read(data)) {
+			if (!ring.wait(500))
+				break;
+			continue;
+		}
+
+		boost::uint64_t n = 0;
+		if (data.size() >= sizeof(n))
+			memcpy(&n, &data[0], sizeof(n));
+
+		std::vector<char> expected;
+		makePacket(n, expected);
+
+		if (data != expected || n != ring.sequence() || (reader->received && n <= reader->last))
+			reader->bad++;
+
+		reader->received++;
+		reader->last = n;
+
+		if (n == PACKETS - 1)
+			break;
+
+		// Fall far enough behind every so often to be overrun
+		if (reader->slow && reader->received % 50 == 0)
+			usleep(20000);
+	}
+
+	reader->lost = ring.lost();
+	return NULL;
+}
+
+/*
+ * Several readers share a ring while it is written, the slow one
+ * being overrun, and each must see every packet intact and in
+ * order or count it as lost
+ */
+void testConcurrentReaders()
+{
+	ShmRingWriter writer;
+	check(writer.create(RING_NAME, 1024*1024), "create ring");
+
+	struct stat status;
+	int fd = shm_open(RING_NAME, O_RDONLY, 0);
+	check(fd >= 0 && fstat(fd, &status) == 0 && (status.st_mode & 0777) == 0600, "ring is private to its user");
+	if (fd >= 0)
+		::close(fd);
+
+	Reader readers[READERS];
+	pthread_t threads[READERS];
+	for (int i = 0; i < READERS; ++i) {
+		memset(&readers[i], 0, sizeof(Reader));
+		readers[i].slow = (i == READERS - 1);
+		pthread_create(&threads[i], NULL, readPackets, &readers[i]);
+	}
+
+	usleep(100000);
+
+	std::vector<char> data;
+	for (boost::uint64_t n = 0; n < PACKETS; ++n) {
+		makePacket(n, data);
+		writer.write(&data[0], data.size());
+
+		if (n % 64 == 0)
+			usleep(200);
+	}
+
+	for (int i = 0; i < READERS; ++i) {
+		pthread_join(threads[i], NULL);
+
+		std::ostringstream name;
+		name << (readers[i].slow ? "slow" : "fast") << " reader " << i << " received " << readers[i].received << " lost " << readers[i].lost << " bad " << readers[i].bad;
+
+		check(readers[i].opened, name.str() + ": opened");
+		check(readers[i].bad == 0, name.str() + ": intact and in order");
+		check(readers[i].received + readers[i].lost == readers[i].last + 1, name.str() + ": lost count accounts for every packet");
+		check(readers[i].slow || readers[i].last == PACKETS - 1, name.str() + ": reached the last packet");
+		check(readers[i].slow ? readers[i].lost > 0 : readers[i].lost == 0, name.str() + ": overrun only when slow");
+	}
+
+	std::vector<char> huge(2*1024*1024);
+	check(!writer.write(&huge[0], huge.size()) && writer.dropped_packets() == 1, "packet larger than the ring dropped");
+
+	writer.close();
+	check(!ShmRingReader().open(RING_NAME), "ring removed on close");
+}
+
+/*
+ * A name belongs to the ring using it until its writer exits
+ */
+void testTakeover()
+{
+	ShmRingWriter first;
+	check(first.create(RING_NAME, 4096), "create first ring");
+
+	ShmRingWriter second;
+	check(!second.create(RING_NAME, 4096) && errno == EEXIST, "live ring not replaced");
+
+	ShmRingReader reader;
+	check(reader.open(RING_NAME), "open live ring");
+
+	std::vector<char> data, received;
+	makePacket(1, data);
+	first.write(&data[0], data.size());
+	check(reader.read(received) && received == data, "live ring still written");
+	reader.close();
+	first.close();
+
+	// A writer that dies leaves its ring behind for the next one
+	pid_t child = fork();
+	if (child == 0) {
+		ShmRingWriter orphan;
+		_exit(orphan.create(RING_NAME, 4096) ? 0 : 1);
+	}
+
+	int status = -1;
+	waitpid(child, &status, 0);
+	check(WIFEXITED(status) && WEXITSTATUS(status) == 0, "create orphaned ring");
+	check(second.create(RING_NAME, 4096), "orphaned ring replaced");
+	second.close();
+
+	// Anything that isn't a ring is left alone
+	int fd = shm_open(RING_NAME, O_CREAT | O_EXCL | O_RDWR, 0600);
+	check(fd >= 0 && ftruncate(fd, 4096) == 0, "create other segment");
+	if (fd >= 0)
+		::close(fd);
+
+	check(!second.create(RING_NAME, 4096) && errno == EEXIST, "other segment not replaced");
+	shm_unlink(RING_NAME);
+}
+
+}
+
+int main()
+{
+	shm_unlink(RING_NAME);
+
+	testConcurrentReaders();
+	testTakeover();
+
+	if (failures == 0)
+		std::printf("OK\n");
+
+	return failures ? 1 : 0;
+}
@@ -25,7 +25,11 @@ import os
 from omniORB import any
 from ossie.utils import sb
 
+import ctypes
+import mmap
+import socket
 import struct
+import subprocess
 import time
 import traceback
 
@@ -60,11 +64,25 @@ def flip(dataStr,numBytes):
 
     return out              
 
+def ioUringAvailable():
+    """
+    Whether the kernel lets this process set up an io_uring
+    """
+    libc = ctypes.CDLL(None, use_errno=True)
+    params = ctypes.create_string_buffer(120)
+    fd = libc.syscall(425, 1, params)
+    if fd < 0:
+        return False
+    os.close(fd)
+    return True
+
 class ComponentTests(ossie.utils.testing.ScaComponentTestCase):
     """
     Test for all component implementations in sinksocket
     """
     PORT = 8645
+    OVERFLOW_PACKETS = 200
+    OVERFLOW_PACKET_SIZE = 65536
     OCTET_DATA = [range(256)*100]
     CHAR_DATA = [range(-128,128)*100]
     U_SHORT_DATA = [range(i*16384,(i+1)*16384) for i in xrange(4)]
@@ -570,6 +588,971 @@ class ComponentTests(ossie.utils.testing.ScaComponentTestCase):
         f= flip(so,SWAP)
         self.assertEqual(s[:len(f)],f)
     
+    #Tests for bounded send queues.  Connect a socket that never
+    #reads and make sure data gets dropped instead of queued forever
+    def testOverflowDropNewest(self):
+        stalled = self.runOverflowTest('drop_newest')
+
+        # What was queued before the queue filled arrives, and
+        # everything pushed after that is gone
+        packets = self.receiveOverflowPackets(stalled)
+        self.assertTrue(len(packets) > 0)
+        self.assertEquals(packets, range(len(packets)))
+        self.assertTrue(len(packets) < self.OVERFLOW_PACKETS)
+
+    def testOverflowDropOldest(self):
+        stalled = self.runOverflowTest('drop_oldest')
+
+        # Older packets make room for newer ones, so the last one
+        # pushed arrives
+        packets = self.receiveOverflowPackets(stalled)
+        self.assertEquals(packets, sorted(set(packets)))
+        self.assertEquals(packets[-1], self.OVERFLOW_PACKETS - 1)
+        self.assertTrue(len(packets) < self.OVERFLOW_PACKETS)
+
+    def testOverflowConflate(self):
+        stalled = self.runOverflowTest('conflate')
+
+        # The whole queue makes way for the newest packet
+        packets = self.receiveOverflowPackets(stalled)
+        self.assertEquals(packets, sorted(set(packets)))
+        self.assertEquals(packets[-1], self.OVERFLOW_PACKETS - 1)
+        self.assertTrue(len(packets) < self.OVERFLOW_PACKETS)
+
+    def testOverflowDisconnect(self):
+        stalled = self.runOverflowTest('disconnect')
+
+        # The component should have closed the socket, so after
+        # draining what was sent the peer sees end of file
+        stalled.setblocking(1)
+        stalled.settimeout(5.0)
+        while stalled.recv(65536):
+            pass
+
+    #Statistics are published periodically rather than per packet
+    def testStatsPeriod(self):
+        self.src.connect(self.sinkSocket, 'dataOctet_in')
+        self.sinkSocket.stats_period = 0.1
+        self.sinkSocket.Connections = [{'connection_type' : 'server', 'ports' : [self.PORT], 'byte_swap' : [0]}]
+
+        self.src.start()
+        self.sinkSocket.start()
+
+        reader = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+        reader.connect(('127.0.0.1', self.PORT))
+        time.sleep(.1)
+
+        for _ in xrange(10):
+            self.src.push(range(256)*4, False, "test stream", 1.0)
+
+        received = 0
+        reader.settimeout(5.0)
+        while received < 10*1024:
+            received += len(reader.recv(65536))
+
+        time.sleep(.5)
+
+        stats = self.sinkSocket.ConnectionStats
+        self.assertEquals(stats[0].status, 'connected')
+        self.assertEquals(stats[0].bytes_sent, 10*1024)
+        self.assertEquals(self.sinkSocket.total_bytes, 10*1024)
+        reader.close()
+
+    #Packets queued while the component is stopped are sent in
+    #batches, in order, without joining different streams
+    def testBatchStreams(self):
+        self.src.connect(self.sinkSocket, 'dataOctet_in')
+        self.sinkSocket.Connections = [{'connection_type' : 'server', 'ports' : [self.PORT], 'byte_swap' : [0]}]
+
+        reader = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+        reader.connect(('127.0.0.1', self.PORT))
+        reader.settimeout(5.0)
+        self.src.start()
+        time.sleep(.1)
+
+        expected = []
+        for i in xrange(60):
+            data = range(i, i+10)
+            self.src.push(data, i % 20 == 19, "stream %d" % (i/5 % 2), 1000.0)
+            expected += data
+
+        time.sleep(.5)
+        self.sinkSocket.start()
+
+        received = ''
+        while len(received) < len(expected):
+            received += reader.recv(65536)
+        self.assertEquals([ord(x) for x in received], expected)
+        reader.close()
+
+    #With worker threads, each port of a server is written as a job
+    #of its own, and every port still gets the same data
+    def testWorkerThreads(self):
+        self.src.connect(self.sinkSocket, 'dataFloat_in')
+        self.sinkSocket.worker_threads = 3
+        ports = range(self.PORT, self.PORT+4)
+        self.sinkSocket.Connections = [{'connection_type' : 'server', 'ports' : ports, 'byte_swap' : [0, 0, 4, 0]}]
+
+        self.src.start()
+        self.sinkSocket.start()
+
+        readers = []
+        for port in ports:
+            reader = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+            reader.connect(('127.0.0.1', port))
+            reader.settimeout(5.0)
+            readers.append(reader)
+        time.sleep(.1)
+
+        expected = ''
+        for i in xrange(20):
+            data = [float(x) for x in range(i*1000, (i+1)*1000)]
+            self.src.push(data, False, "test stream", 1000.0)
+            expected += toStr(data, 'float')
+
+        for i, reader in enumerate(readers):
+            received = ''
+            while len(received) < len(expected):
+                received += reader.recv(65536)
+            if i == 2:
+                received = flip(received, 4)
+            self.assertEquals(received, expected)
+            reader.close()
+
+    #A client whose peer is down keeps retrying in the background
+    def testReconnect(self):
+        self.src.connect(self.sinkSocket, 'dataOctet_in')
+        self.sinkSocket.stats_period = 0.1
+        self.sinkSocket.Connections = [{'connection_type' : 'client', 'ip_address' : '127.0.0.1', 'ports' : [self.PORT], 'byte_swap' : [0], 'reconnect_min_delay' : 50, 'reconnect_max_delay' : 200}]
+
+        self.src.start()
+        self.sinkSocket.start()
+
+        start = time.time()
+        for _ in xrange(100):
+            self.src.push(range(256), False, "test stream", 1.0)
+        self.assertTrue(time.time() - start < 1.0)
+
+        time.sleep(.5)
+        self.assertEquals(self.sinkSocket.ConnectionStats[0].status, 'reconnecting')
+
+        listener = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+        listener.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        listener.bind(('127.0.0.1', self.PORT))
+        listener.listen(1)
+        listener.settimeout(5.0)
+        peer, _ = listener.accept()
+
+        time.sleep(.5)
+        self.assertEquals(self.sinkSocket.ConnectionStats[0].status, 'connected')
+        peer.close()
+        listener.close()
+
+    #A client looks up a host name and keeps using the addresses it
+    #found when it reconnects
+    def testResolveHostName(self):
+        listener = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+        listener.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        listener.bind(('127.0.0.1', self.PORT))
+        listener.listen(1)
+        listener.settimeout(5.0)
+
+        self.src.connect(self.sinkSocket, 'dataOctet_in')
+        self.sinkSocket.stats_period = 0.1
+        self.sinkSocket.Connections = [{'connection_type' : 'client', 'ip_address' : 'localhost', 'ports' : [self.PORT], 'byte_swap' : [0], 'reconnect_min_delay' : 50, 'reconnect_max_delay' : 200}]
+
+        self.src.start()
+        self.sinkSocket.start()
+
+        for attempt in xrange(2):
+            peer, _ = listener.accept()
+            peer.settimeout(5.0)
+
+            self.src.push(range(256), False, "test stream", 1.0)
+            received = ''
+            while len(received) < 256:
+                received += peer.recv(65536)
+            self.assertEquals([ord(x) for x in received], range(256))
+
+            time.sleep(.5)
+            stats = self.sinkSocket.ConnectionStats
+            self.assertEquals(stats[0].status, 'connected')
+            self.assertEquals(stats[0].ip_address, 'localhost')
+
+            # Writing to the closed peer makes the client reconnect
+            peer.close()
+            for _ in xrange(5):
+                self.src.push(range(256), False, "test stream", 1.0)
+                time.sleep(.1)
+
+        listener.close()
+
+    #A host name that can't be looked up never holds up the data path
+    def testUnresolvableHostName(self):
+        self.src.connect(self.sinkSocket, 'dataOctet_in')
+        self.sinkSocket.stats_period = 0.1
+        self.sinkSocket.Connections = [{'connection_type' : 'client', 'ip_address' : 'no-such-host.invalid', 'ports' : [self.PORT], 'byte_swap' : [0], 'reconnect_min_delay' : 50, 'reconnect_max_delay' : 200}]
+
+        self.src.start()
+        self.sinkSocket.start()
+
+        start = time.time()
+        for _ in xrange(100):
+            self.src.push(range(256), False, "test stream", 1.0)
+        self.assertTrue(time.time() - start < 1.0)
+
+        time.sleep(.5)
+        self.assertEquals(self.sinkSocket.ConnectionStats[0].status, 'reconnecting')
+
+    #The socket options of a connection are applied to every
+    #session a server accepts
+    def testSocketOptions(self):
+        self.src.connect(self.sinkSocket, 'dataOctet_in')
+        self.sinkSocket.Connections = [{'connection_type' : 'server', 'ports' : [self.PORT], 'byte_swap' : [0], 'send_buffer_size' : 65536, 'tcp_congestion' : 'reno'}]
+
+        self.src.start()
+        self.sinkSocket.start()
+
+        reader = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+        reader.connect(('127.0.0.1', self.PORT))
+        time.sleep(.1)
+
+        try:
+            info = subprocess.check_output(['ss', '-tmin', 'state', 'established', 'sport', '=', ':%d' % self.PORT])
+        except (OSError, subprocess.CalledProcessError):
+            reader.close()
+            self.skipTest('ss is not available')
+
+        # The kernel doubles the requested send buffer
+        self.assertTrue('tb131072' in info)
+        self.assertTrue(' reno ' in info)
+        reader.close()
+
+    #A corked connection still sends the tail of a burst as soon as
+    #its send queue empties, instead of waiting for the cork timeout
+    def testCorkFlush(self):
+        self.src.connect(self.sinkSocket, 'dataOctet_in')
+        self.sinkSocket.Connections = [{'connection_type' : 'server', 'ports' : [self.PORT], 'byte_swap' : [0], 'tcp_cork' : True, 'tcp_nodelay' : True}]
+
+        self.src.start()
+        self.sinkSocket.start()
+
+        reader = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+        reader.connect(('127.0.0.1', self.PORT))
+        reader.settimeout(5.0)
+        time.sleep(.1)
+
+        for i in xrange(5):
+            start = time.time()
+            self.src.push(range(i, 10+i), False, "test stream", 1.0)
+            received = ''
+            while len(received) < 10:
+                received += reader.recv(65536)
+            self.assertEquals([ord(x) for x in received], range(i, 10+i))
+            self.assertTrue(time.time() - start < 0.15)
+        reader.close()
+
+    #Packets larger than the MTU are split into datagrams that
+    #carry their sequence number and offset
+    def testUdp(self):
+        reader = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        reader.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 1024*1024)
+        reader.bind(('127.0.0.1', self.PORT))
+        reader.settimeout(5.0)
+
+        self.src.connect(self.sinkSocket, 'dataOctet_in')
+        self.sinkSocket.stats_period = 0.1
+        self.sinkSocket.Connections = [{'connection_type' : 'udp', 'ip_address' : '127.0.0.1', 'ports' : [self.PORT], 'byte_swap' : [0], 'mtu' : 1500}]
+
+        self.src.start()
+        self.sinkSocket.start()
+        time.sleep(.1)
+
+        self.src.push(range(256)*40, False, "test stream", 1.0)
+
+        received = ''
+        sequence = 0
+        while len(received) < 256*40:
+            datagram = reader.recv(65536)
+            self.assertTrue(len(datagram) <= 1500-28)
+            header = struct.unpack('>IIII', datagram[:16])
+            self.assertEquals(header, (sequence, 0, len(received), 256*40))
+            received += datagram[16:]
+            sequence += 1
+
+        self.assertEquals([ord(x) for x in received], range(256)*40)
+
+        time.sleep(.5)
+
+        stats = self.sinkSocket.ConnectionStats
+        self.assertEquals(stats[0].status, 'connected')
+        self.assertEquals(stats[0].datagrams_sent, sequence)
+        self.assertEquals(stats[0].bytes_sent, 256*40)
+        reader.close()
+
+    def testUdpGso(self):
+        self.udpSegmentation(True)
+
+    def testUdpGsoOff(self):
+        self.udpSegmentation(False)
+
+    def udpSegmentation(self, gso):
+        readers = []
+        for port in (self.PORT, self.PORT+1):
+            reader = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+            reader.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 1024*1024)
+            reader.bind(('127.0.0.1', port))
+            reader.settimeout(5.0)
+            readers.append(reader)
+
+        self.src.connect(self.sinkSocket, 'dataOctet_in')
+        self.sinkSocket.Connections = [{'connection_type' : 'udp', 'ip_address' : '127.0.0.1', 'ports' : [self.PORT, self.PORT+1], 'byte_swap' : [0, 2], 'mtu' : 1500, 'udp_gso' : gso}]
+
+        self.src.start()
+        self.sinkSocket.start()
+        time.sleep(.1)
+
+        # With GSO, each packet goes to the kernel as a few runs of
+        # datagrams, which must still arrive as separate datagrams,
+        # in order, just as they do without it
+        data = range(256)*400
+        self.src.push(data, False, "test stream", 1.0)
+        expected = toStr(data, 'octet')
+
+        for reader, swap in zip(readers, (1, 2)):
+            received = ''
+            sequence = 0
+            while len(received) < len(expected):
+                datagram = reader.recv(65536)
+                self.assertTrue(len(datagram) <= 1500-28)
+                header = struct.unpack('>IIII', datagram[:16])
+                self.assertEquals(header, (sequence, 0, len(received), len(expected)))
+                received += datagram[16:]
+                sequence += 1
+            self.assertEquals(received, flip(expected, swap) if swap > 1 else expected)
+            reader.close()
+
+        # The kernel took the runs, rather than GSO having been
+        # turned off after the first send
+        time.sleep(1.0)
+        stats = self.sinkSocket.ConnectionStats
+        self.assertEquals([stat.send_method for stat in stats], ['sendmmsg+gso' if gso else 'sendmmsg']*2)
+        self.assertEquals([stat.datagrams_sent for stat in stats], [sequence]*2)
+
+    #Every receiver that joined the group gets the same datagrams,
+    #here over the loopback interface
+    def testMulticast(self):
+        group = '239.255.10.1'
+        readers = []
+        for _ in xrange(3):
+            reader = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+            reader.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+            reader.bind(('', self.PORT))
+            reader.setsockopt(socket.IPPROTO_IP, socket.IP_ADD_MEMBERSHIP, socket.inet_aton(group) + socket.inet_aton('127.0.0.1'))
+            reader.settimeout(5.0)
+            readers.append(reader)
+
+        self.src.connect(self.sinkSocket, 'dataOctet_in')
+        self.sinkSocket.stats_period = 0.1
+        self.sinkSocket.Connections = [{'connection_type' : 'multicast', 'ip_address' : group, 'ports' : [self.PORT], 'byte_swap' : [0], 'multicast_interface' : '127.0.0.1', 'multicast_ttl' : 0, 'multicast_loopback' : True}]
+
+        self.src.start()
+        self.sinkSocket.start()
+        time.sleep(.1)
+
+        self.src.push(range(256)*20, False, "test stream", 1.0)
+
+        for reader in readers:
+            received = ''
+            while len(received) < 256*20:
+                received += reader.recv(65536)[16:]
+            self.assertEquals([ord(x) for x in received], range(256)*20)
+            reader.close()
+
+        time.sleep(.5)
+
+        stats = self.sinkSocket.ConnectionStats
+        self.assertEquals(stats[0].status, 'connected')
+        self.assertEquals(stats[0].bytes_sent, 256*20)
+
+    #Local consumers can read from Unix domain sockets, where a
+    #seqpacket socket gets every packet as one message
+    def testUnixServer(self):
+        self.src.connect(self.sinkSocket, 'dataOctet_in')
+        self.sinkSocket.Connections = [{'connection_type' : 'unix_server', 'ip_address' : '@sinksocket_test', 'ports' : [self.PORT], 'byte_swap' : [0], 'unix_socket_type' : 'stream'},
+                                       {'connection_type' : 'unix_server', 'ip_address' : '@sinksocket_test_seq', 'ports' : [self.PORT], 'byte_swap' : [0], 'unix_socket_type' : 'seqpacket'}]
+
+        self.src.start()
+        self.sinkSocket.start()
+
+        stream = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        stream.connect('\0sinksocket_test.%d' % self.PORT)
+        seqpacket = socket.socket(socket.AF_UNIX, socket.SOCK_SEQPACKET)
+        seqpacket.connect('\0sinksocket_test_seq.%d' % self.PORT)
+        time.sleep(.1)
+
+        packets = [[(i+j) % 256 for j in xrange(100+10*i)] for i in xrange(10)]
+        for packet in packets:
+            self.src.push(packet, False, "test stream", 1.0)
+
+        received = ''
+        stream.settimeout(5.0)
+        while len(received) < sum(len(x) for x in packets):
+            received += stream.recv(65536)
+        self.assertEquals([ord(x) for x in received], sum(packets, []))
+
+        # Every packet arrives as a message of its own
+        seqpacket.settimeout(5.0)
+        for packet in packets:
+            self.assertEquals([ord(x) for x in seqpacket.recv(65536)], packet)
+
+        stream.close()
+        seqpacket.close()
+
+    def testUnixClient(self):
+        listeners = []
+        for name, socketType in (('sinksocket_test', socket.SOCK_STREAM), ('sinksocket_test_seq', socket.SOCK_SEQPACKET)):
+            listener = socket.socket(socket.AF_UNIX, socketType)
+            listener.bind('\0%s.%d' % (name, self.PORT))
+            listener.listen(1)
+            listener.settimeout(5.0)
+            listeners.append(listener)
+
+        self.src.connect(self.sinkSocket, 'dataOctet_in')
+        self.sinkSocket.Connections = [{'connection_type' : 'unix_client', 'ip_address' : '@sinksocket_test', 'ports' : [self.PORT], 'byte_swap' : [0], 'unix_socket_type' : 'stream'},
+                                       {'connection_type' : 'unix_client', 'ip_address' : '@sinksocket_test_seq', 'ports' : [self.PORT], 'byte_swap' : [0], 'unix_socket_type' : 'seqpacket'}]
+
+        self.src.start()
+        self.sinkSocket.start()
+
+        stream, _ = listeners[0].accept()
+        seqpacket, _ = listeners[1].accept()
+        time.sleep(.1)
+
+        packets = [[(i+j) % 256 for j in xrange(100+10*i)] for i in xrange(10)]
+        for packet in packets:
+            self.src.push(packet, False, "test stream", 1.0)
+
+        received = ''
+        stream.settimeout(5.0)
+        while len(received) < sum(len(x) for x in packets):
+            received += stream.recv(65536)
+        self.assertEquals([ord(x) for x in received], sum(packets, []))
+
+        seqpacket.settimeout(5.0)
+        for packet in packets:
+            self.assertEquals([ord(x) for x in seqpacket.recv(65536)], packet)
+
+        stream.close()
+        seqpacket.close()
+        for listener in listeners:
+            listener.close()
+
+    #A socket file left behind by an earlier run is replaced, but a
+    #live server's socket is never taken over
+    def testUnixSocketFile(self):
+        path = '/tmp/sinksocket_test.%d' % self.PORT
+        if os.path.exists(path):
+            os.unlink(path)
+
+        live = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        live.bind(path)
+        live.listen(1)
+        live.settimeout(5.0)
+
+        self.sinkSocket.stats_period = 0.1
+        self.sinkSocket.Connections = [{'connection_type' : 'unix_server', 'ip_address' : '/tmp/sinksocket_test', 'ports' : [self.PORT], 'byte_swap' : [0]}]
+
+        # The path still leads to the live listener
+        client = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        client.connect(path)
+        peer, _ = live.accept()
+        peer.close()
+        client.close()
+
+        # Closing the listener leaves its file behind
+        live.close()
+        self.assertTrue(os.path.exists(path))
+
+        self.sinkSocket.Connections = []
+        self.sinkSocket.Connections = [{'connection_type' : 'unix_server', 'ip_address' : '/tmp/sinksocket_test', 'ports' : [self.PORT], 'byte_swap' : [0]}]
+
+        client = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        client.connect(path)
+        time.sleep(.5)
+        self.assertEquals(self.sinkSocket.ConnectionStats[0].status, 'connected')
+        client.close()
+        self.sinkSocket.Connections = []
+
+    def testShm(self):
+        self.src.connect(self.sinkSocket, 'dataOctet_in')
+        self.sinkSocket.Connections = [{'connection_type' : 'shm', 'ip_address' : '/sinksocket_test', 'ports' : [self.PORT], 'byte_swap' : [0], 'shm_size' : 1024*1024}]
+
+        self.src.start()
+        self.sinkSocket.start()
+        time.sleep(.1)
+
+        # Several readers map the same ring, each keeping its own
+        # position, starting from the head at the time it attached
+        segment = open('/dev/shm/sinksocket_test.%d' % self.PORT, 'rb')
+        ring = mmap.mmap(segment.fileno(), 0, access=mmap.ACCESS_READ)
+        magic, version, capacity = struct.unpack_from('=IIQ', ring, 0)
+        self.assertEquals(magic, 0x53484d52)
+        self.assertEquals(version, 1)
+        self.assertTrue(capacity >= 1024*1024)
+        readers = [struct.unpack_from('=Q', ring, 24)[0] for _ in xrange(3)]
+
+        for _ in xrange(10):
+            self.src.push(range(256), False, "test stream", 1.0)
+        time.sleep(1.0)
+
+        head = struct.unpack_from('=Q', ring, 24)[0]
+        for position in readers:
+            received = ''
+            sequences = []
+            while position < head:
+                offset = 64 + position % capacity
+                sequence, length = struct.unpack_from('=QQ', ring, offset)
+                sequences.append(sequence)
+                received += ring[offset+16:offset+16+length]
+                position += 16 + (length + 15) / 16 * 16
+            self.assertEquals(sequences, range(sequences[0], sequences[0] + len(sequences)))
+            self.assertEquals([ord(x) for x in received], range(256)*10)
+
+        stats = self.sinkSocket.ConnectionStats
+        self.assertEquals(stats[0].status, 'connected')
+        self.assertEquals(stats[0].ip_address, '/sinksocket_test.%d' % self.PORT)
+
+        ring.close()
+        segment.close()
+
+    def runTestProgram(self, name, flags=[], libraries=[]):
+        """
+        Build one of the standalone C++ tests next to this file
+        against the component's headers, run it, and return its
+        exit status and output
+        """
+        directory = os.path.dirname(os.path.abspath(__file__))
+        program = os.path.join(directory, name)
+        try:
+            build = subprocess.Popen(['g++'] + flags + ['-I' + os.path.join(directory, '..', 'cpp'), os.path.join(directory, name + '.cpp'), '-o', program] + libraries, stdout=subprocess.PIPE, stderr=subprocess.STDOUT)
+        except OSError:
+            self.skipTest('g++ is not available')
+        output = build.communicate()[0]
+        self.assertEquals(build.returncode, 0, output)
+
+        try:
+            run = subprocess.Popen([program], stdout=subprocess.PIPE, stderr=subprocess.STDOUT)
+            output = run.communicate()[0]
+        finally:
+            os.remove(program)
+        return run.returncode, output
+
+    def testShmRingReaders(self):
+        # Several readers share a ring with the same header readers
+        # in other processes use
+        status, output = self.runTestProgram('test_shm_ring', libraries=['-lpthread', '-lrt'])
+        self.assertEquals(status, 0, output)
+
+    def testZeroCopy(self):
+        self.src.connect(self.sinkSocket, 'dataOctet_in')
+        self.sinkSocket.Connections = [{'connection_type' : 'server', 'ports' : [self.PORT], 'byte_swap' : [0], 'zerocopy_threshold' : 65536}]
+
+        self.src.start()
+        self.sinkSocket.start()
+
+        sock = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+        sock.connect(('127.0.0.1', self.PORT))
+        time.sleep(.1)
+
+        # Large packets go out with MSG_ZEROCOPY, small ones are
+        # copied, and they must still arrive in order
+        expected = []
+        for i in xrange(10):
+            data = [(i + x) % 256 for x in xrange(256*1024 if i % 2 else 256)]
+            self.src.push(data, False, "test stream", 1.0)
+            expected.extend(data)
+
+        received = ''
+        sock.settimeout(5.0)
+        while len(received) < len(expected):
+            received += sock.recv(65536)
+        self.assertEquals([ord(x) for x in received], expected)
+
+        time.sleep(1.0)
+
+        # Over loopback the kernel always ends up copying
+        stats = self.sinkSocket.ConnectionStats
+        self.assertTrue(stats[0].zerocopy_sends >= 5)
+        self.assertEquals(stats[0].zerocopy_copied, stats[0].zerocopy_sends)
+
+        sock.close()
+
+    def testSendEngine(self):
+        if not ioUringAvailable():
+            self.skipTest('io_uring is not available')
+
+        # The engine is only chosen at startup, so launch a
+        # component of its own for it
+        self.sinkSocket = sb.launch(self.spd_file, properties={'send_engine' : 'io_uring'})
+        self.assertEquals(self.sinkSocket.send_engine, 'io_uring')
+        self.src.connect(self.sinkSocket, 'dataOctet_in')
+        self.sinkSocket.Connections = [{'connection_type' : 'server', 'ports' : [self.PORT, self.PORT+1], 'byte_swap' : [0, 2]}]
+
+        self.src.start()
+        self.sinkSocket.start()
+
+        socks = []
+        for port in (self.PORT, self.PORT+1):
+            sock = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+            sock.connect(('127.0.0.1', port))
+            sock.settimeout(5.0)
+            socks.append(sock)
+        time.sleep(.1)
+
+        # Both sessions write through the ring
+        time.sleep(1.0)
+        stats = self.sinkSocket.ConnectionStats
+        self.assertEquals([stat.send_method for stat in stats], ['io_uring', 'io_uring'])
+
+        expected = []
+        for i in xrange(20):
+            data = [(i + x) % 256 for x in xrange(16*1024 if i % 4 else 100)]
+            self.src.push(data, False, "test stream", 1.0)
+            expected.extend(data)
+        expected = toStr(expected, 'octet')
+
+        for sock, swap in zip(socks, (1, 2)):
+            received = ''
+            while len(received) < len(expected):
+                received += sock.recv(65536)
+            self.assertEquals(received, flip(expected, swap) if swap > 1 else expected)
+            sock.close()
+
+    def testSendEngineFallback(self):
+        # Without the engine, connections say they use asio
+        self.src.connect(self.sinkSocket, 'dataOctet_in')
+        self.sinkSocket.Connections = [{'connection_type' : 'server', 'ports' : [self.PORT], 'byte_swap' : [0]}]
+
+        self.src.start()
+        self.sinkSocket.start()
+
+        sock = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+        sock.connect(('127.0.0.1', self.PORT))
+        time.sleep(1.0)
+
+        self.assertEquals(self.sinkSocket.ConnectionStats[0].send_method, 'asio')
+        sock.close()
+
+    def testIoUringSenderSlots(self):
+        # A socket closing while a batch of writes is open must not
+        # have its writes go out on the next socket registered
+        # What configure finds in kernel headers from Linux 5.5 on
+        flags = ['-DHAVE_LINUX_IO_URING_H', '-DHAVE_DECL_IORING_OP_SENDMSG=1', '-DHAVE_DECL_IORING_REGISTER_FILES_UPDATE=1',
+                 '-DHAVE_DECL_IORING_FEAT_SINGLE_MMAP=1', '-DHAVE_STRUCT_IO_URING_FILES_UPDATE']
+        status, output = self.runTestProgram('test_io_uring_sender', flags=flags, libraries=['-lboost_thread', '-lboost_system', '-lpthread'])
+        if status == 77:
+            self.skipTest('io_uring is not available')
+        self.assertEquals(status, 0, output)
+
+    def testFraming(self):
+        self.src.connect(self.sinkSocket, 'dataOctet_in')
+        self.sinkSocket.Connections = [{'connection_type' : 'server', 'ports' : [self.PORT], 'byte_swap' : [0], 'framing' : 'header'}]
+
+        self.src.start()
+        self.sinkSocket.start()
+
+        sock = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+        sock.connect(('127.0.0.1', self.PORT))
+        sock.settimeout(5.0)
+        time.sleep(.1)
+
+        for i in xrange(5):
+            self.src.push(range(i, 100+i), i == 4, "test stream", 1000.0)
+
+        # Every packet goes out whole, behind its own header
+        received = ''
+        sequences = []
+        for i in xrange(5):
+            while len(received) < 48:
+                received += sock.recv(65536)
+            magic, version, headerSize, sequence, length, dataType, byteOrder, byteSwap, flags, seconds, picoseconds, sampleDelta = struct.unpack('!IHHIIcBHB3xQQd', received[:48])
+            self.assertEquals(magic, 0x534e4b46)
+            self.assertEquals(headerSize, 48)
+            sequences.append(sequence)
+            self.assertEquals(length, 100)
+            self.assertEquals(dataType, 'B')
+            self.assertEquals(byteSwap, 0)
+            self.assertEquals(sampleDelta, 0.001)
+            self.assertTrue(flags & 4)
+            self.assertEquals(bool(flags & 2), i == 4)
+            self.assertTrue(abs(seconds - time.time()) < 60)
+
+            while len(received) < 48 + length:
+                received += sock.recv(65536)
+            self.assertEquals([ord(x) for x in received[48:48+length]], range(i, 100+i))
+            received = received[48+length:]
+        self.assertEquals(sequences, range(sequences[0], sequences[0] + 5))
+
+        sock.close()
+
+    def testFramingWideSwap(self):
+        self.src.connect(self.sinkSocket, 'dataOctet_in')
+        self.sinkSocket.Connections = [{'connection_type' : 'server', 'ports' : [self.PORT], 'byte_swap' : [300], 'framing' : 'header'}]
+
+        self.src.start()
+        self.sinkSocket.start()
+
+        sock = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+        sock.connect(('127.0.0.1', self.PORT))
+        sock.settimeout(5.0)
+        time.sleep(.1)
+
+        # A swap wider than a byte still fits in the header
+        data = [x % 256 for x in xrange(600)]
+        self.src.push(data, False, "test stream", 1000.0)
+
+        received = ''
+        while len(received) < 48 + len(data):
+            received += sock.recv(65536)
+        _, _, headerSize, _, length, _, _, byteSwap, _ = struct.unpack('!IHHIIcBHB', received[:21])
+        self.assertEquals(headerSize, 48)
+        self.assertEquals(length, len(data))
+        self.assertEquals(byteSwap, 300)
+        self.assertEquals(received[48:], flip(toStr(data, 'octet'), 300))
+
+        sock.close()
+
+    #Entries to the same address are only combined when their
+    #settings match, and one with other settings can't take a port
+    #that is already in use
+    def testMixedDuplicates(self):
+        self.src.connect(self.sinkSocket, 'dataOctet_in')
+        self.sinkSocket.Connections = [{'connection_type' : 'server', 'ports' : [self.PORT], 'byte_swap' : [0], 'framing' : 'header', 'overflow_policy' : 'drop_oldest'},
+                                       {'connection_type' : 'server', 'ports' : [self.PORT+1], 'byte_swap' : [0], 'overflow_policy' : 'conflate'},
+                                       {'connection_type' : 'server', 'ports' : [self.PORT+2], 'byte_swap' : [0], 'overflow_policy' : 'conflate'},
+                                       {'connection_type' : 'server', 'ports' : [self.PORT], 'byte_swap' : [0]}]
+
+        connections = self.sinkSocket.Connections
+        self.assertEquals(len(connections), 2)
+        self.assertEquals(list(connections[0].ports), [self.PORT])
+        self.assertEquals(connections[0].framing, 'header')
+        self.assertEquals(connections[0].overflow_policy, 'drop_oldest')
+        self.assertEquals(list(connections[1].ports), [self.PORT+1, self.PORT+2])
+        self.assertEquals(connections[1].framing, 'none')
+        self.assertEquals(connections[1].overflow_policy, 'conflate')
+
+        self.src.start()
+        self.sinkSocket.start()
+
+        framed = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+        framed.connect(('127.0.0.1', self.PORT))
+        framed.settimeout(5.0)
+        plain = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+        plain.connect(('127.0.0.1', self.PORT+1))
+        plain.settimeout(5.0)
+        time.sleep(.1)
+
+        data = range(100)
+        self.src.push(data, False, "test stream", 1000.0)
+
+        received = ''
+        while len(received) < 48 + len(data):
+            received += framed.recv(65536)
+        magic, = struct.unpack('!I', received[:4])
+        self.assertEquals(magic, 0x534e4b46)
+        self.assertEquals([ord(x) for x in received[48:]], data)
+
+        received = ''
+        while len(received) < len(data):
+            received += plain.recv(65536)
+        self.assertEquals([ord(x) for x in received], data)
+
+        framed.close()
+        plain.close()
+
+    def testVrt(self):
+        self.src.connect(self.sinkSocket, 'dataOctet_in')
+        self.sinkSocket.vrt_context_interval = 3
+        self.sinkSocket.Connections = [{'connection_type' : 'server', 'ports' : [self.PORT], 'byte_swap' : [0], 'framing' : 'vrt'}]
+
+        self.src.start()
+        self.sinkSocket.start()
+
+        sock = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+        sock.connect(('127.0.0.1', self.PORT))
+        sock.settimeout(5.0)
+        time.sleep(.1)
+
+        for i in xrange(5):
+            self.src.push(range(i, 101+i), False, "test stream", 1000.0)
+
+        received = ''
+        packets = []
+        while len(packets) < 7:
+            received += sock.recv(65536)
+            while len(received) >= 4:
+                size = struct.unpack('!I', received[:4])[0] & 0xffff
+                if len(received) < size*4:
+                    break
+                packets.append(received[:size*4])
+                received = received[size*4:]
+
+        # A context packet leads the first and the fourth packets
+        self.assertEquals([ord(x[0]) >> 4 for x in packets], [4, 1, 1, 1, 4, 1, 1])
+        streamId = struct.unpack('!I', packets[0][4:8])[0]
+        indicators, rate, payloadFormat = struct.unpack('!IQQ', packets[0][20:40])
+        self.assertEquals(indicators, 0x80208000)
+        self.assertEquals(rate, 1000 << 20)
+        self.assertEquals(payloadFormat >> 32, (0x10 << 24) | (7 << 6) | 7)
+
+        data = [x for x in packets if ord(x[0]) >> 4 == 1]
+        for i, packet in enumerate(data):
+            header, packetStreamId, seconds, picoseconds = struct.unpack('!IIIQ', packet[:20])
+            self.assertEquals((header >> 16) & 0xf, i)
+            self.assertEquals(packetStreamId, streamId)
+            self.assertTrue(abs(seconds - time.time()) < 60)
+            self.assertEquals(header & 0xffff, 5 + 26)
+
+            # Padded with zeros to a whole word
+            self.assertEquals([ord(x) for x in packet[20:]], range(i, 101+i) + [0]*3)
+
+        sock.close()
+
+    def testVrtStreams(self):
+        self.src.connect(self.sinkSocket, 'dataOctet_in')
+        self.sinkSocket.vrt_context_interval = 100
+        self.sinkSocket.Connections = [{'connection_type' : 'server', 'ports' : [self.PORT], 'byte_swap' : [0], 'framing' : 'vrt'}]
+
+        self.src.start()
+        self.sinkSocket.start()
+
+        sock = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+        sock.connect(('127.0.0.1', self.PORT))
+        sock.settimeout(5.0)
+        time.sleep(.1)
+
+        # Two interleaved streams, the first ending and starting over
+        for i in xrange(3):
+            self.src.push(range(8), i == 2, "stream a", 1000.0)
+            self.src.push(range(8), False, "stream b", 1000.0)
+        self.src.push(range(8), False, "stream a", 1000.0)
+
+        received = ''
+        data = []
+        contexts = []
+        while len(data) < 7:
+            received += sock.recv(65536)
+            while len(received) >= 8:
+                header, streamId = struct.unpack('!II', received[:8])
+                size = header & 0xffff
+                if len(received) < size*4:
+                    break
+                if header >> 28 == 1:
+                    data.append((streamId, (header >> 16) & 0xf))
+                else:
+                    contexts.append((streamId, (header >> 16) & 0xf))
+                received = received[size*4:]
+
+        # Each stream numbers its own packets, and a stream that
+        # comes back after its end starts over
+        a, b = data[0][0], data[1][0]
+        self.assertNotEquals(a, b)
+        self.assertEquals([count for streamId, count in data if streamId == a], [0, 1, 2, 0])
+        self.assertEquals([count for streamId, count in data if streamId == b], [0, 1, 2])
+        self.assertEquals([count for streamId, count in contexts if streamId == b], range(len([x for x in contexts if x[0] == b])))
+        self.assertEquals([count for streamId, count in contexts if streamId == a][-1], 0)
+
+        sock.close()
+
+    def testSampleFormat(self):
+        self.src.connect(self.sinkSocket, 'dataFloat_in')
+        self.sinkSocket.Connections = [{'connection_type' : 'server', 'ports' : [self.PORT, self.PORT+1], 'byte_swap' : [0, 1], 'sample_format' : 'int16', 'sample_scale' : 32767.0}]
+
+        self.src.start()
+        self.sinkSocket.start()
+
+        sock = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+        sock.connect(('127.0.0.1', self.PORT))
+        sock.settimeout(5.0)
+        swapped = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+        swapped.connect(('127.0.0.1', self.PORT+1))
+        swapped.settimeout(5.0)
+        time.sleep(.1)
+
+        # Out of range samples saturate rather than wrap
+        data = [0.0, 0.5, -0.5, 1.0, -1.0, 2.0, -2.0, 0.25]
+        self.src.push(data, False, "test stream", 1000.0)
+
+        expected = [0, 16384, -16384, 32767, -32767, 32767, -32768, 8192]
+        received = ''
+        while len(received) < 2*len(data):
+            received += sock.recv(65536)
+        self.assertEquals(list(struct.unpack('=%dh' % len(data), received)), expected)
+
+        received = ''
+        while len(received) < 2*len(data):
+            received += swapped.recv(65536)
+        native = struct.pack('=%dh' % len(data), *expected)
+        self.assertEquals(received, ''.join(native[i+1] + native[i] for i in xrange(0, len(native), 2)))
+
+        sock.close()
+        swapped.close()
+
+    def runOverflowTest(self, policy):
+        self.src.connect(self.sinkSocket, 'dataOctet_in')
+        self.sinkSocket.Connections = [{'connection_type' : 'server', 'ports' : [self.PORT], 'byte_swap' : [0], 'max_queue_bytes' : 1024*1024, 'max_queue_packets' : 0, 'overflow_policy' : policy, 'send_buffer_size' : 65536}]
+        self.assertEquals(self.sinkSocket.Connections[0].overflow_policy, policy)
+
+        self.src.start()
+        self.sinkSocket.start()
+
+        stalled = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+        stalled.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 4096)
+        stalled.connect(('127.0.0.1', self.PORT))
+        time.sleep(.1)
+
+        # Every byte of packet n is n, so the packets that got
+        # through can be told apart.  The fixed send buffer keeps
+        # the kernel from making room for more partway through
+        for n in xrange(self.OVERFLOW_PACKETS):
+            self.src.push([n]*self.OVERFLOW_PACKET_SIZE, False, "test stream", 1.0)
+
+        time.sleep(1.0)
+
+        stats = self.sinkSocket.ConnectionStats
+        print policy, "packets_dropped", stats[0].packets_dropped, "bytes_dropped", stats[0].bytes_dropped
+        self.assertTrue(stats[0].packets_dropped > 0)
+        self.assertTrue(stats[0].bytes_dropped > 0)
+
+        return stalled
+
+    def receiveOverflowPackets(self, stalled):
+        """
+        Read everything sent to a stalled socket by runOverflowTest
+        and return the numbers of the packets, in the order they
+        arrived, checking that each arrived whole
+        """
+        received = ''
+        stalled.settimeout(1.0)
+        try:
+            while True:
+                data = stalled.recv(65536)
+                if not data:
+                    break
+                received += data
+        except socket.timeout:
+            pass
+        stalled.close()
+
+        self.assertEquals(len(received) % self.OVERFLOW_PACKET_SIZE, 0)
+        packets = []
+        for offset in xrange(0, len(received), self.OVERFLOW_PACKET_SIZE):
+            packet = received[offset:offset+self.OVERFLOW_PACKET_SIZE]
+            self.assertEquals(packet, packet[0]*self.OVERFLOW_PACKET_SIZE)
+            packets.append(ord(packet[0]))
+        return packets
+
     def runTest(self, clientFirst=True, client = 'sinksocket',dataPackets=[],maxBytes=None,minBytes=None, portType='octet',byteSwapSrc=None, byteSwapSink=None):
         self.startTest(client, portType)
         